@@ -0,0 +1,16 @@
+#include "common.glh"
+#include "blocks.glh"
+
+varying vec2 texCoord0;
+
+#if defined(VS_BUILD)
+#include "filter.vsh"
+#elif defined(FS_BUILD)
+uniform sampler2D R_gBufferAlbedo;
+
+DeclareFragOutput(0, vec4);
+void main()
+{
+	SetFragOutput(0, texture2D(R_gBufferAlbedo, gl_FragCoord.xy * F_inverseScreenSize) * vec4(F_ambient, 1));
+}
+#endif
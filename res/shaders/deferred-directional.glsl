@@ -0,0 +1,11 @@
+#include "common.glh"
+#include "blocks.glh"
+
+varying vec2 texCoord0;
+
+#if defined(VS_BUILD)
+#include "filter.vsh"
+#elif defined(FS_BUILD)
+#include "lighting-directional.glh"
+#include "deferredLightingMain.fsh"
+#endif
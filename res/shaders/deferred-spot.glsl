@@ -0,0 +1,9 @@
+#include "common.glh"
+#include "blocks.glh"
+
+#if defined(VS_BUILD)
+#include "lightVolume.vsh"
+#elif defined(FS_BUILD)
+#include "lighting-spot.glh"
+#include "deferredLightingMain.fsh"
+#endif
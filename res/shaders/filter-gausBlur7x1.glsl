@@ -6,20 +6,28 @@ varying vec2 texCoord0;
 #include "filter.vsh"
 #elif defined(FS_BUILD)
 uniform vec3 R_blurScale;
+uniform vec3 R_blurRegionMin;
+uniform vec3 R_blurRegionMax;
 uniform sampler2D R_filterTexture;
 
+//Keeps the taps inside the region being blurred, which is part of a larger atlas.
+vec4 SampleRegion(vec2 offset)
+{
+	return texture2D(R_filterTexture, clamp(texCoord0 + offset * R_blurScale.xy, R_blurRegionMin.xy, R_blurRegionMax.xy));
+}
+
 DeclareFragOutput(0, vec4);
 void main()
 {
 	vec4 color = vec4(0.0);
 
-	color += texture2D(R_filterTexture, texCoord0 + (vec2(-3.0) * R_blurScale.xy)) * (1.0/64.0);
-	color += texture2D(R_filterTexture, texCoord0 + (vec2(-2.0) * R_blurScale.xy)) * (6.0/64.0);
-	color += texture2D(R_filterTexture, texCoord0 + (vec2(-1.0) * R_blurScale.xy)) * (15.0/64.0);
-	color += texture2D(R_filterTexture, texCoord0 + (vec2(0.0) * R_blurScale.xy))  * (20.0/64.0);
-	color += texture2D(R_filterTexture, texCoord0 + (vec2(1.0) * R_blurScale.xy))  * (15.0/64.0);
-	color += texture2D(R_filterTexture, texCoord0 + (vec2(2.0) * R_blurScale.xy))  * (6.0/64.0);
-	color += texture2D(R_filterTexture, texCoord0 + (vec2(3.0) * R_blurScale.xy))  * (1.0/64.0);
+	color += SampleRegion(vec2(-3.0)) * (1.0/64.0);
+	color += SampleRegion(vec2(-2.0)) * (6.0/64.0);
+	color += SampleRegion(vec2(-1.0)) * (15.0/64.0);
+	color += SampleRegion(vec2(0.0))  * (20.0/64.0);
+	color += SampleRegion(vec2(1.0))  * (15.0/64.0);
+	color += SampleRegion(vec2(2.0))  * (6.0/64.0);
+	color += SampleRegion(vec2(3.0))  * (1.0/64.0);
 
 	SetFragOutput(0, color);
 }
@@ -0,0 +1,31 @@
+#include "common.glh"
+#include "blocks.glh"
+
+varying vec2 texCoord0;
+varying vec3 worldPos0;
+varying mat3 tbnMatrix;
+
+#if defined(VS_BUILD)
+attribute vec3 position;
+attribute vec2 texCoord;
+attribute vec3 normal;
+attribute vec3 tangent;
+attribute mat4 instanceModel;
+
+void main()
+{
+    vec4 worldPos = instanceModel * vec4(position, 1.0);
+    gl_Position = F_viewProjection * worldPos;
+    texCoord0 = texCoord; 
+    worldPos0 = worldPos.xyz;
+    
+    vec3 n = normalize((instanceModel * vec4(normal, 0.0)).xyz);
+    vec3 t = normalize((instanceModel * vec4(tangent, 0.0)).xyz);
+    t = normalize(t - dot(t, n) * n);
+    
+    vec3 biTangent = cross(t, n);
+    tbnMatrix = mat3(t, biTangent, n);
+}
+#elif defined(FS_BUILD)
+#include "forward-ambient.fsh"
+#endif
@@ -0,0 +1,8 @@
+#include "common.glh"
+#include "forwardlighting.glh"
+
+#if defined(VS_BUILD)
+#include "forwardlighting-instanced.vsh"
+#elif defined(FS_BUILD)
+#include "forward-spot.fsh"
+#endif
@@ -0,0 +1,18 @@
+#include "common.glh"
+
+#if defined(VS_BUILD)
+attribute vec3 position;
+attribute vec2 texCoord;
+attribute vec3 normal;
+attribute vec3 tangent;
+attribute mat4 instanceModel;
+
+uniform mat4 C_viewProjection;
+
+void main()
+{
+    gl_Position = C_viewProjection * (instanceModel * vec4(position, 1.0));
+}
+#elif defined(FS_BUILD)
+#include "shadowMapGenerator.fsh"
+#endif
@@ -0,0 +1,1034 @@
+#include "benchmarks.h"
+#include "camera.h"
+#include "coreEngine.h"
+#include "entity.h"
+#include "entityComponent.h"
+#include "frustum.h"
+#include "game.h"
+#include "jobSystem.h"
+#include "lighting.h"
+#include "memoryArena.h"
+#include "memoryPool.h"
+#include "mappedFile.h"
+#include "mesh.h"
+#include "meshRenderer.h"
+#include "packedVertex.h"
+#include "profiling.h"
+#include "renderingEngine.h"
+#include "sceneFile.h"
+#include "shader.h"
+#include "timing.h"
+#include "window.h"
+#include "worldPartition.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+//--------------------------------------------------------------------------------
+// Forward declarations
+//--------------------------------------------------------------------------------
+static void EmptyJob(JobSystem* jobSystem, Job* job, const void* data);
+static void CreateAllocationBenchmarkScene(Entity& root, MemoryArena* arena, int numEntities, std::vector<void*>* heapClutter);
+static void CreateTraversalBenchmarkTree(Entity* parent, int depth, int branching);
+static void LoadSpinComponent(Entity* entity, SceneComponentReader& reader);
+static std::vector<Entity*> GetAllAttachedRecursive(Entity* entity);
+
+//Counts every entity it visits, and stops after a certain number of them.
+class CountingVisitor
+{
+public:
+	CountingVisitor(int maxCount) :
+		m_count(0),
+		m_maxCount(maxCount) {}
+	
+	VisitResult operator()(Entity* entity)
+	{
+		m_count++;
+		return m_count < m_maxCount ? VISIT_CONTINUE : VISIT_STOP;
+	}
+	
+	inline int GetCount() const { return m_count; }
+private:
+	int m_count;
+	int m_maxCount;
+};
+
+//Spins it's entity around, with a bit of busy work to stand in for real game logic.
+class SpinComponent : public EntityComponent
+{
+public:
+	SpinComponent(float speed) :
+		m_speed(speed) {}
+	
+	virtual void Update(float delta)
+	{
+		float angle = m_speed * delta;
+		for(int i = 0; i < 8; i++)
+			angle = sinf(angle) + delta;
+		
+		GetTransform()->Rotate(Vector3f(0,1,0), angle);
+	}
+	
+	virtual const char* GetSceneTypeName() const { return "SpinComponent"; }
+	virtual void WriteToScene(SceneComponentWriter& writer) const { writer.WriteFloat(m_speed); }
+private:
+	float m_speed;
+};
+
+//Reads it's entity's world position every update, like anything that follows or aims at
+//something does.
+class WorldPositionComponent : public EntityComponent
+{
+public:
+	WorldPositionComponent() {}
+	
+	virtual void Update(float delta)
+	{
+		m_worldPos = GetTransform()->GetTransformedPos();
+	}
+	
+	inline const Vector3f& GetWorldPos() const { return m_worldPos; }
+private:
+	Vector3f m_worldPos;
+};
+
+//A game that only has a scene, so it can be updated without a window or an engine.
+class UpdateBenchmarkGame : public Game
+{
+public:
+	//Groups of spinning entities, under a spinning world entity inside a spinning level, so
+	//none of them are ever unchanged, and the world's cached parent matrix is read by every
+	//group.
+	void CreateScene(int numGroups, int entitiesPerGroup)
+	{
+		Entity* level = AddToScene();
+		level->CreateComponent<SpinComponent>(0.05f);
+		Entity* world = level->CreateChild();
+		world->CreateComponent<SpinComponent>(0.1f);
+		
+		for(int i = 0; i < numGroups; i++)
+		{
+			Entity* group = world->CreateChild(Vector3f((float)i, 0, 0));
+			group->CreateComponent<SpinComponent>(1.0f);
+			for(int j = 1; j < entitiesPerGroup; j++)
+			{
+				Entity* entity = group->CreateChild(Vector3f(0, (float)j, 0));
+				entity->CreateComponent<SpinComponent>((float)j);
+				entity->CreateComponent<WorldPositionComponent>();
+			}
+		}
+	}
+};
+
+//A floor of cubes under a grid of point lights, seen from above, for comparing the render paths
+//as the number of lights grows.
+class LightCountBenchmarkGame : public Game
+{
+public:
+	LightCountBenchmarkGame(int lightsPerSide) :
+		m_lightsPerSide(lightsPerSide) {}
+	
+	virtual void Init(const Window& window)
+	{
+		static const int CUBES_PER_SIDE = 32;
+		static const float CUBE_SPACING = 2.5f;
+		float floorSize = CUBES_PER_SIDE * CUBE_SPACING;
+		
+		for(int z = 0; z < CUBES_PER_SIDE; z++)
+		{
+			for(int x = 0; x < CUBES_PER_SIDE; x++)
+			{
+				AddToScene(Vector3f(x * CUBE_SPACING, 0, z * CUBE_SPACING))
+					->CreateComponent<MeshRenderer>(Mesh("cube.obj"), Material("lightCountBenchmark"));
+			}
+		}
+		
+		//Each light reaches about 10 units, so with more of them, they overlap more.
+		float lightSpacing = floorSize / m_lightsPerSide;
+		for(int z = 0; z < m_lightsPerSide; z++)
+		{
+			for(int x = 0; x < m_lightsPerSide; x++)
+			{
+				AddToScene(Vector3f((x + 0.5f) * lightSpacing, 2.0f, (z + 0.5f) * lightSpacing))
+					->CreateComponent<PointLight>(Vector3f(1,1,1), 0.4f, Attenuation(0,0,1));
+			}
+		}
+		
+		AddToScene(Vector3f(floorSize / 2, 40, -20), Quaternion(Vector3f(1,0,0), ToRadians(45.0f)))
+			->CreateComponent<CameraComponent>(Matrix4f().InitPerspective(ToRadians(70.0f), window.GetAspect(), 0.1f, 1000.0f));
+	}
+private:
+	int m_lightsPerSide;
+};
+
+//A field of identical cubes with one material under a single unshadowed light, so nearly all
+//of the frame is spent drawing the same mesh again and again.
+class InstancingBenchmarkGame : public Game
+{
+public:
+	virtual void Init(const Window& window)
+	{
+		static const int CUBES_PER_SIDE = 100;
+		static const float CUBE_SPACING = 2.5f;
+		float fieldSize = CUBES_PER_SIDE * CUBE_SPACING;
+		
+		for(int z = 0; z < CUBES_PER_SIDE; z++)
+		{
+			for(int x = 0; x < CUBES_PER_SIDE; x++)
+			{
+				AddToScene(Vector3f(x * CUBE_SPACING, 0, z * CUBE_SPACING))
+					->CreateComponent<MeshRenderer>(Mesh("cube.obj"), Material("instancingBenchmark"));
+			}
+		}
+		
+		AddToScene(Vector3f(0,0,0), Quaternion(Vector3f(1,0,0), ToRadians(45.0f)))
+			->CreateComponent<DirectionalLight>(Vector3f(1,1,1), 0.4f);
+		
+		//High enough above the middle to see the whole field.
+		AddToScene(Vector3f(fieldSize / 2, 150, -60), Quaternion(Vector3f(1,0,0), ToRadians(60.0f)))
+			->CreateComponent<CameraComponent>(Matrix4f().InitPerspective(ToRadians(70.0f), window.GetAspect(), 0.1f, 1000.0f));
+	}
+};
+
+//--------------------------------------------------------------------------------
+// Benchmark Implementations
+//--------------------------------------------------------------------------------
+void Benchmarks::RunAll()
+{
+	JobSystemBenchmark();
+	ParallelUpdateBenchmark();
+	GameUpdateBenchmark();
+	AllocationBenchmark();
+	EntityDestructionBenchmark();
+	TraversalBenchmark();
+	SceneLoadBenchmark();
+	WorldStreamingBenchmark();
+	FrustumCullingBenchmark();
+	VertexPackingBenchmark();
+	LightCountBenchmark();
+	InstancingBenchmark();
+	UniformBinderBenchmark();
+}
+
+void Benchmarks::JobSystemBenchmark()
+{
+	static const int NUM_SPAWN_ROUNDS = 100;
+	static const int JOBS_PER_ROUND = 4000;
+	static const unsigned int NUM_ELEMENTS = 1 << 22;
+	static const int NUM_PARALLEL_FOR_ROUNDS = 10;
+	static const unsigned int GRAIN_SIZES[] = { 256, 4096, 0 };
+
+	unsigned int maxWorkers = std::thread::hardware_concurrency();
+	maxWorkers = maxWorkers == 0 ? 1 : maxWorkers;
+
+	printf("Job System Benchmark (%u cores)\n", maxWorkers);
+
+	std::vector<float> values(NUM_ELEMENTS);
+	double serialTime = 0.0;
+	{
+		for(unsigned int i = 0; i < NUM_ELEMENTS; i++)
+			values[i] = (float)i;
+
+		double startTime = Time::GetTime();
+		for(int round = 0; round < NUM_PARALLEL_FOR_ROUNDS; round++)
+		{
+			for(unsigned int i = 0; i < NUM_ELEMENTS; i++)
+				values[i] = sqrtf(values[i] * values[i] + 1.0f);
+		}
+		serialTime = (Time::GetTime() - startTime) / NUM_PARALLEL_FOR_ROUNDS;
+		printf("  Serial loop over %u elements:           %f ms\n", NUM_ELEMENTS, 1000.0 * serialTime);
+	}
+
+	for(unsigned int numWorkers = 1; numWorkers <= maxWorkers; numWorkers *= 2)
+	{
+		JobSystem jobSystem;
+		jobSystem.Start(numWorkers);
+
+		//Spawn overhead: many empty jobs as children of one root, so the measured time
+		//is almost entirely creation, scheduling, stealing and completion.
+		double startTime = Time::GetTime();
+		for(int round = 0; round < NUM_SPAWN_ROUNDS; round++)
+		{
+			Job* root = jobSystem.CreateJob(&EmptyJob);
+			for(int i = 0; i < JOBS_PER_ROUND; i++)
+				jobSystem.Run(jobSystem.CreateChildJob(root, &EmptyJob));
+
+			jobSystem.Run(root);
+			jobSystem.Wait(root);
+		}
+		double spawnTime = Time::GetTime() - startTime;
+		printf("  %2u workers, spawn+run+wait per job:     %f us\n", numWorkers,
+			(1000000.0 * spawnTime) / ((double)NUM_SPAWN_ROUNDS * (JOBS_PER_ROUND + 1)));
+
+		for(unsigned int i = 0; i < sizeof(GRAIN_SIZES)/sizeof(GRAIN_SIZES[0]); i++)
+		{
+			startTime = Time::GetTime();
+			for(int round = 0; round < NUM_PARALLEL_FOR_ROUNDS; round++)
+			{
+				jobSystem.ParallelFor(0, NUM_ELEMENTS, GRAIN_SIZES[i], [&values](unsigned int rangeBegin, unsigned int rangeEnd)
+				{
+					for(unsigned int j = rangeBegin; j < rangeEnd; j++)
+						values[j] = sqrtf(values[j] * values[j] + 1.0f);
+				});
+			}
+			double parallelTime = (Time::GetTime() - startTime) / NUM_PARALLEL_FOR_ROUNDS;
+			
+			printf("  %2u workers, ParallelFor grain %5u:      %f ms (%.2fx serial)\n", numWorkers, GRAIN_SIZES[i],
+				1000.0 * parallelTime, serialTime / parallelTime);
+		}
+
+		jobSystem.Stop();
+	}
+
+	printf("\n");
+}
+
+void Benchmarks::ParallelUpdateBenchmark()
+{
+	static const int NUM_GROUPS = 500;
+	static const int ENTITIES_PER_GROUP = 100;
+	static const int NUM_FRAMES = 100;
+	static const float FRAME_TIME = 1.0f/60.0f;
+
+	unsigned int maxWorkers = std::thread::hardware_concurrency();
+	maxWorkers = maxWorkers == 0 ? 1 : maxWorkers;
+
+	printf("Parallel Update Benchmark (%d entities)\n", NUM_GROUPS * ENTITIES_PER_GROUP);
+
+	//Not a Game, since that needs a CoreEngine and a window. The scene is a root with
+	//one level of groups underneath, like a typical level made out of prefabs.
+	Entity root;
+	for(int i = 0; i < NUM_GROUPS; i++)
+	{
+		Entity* group = new Entity(Vector3f((float)i, 0, 0));
+		group->AddComponent(new SpinComponent(1.0f));
+		for(int j = 1; j < ENTITIES_PER_GROUP; j++)
+			group->AddChild((new Entity(Vector3f(0, (float)j, 0)))->AddComponent(new SpinComponent((float)j)));
+		root.AddChild(group);
+	}
+
+	ProfileTimer serialTimer;
+	for(int frame = 0; frame < NUM_FRAMES; frame++)
+	{
+		serialTimer.StartInvocation();
+		root.UpdateAll(FRAME_TIME);
+		serialTimer.StopInvocation();
+	}
+	printf("  Serial      ");
+	double serialTime = serialTimer.DisplayAndReset("Update Time: ");
+
+	for(unsigned int numWorkers = 1; numWorkers <= maxWorkers; numWorkers *= 2)
+	{
+		JobSystem jobSystem;
+		jobSystem.Start(numWorkers);
+
+		ProfileTimer parallelTimer;
+		for(int frame = 0; frame < NUM_FRAMES; frame++)
+		{
+			parallelTimer.StartInvocation();
+			root.UpdateAll(FRAME_TIME, &jobSystem);
+			parallelTimer.StopInvocation();
+		}
+		printf("  %2u workers  ", numWorkers);
+		double parallelTime = parallelTimer.DisplayAndReset("Update Time: ");
+		printf("  %2u workers, speedup: %.2fx\n", numWorkers, serialTime / parallelTime);
+
+		jobSystem.Stop();
+	}
+
+	printf("\n");
+}
+
+void Benchmarks::GameUpdateBenchmark()
+{
+	static const int NUM_GROUPS = 500;
+	static const int ENTITIES_PER_GROUP = 100;
+	static const int NUM_FRAMES = 100;
+	static const float FRAME_TIME = 1.0f/60.0f;
+
+	unsigned int maxWorkers = std::thread::hardware_concurrency();
+	maxWorkers = maxWorkers == 0 ? 1 : maxWorkers;
+
+	printf("Game Update Benchmark (%d entities)\n", NUM_GROUPS * ENTITIES_PER_GROUP + 2);
+
+	UpdateBenchmarkGame game;
+	game.CreateScene(NUM_GROUPS, ENTITIES_PER_GROUP);
+
+	for(int frame = 0; frame < NUM_FRAMES; frame++)
+		game.Update(FRAME_TIME);
+	printf("  Serial      ");
+	double serialTime = game.DisplayUpdateTime(0);
+
+	for(unsigned int numWorkers = 1; numWorkers <= maxWorkers; numWorkers *= 2)
+	{
+		JobSystem jobSystem;
+		jobSystem.Start(numWorkers);
+		game.SetJobSystem(&jobSystem);
+		game.SetParallelUpdate(true);
+
+		for(int frame = 0; frame < NUM_FRAMES; frame++)
+			game.Update(FRAME_TIME);
+		printf("  %2u workers  ", numWorkers);
+		double parallelTime = game.DisplayUpdateTime(0);
+		printf("  %2u workers, speedup: %.2fx\n", numWorkers, serialTime / parallelTime);
+
+		game.SetParallelUpdate(false);
+		game.SetJobSystem(0);
+		jobSystem.Stop();
+	}
+
+	printf("\n");
+}
+
+void Benchmarks::AllocationBenchmark()
+{
+	static const int NUM_ENTITIES = 100000;
+	static const int NUM_SPAWN_ROUNDS = 10;
+	static const int NUM_FRAMES = 50;
+	static const float FRAME_TIME = 1.0f/60.0f;
+	static const char* ALLOCATOR_NAMES[] = { "Heap ", "Pool ", "Arena" };
+
+	printf("Allocation Benchmark (%d entities, each with one component)\n", NUM_ENTITIES);
+
+	MemoryArena arena(1024 * 1024);
+
+	for(int allocator = 0; allocator < 3; allocator++)
+	{
+		MemoryPool::SetPoolingEnabled(allocator != 0);
+		MemoryArena* sceneArena = allocator == 2 ? &arena : 0;
+
+		//Spawn and destroy throughput, on a heap that's otherwise quiet.
+		Entity root;
+		double startTime = Time::GetTime();
+		for(int round = 0; round < NUM_SPAWN_ROUNDS; round++)
+		{
+			CreateAllocationBenchmarkScene(root, sceneArena, NUM_ENTITIES, 0);
+			root.DeleteAllChildren();
+			arena.Reset();
+		}
+		double spawnTime = (Time::GetTime() - startTime) / ((double)NUM_SPAWN_ROUNDS * NUM_ENTITIES);
+
+		//Iteration speed. In a real game, plenty of other allocations happen while a level loads, so
+		//some clutter is allocated in between to scatter the heap allocated entities around memory.
+		std::vector<void*> heapClutter;
+		CreateAllocationBenchmarkScene(root, sceneArena, NUM_ENTITIES, &heapClutter);
+		for(unsigned int i = 0; i < heapClutter.size(); i++)
+			free(heapClutter[i]);
+
+		root.UpdateAll(FRAME_TIME);
+		startTime = Time::GetTime();
+		for(int frame = 0; frame < NUM_FRAMES; frame++)
+			root.UpdateAll(FRAME_TIME);
+		double updateTime = (Time::GetTime() - startTime) / ((double)NUM_FRAMES * NUM_ENTITIES);
+
+		root.DeleteAllChildren();
+		arena.Reset();
+
+		printf("  %s spawn+destroy: %7.1f ns/entity, UpdateAll: %5.1f ns/entity\n", ALLOCATOR_NAMES[allocator],
+			1000000000.0 * spawnTime, 1000000000.0 * updateTime);
+	}
+
+	MemoryPool::SetPoolingEnabled(true);
+	printf("\n");
+}
+
+void Benchmarks::EntityDestructionBenchmark()
+{
+	static const int NUM_LIVE_ENTITIES = 100000;
+	static const int CHURN_PER_FRAME = 10000;
+	static const int NUM_FRAMES = 100;
+
+	printf("Entity Destruction Benchmark (%d live entities, %d destroyed and spawned per frame)\n", NUM_LIVE_ENTITIES, CHURN_PER_FRAME);
+
+	Entity root;
+	std::vector<EntityHandle> projectiles;
+	for(int i = 0; i < NUM_LIVE_ENTITIES; i++)
+	{
+		Entity* projectile = root.CreateChild(Vector3f((float)i, 0, 0));
+		projectile->CreateComponent<SpinComponent>(1.0f);
+		projectiles.push_back(projectile->GetHandle());
+	}
+
+	unsigned int randomSeed = 2463534242u;
+	double totalDestroyTime = 0.0;
+	double worstDestroyTime = 0.0;
+	int numStaleHandles = 0;
+	int numDestroyed = 0;
+
+	for(int frame = 0; frame < NUM_FRAMES; frame++)
+	{
+		//Pick random projectiles to destroy; the same one may be picked twice, which Destroy ignores.
+		for(int i = 0; i < CHURN_PER_FRAME; i++)
+		{
+			randomSeed ^= randomSeed << 13;
+			randomSeed ^= randomSeed >> 17;
+			randomSeed ^= randomSeed << 5;
+
+			Entity* projectile = projectiles[randomSeed % projectiles.size()].Get();
+			if(projectile && !projectile->IsPendingDestroy())
+			{
+				projectile->Destroy();
+				numDestroyed++;
+			}
+		}
+
+		double startTime = Time::GetTime();
+		Entity::DestroyPendingEntities();
+		double destroyTime = Time::GetTime() - startTime;
+
+		totalDestroyTime += destroyTime;
+		worstDestroyTime = destroyTime > worstDestroyTime ? destroyTime : worstDestroyTime;
+
+		//Replace the destroyed projectiles. Their old handles must not resolve to the new ones.
+		for(unsigned int i = 0; i < projectiles.size(); i++)
+		{
+			if(!projectiles[i].IsValid())
+			{
+				EntityHandle oldHandle = projectiles[i];
+				Entity* projectile = root.CreateChild(Vector3f((float)i, 0, 0));
+				projectile->CreateComponent<SpinComponent>(1.0f);
+				projectiles[i] = projectile->GetHandle();
+				numStaleHandles += oldHandle.IsValid() ? 1 : 0;
+			}
+		}
+	}
+
+	printf("  Flush: %f ms/frame on average, %f ms worst case, %.1f ns/entity\n", 1000.0 * totalDestroyTime / NUM_FRAMES,
+		1000.0 * worstDestroyTime, 1000000000.0 * totalDestroyTime / numDestroyed);
+	printf("  Stale handles resolving to new entities: %d\n", numStaleHandles);
+	printf("\n");
+}
+
+void Benchmarks::TraversalBenchmark()
+{
+	static const int TREE_DEPTH = 6;
+	static const int TREE_BRANCHING = 7;
+	static const int NUM_ROUNDS = 20;
+
+	Entity root;
+	CreateTraversalBenchmarkTree(&root, TREE_DEPTH, TREE_BRANCHING);
+
+	int numEntities = 0;
+	for(EntityIterator it(&root); !it.IsDone(); it.Next())
+		numEntities++;
+
+	printf("Traversal Benchmark (%d entities, depth %d)\n", numEntities, TREE_DEPTH);
+
+	size_t checksum = 0;
+	double startTime = Time::GetTime();
+	for(int round = 0; round < NUM_ROUNDS; round++)
+		checksum += GetAllAttachedRecursive(&root).size();
+	double recursiveTime = (Time::GetTime() - startTime) / NUM_ROUNDS;
+
+	startTime = Time::GetTime();
+	for(int round = 0; round < NUM_ROUNDS; round++)
+	{
+		for(EntityIterator it(&root); !it.IsDone(); it.Next())
+			checksum++;
+	}
+	double iteratorTime = (Time::GetTime() - startTime) / NUM_ROUNDS;
+
+	startTime = Time::GetTime();
+	for(int round = 0; round < NUM_ROUNDS; round++)
+	{
+		CountingVisitor visitor(numEntities);
+		root.Visit(visitor);
+		checksum += visitor.GetCount();
+	}
+	double visitTime = (Time::GetTime() - startTime) / NUM_ROUNDS;
+
+	startTime = Time::GetTime();
+	checksum += root.GetAllAttached().size();
+	double cacheBuildTime = Time::GetTime() - startTime;
+
+	startTime = Time::GetTime();
+	for(int round = 0; round < NUM_ROUNDS; round++)
+		checksum += root.GetAllAttached().size();
+	double cachedTime = (Time::GetTime() - startTime) / NUM_ROUNDS;
+
+	printf("  Recursive vectors (old GetAllAttached): %f ms\n", 1000.0 * recursiveTime);
+	printf("  EntityIterator:                         %f ms\n", 1000.0 * iteratorTime);
+	printf("  Entity::Visit:                          %f ms\n", 1000.0 * visitTime);
+	printf("  GetAllAttached, rebuilding the cache:   %f ms\n", 1000.0 * cacheBuildTime);
+	printf("  GetAllAttached, cached:                 %f ms\n", 1000.0 * cachedTime);
+	printf("  (checksum %u)\n\n", (unsigned int)checksum);
+}
+
+void Benchmarks::SceneLoadBenchmark()
+{
+	static const int NUM_ENTITIES = 100000;
+	static const int NUM_ROUNDS = 5;
+	static const char* FILE_NAME = "benchmarkScene.scn";
+
+	printf("Scene Load Benchmark (%d entities, each with one component)\n", NUM_ENTITIES);
+
+	SceneFile::RegisterComponentType("SpinComponent", &LoadSpinComponent);
+	MemoryArena arena(1024 * 1024);
+	Entity root;
+
+	double startTime = Time::GetTime();
+	for(int round = 0; round < NUM_ROUNDS; round++)
+	{
+		root.DeleteAllChildren();
+		arena.Reset();
+		CreateAllocationBenchmarkScene(root, &arena, NUM_ENTITIES, 0);
+	}
+	double codeTime = (Time::GetTime() - startTime) / NUM_ROUNDS;
+
+	startTime = Time::GetTime();
+	bool saved = SceneFile::Save(root, FILE_NAME);
+	double saveTime = Time::GetTime() - startTime;
+
+	root.DeleteAllChildren();
+	arena.Reset();
+
+	if(!saved)
+	{
+		printf("  Unable to save the scene, skipping\n\n");
+		return;
+	}
+
+	//Includes mapping the file, which will mostly be in the file cache after the first round.
+	startTime = Time::GetTime();
+	int numLoadedEntities = 0;
+	for(int round = 0; round < NUM_ROUNDS; round++)
+	{
+		root.DeleteAllChildren();
+		arena.Reset();
+
+		Entity* scene = SceneFile::Load(FILE_NAME, &arena);
+		if(scene)
+			root.AddChild(scene);
+	}
+	double loadTime = (Time::GetTime() - startTime) / NUM_ROUNDS;
+
+	for(EntityIterator it(&root); !it.IsDone(); it.Next())
+		numLoadedEntities++;
+
+	MappedFile file;
+	file.Open(FILE_NAME);
+	size_t fileSize = file.GetSize();
+	file.Close();
+
+	root.DeleteAllChildren();
+	arena.Reset();
+	remove(FILE_NAME);
+
+	printf("  Built in code:           %f ms\n", 1000.0 * codeTime);
+	printf("  Saved:                   %f ms (%u bytes)\n", 1000.0 * saveTime, (unsigned int)fileSize);
+	printf("  Loaded from mapped file: %f ms (%d entities, including the scene root)\n", 1000.0 * loadTime, numLoadedEntities - 1);
+	printf("\n");
+}
+
+void Benchmarks::WorldStreamingBenchmark()
+{
+	static const int WORLD_SIZE_IN_CELLS = 16;
+	static const int ENTITIES_PER_CELL = 250;
+	static const float CELL_SIZE = 64.0f;
+	static const int NUM_FRAMES = 600;
+	static const float FRAME_TIME = 1.0f / 60.0f;
+	static const char* FILE_PREFIX = "benchmarkWorld";
+
+	printf("World Streaming Benchmark (%dx%d cells, %d entities each)\n", WORLD_SIZE_IN_CELLS, WORLD_SIZE_IN_CELLS, ENTITIES_PER_CELL);
+
+	SceneFile::RegisterComponentType("SpinComponent", &LoadSpinComponent);
+
+	{
+		Entity world;
+		for(int z = 0; z < WORLD_SIZE_IN_CELLS; z++)
+		{
+			for(int x = 0; x < WORLD_SIZE_IN_CELLS; x++)
+			{
+				Entity* cell = new Entity(Vector3f(((float)x + 0.5f) * CELL_SIZE, 0, ((float)z + 0.5f) * CELL_SIZE));
+				for(int i = 0; i < ENTITIES_PER_CELL; i++)
+					cell->CreateChild(Vector3f(0, (float)i, 0))->CreateComponent<SpinComponent>((float)(i % 7));
+
+				world.AddChild(cell);
+			}
+		}
+
+		if(!WorldPartition::WriteCells(world, FILE_PREFIX, CELL_SIZE))
+		{
+			printf("  Unable to write the cells, skipping\n\n");
+			return;
+		}
+	}
+
+	//The viewer flies diagonally across the whole world, fast enough that new cells are needed
+	//every few frames.
+	Entity root;
+	double maxFrameTime = 0.0;
+	double totalFrameTime = 0.0;
+	{
+		WorldPartition partition(FILE_PREFIX, CELL_SIZE, 2.5f * CELL_SIZE, 3.0f * CELL_SIZE, 1.0, 2);
+		double startTime = Time::GetTime();
+
+		for(int frame = 0; frame < NUM_FRAMES; frame++)
+		{
+			float distance = (float)frame / (float)NUM_FRAMES * WORLD_SIZE_IN_CELLS * CELL_SIZE;
+			Vector3f viewerPos(distance, 10.0f, distance);
+
+			double frameStartTime = Time::GetTime();
+			root.UpdateAll(FRAME_TIME);
+			partition.Update(viewerPos, root);
+			Entity::DestroyPendingEntities();
+			double frameTime = Time::GetTime() - frameStartTime;
+
+			totalFrameTime += frameTime;
+			if(frameTime > maxFrameTime)
+				maxFrameTime = frameTime;
+
+			//Stands in for rendering, so the IO threads have some time to work in.
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		}
+
+		double elapsedTime = Time::GetTime() - startTime;
+		printf("  Streamed for:            %f s (%d frames)\n", elapsedTime, NUM_FRAMES);
+		printf("  Average update:          %f ms (max %f ms)\n", 1000.0 * totalFrameTime / NUM_FRAMES, 1000.0 * maxFrameTime);
+		partition.DisplayAndResetStats((double)NUM_FRAMES);
+	}
+
+	root.DeleteAllChildren();
+
+	for(int z = 0; z < WORLD_SIZE_IN_CELLS; z++)
+		for(int x = 0; x < WORLD_SIZE_IN_CELLS; x++)
+			remove(WorldPartition::GetCellFileName(FILE_PREFIX, x, z).c_str());
+
+	printf("\n");
+}
+
+void Benchmarks::FrustumCullingBenchmark()
+{
+	static const int NUM_SPHERES = 100000;
+	static const int NUM_ROUNDS = 100;
+
+	printf("Frustum Culling Benchmark (%d spheres)\n", NUM_SPHERES);
+
+	//Spheres scattered around a camera in the middle, so most of them are culled, the way they
+	//would be in an outdoor scene.
+	std::vector<float> centersX(NUM_SPHERES);
+	std::vector<float> centersY(NUM_SPHERES);
+	std::vector<float> centersZ(NUM_SPHERES);
+	std::vector<float> radii(NUM_SPHERES);
+	std::vector<unsigned char> visible(NUM_SPHERES);
+
+	srand(1);
+	for(int i = 0; i < NUM_SPHERES; i++)
+	{
+		centersX[i] = (float)(rand() % 2000) - 1000.0f;
+		centersY[i] = (float)(rand() % 100);
+		centersZ[i] = (float)(rand() % 2000) - 1000.0f;
+		radii[i] = (float)(rand() % 50) / 10.0f;
+	}
+
+	Matrix4f projection = Matrix4f().InitPerspective(ToRadians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	Matrix4f view = Matrix4f().InitTranslation(Vector3f(0, -10, 0));
+	Frustum frustum(projection * view);
+
+	unsigned int numVisibleScalar = 0;
+	double startTime = Time::GetTime();
+	for(int round = 0; round < NUM_ROUNDS; round++)
+	{
+		numVisibleScalar = 0;
+		for(int i = 0; i < NUM_SPHERES; i++)
+			numVisibleScalar += frustum.IntersectsSphere(Vector3f(centersX[i], centersY[i], centersZ[i]), radii[i]) ? 1 : 0;
+	}
+	double scalarTime = (Time::GetTime() - startTime) / NUM_ROUNDS;
+
+	unsigned int numVisibleSimd = 0;
+	startTime = Time::GetTime();
+	for(int round = 0; round < NUM_ROUNDS; round++)
+		numVisibleSimd = frustum.CullSpheres(&centersX[0], &centersY[0], &centersZ[0], &radii[0], NUM_SPHERES, &visible[0]);
+	double simdTime = (Time::GetTime() - startTime) / NUM_ROUNDS;
+
+	printf("  One sphere at a time:    %f ms (%u visible)\n", 1000.0 * scalarTime, numVisibleScalar);
+	printf("  Four at a time:          %f ms (%u visible)\n", 1000.0 * simdTime, numVisibleSimd);
+	printf("\n");
+}
+
+void Benchmarks::VertexPackingBenchmark()
+{
+	static const int GRID_SIZE = 255; //So it still gets 16 bit indices
+	static const float TEXCOORD_SCALE = 10.0f; //About as far as terrain02.obj's go
+	static const int NUM_ROUNDS = 20;
+
+	printf("Vertex Packing Benchmark (%dx%d terrain grid)\n", GRID_SIZE, GRID_SIZE);
+
+	//Rolling hills, with texture coordinates that repeat across the grid, the way terrain's do.
+	IndexedModel model;
+	for(int z = 0; z < GRID_SIZE; z++)
+	{
+		for(int x = 0; x < GRID_SIZE; x++)
+		{
+			model.AddVertex((float)x, 4.0f * sinf((float)x * 0.1f) * cosf((float)z * 0.07f), (float)z);
+			model.AddTexCoord((float)x / (GRID_SIZE - 1) * TEXCOORD_SCALE, (float)z / (GRID_SIZE - 1) * TEXCOORD_SCALE);
+		}
+	}
+
+	for(int z = 0; z < GRID_SIZE - 1; z++)
+	{
+		for(int x = 0; x < GRID_SIZE - 1; x++)
+		{
+			unsigned int i = z * GRID_SIZE + x;
+			model.AddFace(i, i + GRID_SIZE, i + 1);
+			model.AddFace(i + 1, i + GRID_SIZE, i + GRID_SIZE + 1);
+		}
+	}
+	model = model.Finalize();
+
+	std::vector<PackedVertex> vertices;
+	double startTime = Time::GetTime();
+	for(int round = 0; round < NUM_ROUNDS; round++)
+		VertexPacking::PackVertices(model, vertices);
+	double packTime = (Time::GetTime() - startTime) / NUM_ROUNDS;
+
+	float maxTexCoordError = 0.0f;
+	float maxNormalError = 0.0f;
+	float maxTangentError = 0.0f;
+	for(unsigned int i = 0; i < vertices.size(); i++)
+	{
+		float texCoordErrorX = fabsf(VertexPacking::HalfToFloat(vertices[i].texCoord[0]) - model.GetTexCoords()[i].GetX());
+		float texCoordErrorY = fabsf(VertexPacking::HalfToFloat(vertices[i].texCoord[1]) - model.GetTexCoords()[i].GetY());
+		maxTexCoordError = std::max(maxTexCoordError, std::max(texCoordErrorX, texCoordErrorY));
+
+		Vector3f normal = VertexPacking::UnpackSnorm1010102(vertices[i].normal).Normalized();
+		Vector3f tangent = VertexPacking::UnpackSnorm1010102(vertices[i].tangent).Normalized();
+		maxNormalError = std::max(maxNormalError, acosf(std::min(normal.Dot(model.GetNormals()[i]), 1.0f)));
+		maxTangentError = std::max(maxTangentError, acosf(std::min(tangent.Dot(model.GetTangents()[i]), 1.0f)));
+	}
+
+	size_t numVertices = model.GetPositions().size();
+	size_t numIndices = model.GetIndices().size();
+	size_t floatSize = numVertices * (3 + 2 + 3 + 3) * sizeof(float) + numIndices * sizeof(unsigned int);
+	size_t packedSize = numVertices * sizeof(PackedVertex) + numIndices * sizeof(uint16_t);
+
+	printf("  Separate floats:         %u bytes per vertex, %f MB\n", (unsigned int)((3 + 2 + 3 + 3) * sizeof(float)), floatSize / (1024.0 * 1024.0));
+	printf("  Packed:                  %u bytes per vertex, %f MB\n", (unsigned int)sizeof(PackedVertex), packedSize / (1024.0 * 1024.0));
+	printf("  Packing time:            %f ms\n", 1000.0 * packTime);
+	printf("  Worst texCoord error:    %f (%f texels of a 1024 texture)\n", maxTexCoordError, maxTexCoordError * 1024.0f);
+	printf("  Worst normal error:      %f degrees\n", ToDegrees(maxNormalError));
+	printf("  Worst tangent error:     %f degrees\n", ToDegrees(maxTangentError));
+	printf("\n");
+}
+
+void Benchmarks::LightCountBenchmark()
+{
+	static const int NUM_LIGHT_COUNTS = 4;
+	static const int LIGHTS_PER_SIDE[NUM_LIGHT_COUNTS] = { 1, 4, 8, 16 };
+	static const int NUM_WARMUP_FRAMES = 5;
+	static const int NUM_FRAMES = 50;
+	
+	printf("Light Count Benchmark (1024 cubes, 800x600)\n");
+	
+	Window window(800, 600, "Light Count Benchmark");
+	Material material("lightCountBenchmark", Texture("bricks2.jpg"), 0.5f, 8);
+	
+	for(int i = 0; i < NUM_LIGHT_COUNTS; i++)
+	{
+		int numLights = LIGHTS_PER_SIDE[i] * LIGHTS_PER_SIDE[i];
+		double frameTimes[2];
+		
+		for(int path = 0; path < 2; path++)
+		{
+			RenderingEngine renderer(window, path == 0 ? RenderingEngine::RENDER_PATH_FORWARD : RenderingEngine::RENDER_PATH_DEFERRED);
+			LightCountBenchmarkGame game(LIGHTS_PER_SIDE[i]);
+			CoreEngine engine(60.0, &window, &renderer, &game);
+			
+			//Shaders, meshes and shadow maps are all set up by the first frames.
+			for(int frame = 0; frame < NUM_WARMUP_FRAMES; frame++)
+				game.Render(&renderer);
+			glFinish();
+			
+			double startTime = Time::GetTime();
+			for(int frame = 0; frame < NUM_FRAMES; frame++)
+			{
+				game.Render(&renderer);
+				glFinish();
+			}
+			frameTimes[path] = (Time::GetTime() - startTime) / NUM_FRAMES;
+		}
+		
+		printf("  %3d lights:              forward %f ms, deferred %f ms\n", numLights, 1000.0 * frameTimes[0], 1000.0 * frameTimes[1]);
+	}
+	printf("\n");
+}
+
+void Benchmarks::InstancingBenchmark()
+{
+	static const int NUM_WARMUP_FRAMES = 5;
+	static const int NUM_FRAMES = 50;
+	
+	printf("Instancing Benchmark (10000 cubes, 800x600)\n");
+	
+	Window window(800, 600, "Instancing Benchmark");
+	Material material("instancingBenchmark", Texture("bricks2.jpg"), 0.5f, 8);
+	
+	//The draw call overhead is all on the CPU with a software renderer, so it's worth knowing
+	//which one this is.
+	printf("  Renderer:                %s\n", (const char*)glGetString(GL_RENDERER));
+	
+	for(int instancing = 0; instancing < 2; instancing++)
+	{
+		RenderingEngine renderer(window, RenderingEngine::RENDER_PATH_FORWARD);
+		InstancingBenchmarkGame game;
+		CoreEngine engine(60.0, &window, &renderer, &game);
+		renderer.SetInstancing(instancing == 1);
+		
+		if(instancing == 1 && !renderer.IsInstancingEnabled())
+		{
+			printf("  Instanced:               not supported\n");
+			break;
+		}
+		
+		for(int frame = 0; frame < NUM_WARMUP_FRAMES; frame++)
+			game.Render(&renderer);
+		glFinish();
+		RenderCounters::numDrawCalls = 0;
+		
+		double startTime = Time::GetTime();
+		for(int frame = 0; frame < NUM_FRAMES; frame++)
+		{
+			game.Render(&renderer);
+			glFinish();
+		}
+		double frameTime = (Time::GetTime() - startTime) / NUM_FRAMES;
+		
+		printf("  %s %f ms, %u draws per frame\n", instancing == 1 ? "Instanced:              " : "One draw per object:    ",
+			1000.0 * frameTime, RenderCounters::numDrawCalls / NUM_FRAMES);
+	}
+	printf("\n");
+}
+
+void Benchmarks::UniformBinderBenchmark()
+{
+	static const int NUM_UPDATES = 100000;
+	static const int NUM_LOOKUPS = 1000000;
+	static const int NUM_FLOATS = 4;
+	static const int NUM_TEXTURES = 3;
+	static const char* FLOAT_NAMES[NUM_FLOATS] = { "specularIntensity", "specularPower", "dispMapScale", "dispMapBias" };
+	static const char* TEXTURE_NAMES[NUM_TEXTURES] = { "diffuse", "normalMap", "dispMap" };
+	
+	printf("Uniform Binder Benchmark (%d updates, %d lookups)\n", NUM_UPDATES, NUM_LOOKUPS);
+	
+	Window window(800, 600, "Uniform Binder Benchmark");
+	RenderingEngine renderer(window);
+	Material material("uniformBinderBenchmark", Texture("bricks2.jpg"), 0.5f, 8);
+	Shader shader("forward-ambient");
+	Transform transform;
+	Camera camera(Matrix4f().InitPerspective(ToRadians(70.0f), window.GetAspect(), 0.1f, 1000.0f), &transform);
+	
+	//What a draw costs on the CPU, with every binder reading it's value by ID, and every
+	//sampler's slot already known.
+	shader.Bind();
+	shader.UpdateUniforms(transform, material, renderer, camera);
+	glFinish();
+	
+	double startTime = Time::GetTime();
+	for(int i = 0; i < NUM_UPDATES; i++)
+	{
+		shader.UpdateUniforms(transform, material, renderer, camera);
+	}
+	double updateTime = (Time::GetTime() - startTime) / NUM_UPDATES;
+	
+	//The material values the forward shaders read, found by name, the way every uniform update
+	//used to, and by the IDs binders now keep.
+	unsigned int floatIds[NUM_FLOATS];
+	unsigned int textureIds[NUM_TEXTURES];
+	std::string floatNames[NUM_FLOATS];
+	std::string textureNames[NUM_TEXTURES];
+	for(int i = 0; i < NUM_FLOATS; i++)
+	{
+		floatNames[i] = FLOAT_NAMES[i];
+		floatIds[i] = MappedValues::GetValueId(floatNames[i]);
+	}
+	for(int i = 0; i < NUM_TEXTURES; i++)
+	{
+		textureNames[i] = TEXTURE_NAMES[i];
+		textureIds[i] = MappedValues::GetValueId(textureNames[i]);
+	}
+	
+	size_t checksum = 0;
+	
+	startTime = Time::GetTime();
+	for(int i = 0; i < NUM_LOOKUPS; i++)
+	{
+		for(int j = 0; j < NUM_FLOATS; j++)
+			checksum += (size_t)material.GetFloat(floatNames[j]);
+		for(int j = 0; j < NUM_TEXTURES; j++)
+			checksum += (size_t)&material.GetTexture(textureNames[j]);
+	}
+	double nameLookupTime = (Time::GetTime() - startTime) / NUM_LOOKUPS;
+	
+	startTime = Time::GetTime();
+	for(int i = 0; i < NUM_LOOKUPS; i++)
+	{
+		for(int j = 0; j < NUM_FLOATS; j++)
+			checksum += (size_t)material.GetFloat(floatIds[j]);
+		for(int j = 0; j < NUM_TEXTURES; j++)
+			checksum += (size_t)&material.GetTexture(textureIds[j]);
+	}
+	double idLookupTime = (Time::GetTime() - startTime) / NUM_LOOKUPS;
+	
+	printf("  Uniform update:          %f us per draw\n", 1000000.0 * updateTime);
+	printf("  Material values by name: %f us per draw\n", 1000000.0 * nameLookupTime);
+	printf("  Material values by ID:   %f us per draw\n", 1000000.0 * idLookupTime);
+	printf("  (checksum %u)\n\n", (unsigned int)checksum);
+}
+
+//--------------------------------------------------------------------------------
+// Static Function Implementations
+//--------------------------------------------------------------------------------
+static void EmptyJob(JobSystem* jobSystem, Job* job, const void* data) {}
+
+static void CreateAllocationBenchmarkScene(Entity& root, MemoryArena* arena, int numEntities, std::vector<void*>* heapClutter)
+{
+	static const int ENTITIES_PER_GROUP = 100;
+
+	Entity* group = 0;
+	for(int i = 0; i < numEntities; i++)
+	{
+		if(i % ENTITIES_PER_GROUP == 0)
+		{
+			group = Entity::Create(arena, Vector3f((float)i, 0, 0));
+			root.AddChild(group);
+		}
+
+		group->CreateChild(Vector3f(0, (float)i, 0))->CreateComponent<SpinComponent>((float)(i % 7));
+
+		if(heapClutter)
+			heapClutter->push_back(malloc(16 + (i * 37) % 512));
+	}
+}
+
+static void CreateTraversalBenchmarkTree(Entity* parent, int depth, int branching)
+{
+	if(depth == 0)
+		return;
+
+	for(int i = 0; i < branching; i++)
+		CreateTraversalBenchmarkTree(parent->CreateChild(), depth - 1, branching);
+}
+
+static std::vector<Entity*> GetAllAttachedRecursive(Entity* entity)
+{
+	std::vector<Entity*> result;
+
+	for(unsigned int i = 0; i < entity->GetNumChildren(); i++)
+	{
+		std::vector<Entity*> childObjects = GetAllAttachedRecursive(entity->GetChild(i));
+		result.insert(result.end(), childObjects.begin(), childObjects.end());
+	}
+
+	result.push_back(entity);
+	return result;
+}
+
+static void LoadSpinComponent(Entity* entity, SceneComponentReader& reader)
+{
+	entity->CreateComponent<SpinComponent>(reader.ReadFloat());
+}
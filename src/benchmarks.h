@@ -0,0 +1,64 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+//Micro-benchmarks for engine subsystems. These are not run as part of the game; set
+//PROFILING_RUN_BENCHMARKS in profiling.h to run them instead of the game.
+namespace Benchmarks
+{
+	void RunAll();
+	
+	//Measures the cost of creating, running and waiting on jobs, and how well
+	//a fine grained ParallelFor scales with the number of workers.
+	void JobSystemBenchmark();
+	
+	//Compares the serial and parallel versions of Entity::UpdateAll on a large,
+	//flat scene where every component can be updated independently.
+	void ParallelUpdateBenchmark();
+	
+	//The same scene under two moving entities, updated through Game::Update, and timed by the
+	//game's own update timer. The workers read world matrices through those shared ancestors.
+	void GameUpdateBenchmark();
+	
+	//Compares heap, pool and arena allocation of entities and components, both in how fast
+	//scenes can be created and destroyed, and in how fast the resulting scenes can be updated.
+	void AllocationBenchmark();
+	
+	//Spawns and destroys many short lived entities every frame, the way a game would handle
+	//projectiles, and reports the average and worst case cost of deferred destruction.
+	void EntityDestructionBenchmark();
+	
+	//Compares the ways of enumerating a scene with the old recursive GetAllAttached, which
+	//built and concatenated a new vector for every entity.
+	void TraversalBenchmark();
+	
+	//Compares building a large scene in code with loading it from a memory mapped scene file.
+	void SceneLoadBenchmark();
+	
+	//Moves a viewer across a large world that's split into streamed cells, and reports the
+	//streaming bandwidth and how much attaching cells adds to the frame time.
+	void WorldStreamingBenchmark();
+	
+	//Compares testing bounding spheres against a view frustum one at a time with testing
+	//four at a time from flat arrays, which is how the rendering engine culls.
+	void FrustumCullingBenchmark();
+	
+	//Packs a terrain sized grid into the mesh pool's vertex format, and reports how much smaller
+	//it is, how long packing takes, and the worst error of each packed attribute.
+	void VertexPackingBenchmark();
+	
+	//Renders the same scene with the forward and deferred paths, with 1, 16, 64 and 256 point
+	//lights, and reports the frame time of each. Needs a window, unlike the others.
+	void LightCountBenchmark();
+	
+	//Renders 10000 of the same mesh and material with one draw per object, then with instancing,
+	//and reports the frame time and draw calls of each. Run it with LIBGL_ALWAYS_SOFTWARE=1 to
+	//use Mesa's llvmpipe, where the cost of each draw call is easiest to see.
+	void InstancingBenchmark();
+	
+	//Reports the CPU time of updating a forward shader's uniforms for one draw, and compares
+	//finding the material's values by name, as it was done before binders kept value IDs, with
+	//finding them by ID. Needs a window.
+	void UniformBinderBenchmark();
+};
+
+#endif // BENCHMARKS_H
@@ -1,8 +1,14 @@
 #include "camera.h"
 #include "renderingEngine.h"
 #include "coreEngine.h"
+#include "sceneFile.h"
 
 Matrix4f Camera::GetViewProjection() const
+{
+	return m_projection * GetView();
+}
+
+Matrix4f Camera::GetView() const
 {
 	//This comes from the conjugate rotation because the world should appear to rotate
 	//opposite to the camera's rotation.
@@ -13,7 +19,7 @@ Matrix4f Camera::GetViewProjection() const
 	//to the camera's movement.
 	cameraTranslation.InitTranslation(GetTransform().GetTransformedPos() * -1);
 	
-	return m_projection * cameraRotation * cameraTranslation;
+	return cameraRotation * cameraTranslation;
 }
 
 void CameraComponent::AddToEngine(CoreEngine* engine) const
@@ -23,6 +29,16 @@ void CameraComponent::AddToEngine(CoreEngine* engine) const
 	engine->GetRenderingEngine()->SetMainCamera(m_camera);
 }
 
+void CameraComponent::RemoveFromEngine(CoreEngine* engine) const
+{
+	engine->GetRenderingEngine()->RemoveMainCamera(m_camera);
+}
+
+void CameraComponent::WriteToScene(SceneComponentWriter& writer) const
+{
+	writer.WriteMatrix4f(m_camera.GetProjection());
+}
+
 void CameraComponent::SetParent(Entity* parent)
 {
 	EntityComponent::SetParent(parent);
@@ -23,6 +23,11 @@ public:
 	//will transform the point into it's location on the screen, where -1 represents the bottom/left
 	//of the screen, and 1 represents the top/right of the screen.
 	Matrix4f GetViewProjection()           const;
+	//Only the part of GetViewProjection that moves points into the camera's space, where it's
+	//at the origin, looking down +Z.
+	Matrix4f GetView()                     const;
+	
+	inline const Matrix4f& GetProjection()       const { return m_projection; }
 	
 	inline void SetProjection(const Matrix4f& projection) { m_projection = projection; }
 	inline void SetTransform(Transform* transform)        { m_transform = transform; }
@@ -44,6 +49,10 @@ public:
 		m_camera(projection, 0) {}
 	
 	virtual void AddToEngine(CoreEngine* engine) const;
+	virtual void RemoveFromEngine(CoreEngine* engine) const;
+	
+	virtual const char* GetSceneTypeName() const { return "CameraComponent"; }
+	virtual void WriteToScene(SceneComponentWriter& writer) const;
 	
 	inline Matrix4f GetViewProjection() const { return m_camera.GetViewProjection(); }
 	
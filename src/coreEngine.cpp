@@ -14,6 +14,11 @@ CoreEngine::CoreEngine(double frameRate, Window* window, RenderingEngine* render
 	m_renderingEngine(renderingEngine),
 	m_game(game)
 {
+	//The job system is started first, so the game and all subsystems can already make use
+	//of it during initialization.
+	m_jobSystem.Start();
+	m_renderingEngine->SetJobSystem(&m_jobSystem);
+	
 	//We're telling the game about this engine so it can send the engine any information it needs
 	//to the various subsystems.
 	m_game->SetEngine(this);
@@ -24,6 +29,13 @@ CoreEngine::CoreEngine(double frameRate, Window* window, RenderingEngine* render
 	m_game->Init(*m_window);
 }
 
+CoreEngine::~CoreEngine()
+{
+	//The game may outlive the engine, so everything in it has to stop referring to it.
+	m_game->SetEngine(0);
+	m_jobSystem.Stop();
+}
+
 void CoreEngine::Start()
 {
 	if(m_isRunning)
@@ -62,10 +74,14 @@ void CoreEngine::Start()
 			totalMeasuredTime += m_game->DisplayInputTime((double)frames);
 			totalMeasuredTime += m_game->DisplayUpdateTime((double)frames);
 			totalMeasuredTime += m_renderingEngine->DisplayRenderTime((double)frames);
+			m_renderingEngine->DisplayShadowTime((double)frames);
 			totalMeasuredTime += sleepTimer.DisplayAndReset("Sleep Time: ", (double)frames);
 			totalMeasuredTime += windowUpdateTimer.DisplayAndReset("Window Update Time: ", (double)frames);
 			totalMeasuredTime += swapBufferTimer.DisplayAndReset("Buffer Swap Time: ", (double)frames);
 			totalMeasuredTime += m_renderingEngine->DisplayWindowSyncTime((double)frames);
+			m_renderingEngine->DisplayCullingStats((double)frames);
+			RenderCounters::DisplayAndReset((double)frames);
+			m_game->DisplayStreamingStats((double)frames);
 			
 			printf("Other Time:                             %f ms\n", (totalTime - totalMeasuredTime));
 			printf("Total Time:                             %f ms\n\n", totalTime);
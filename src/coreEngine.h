@@ -2,6 +2,7 @@
 #define COREENGINE_H
 
 #include "renderingEngine.h"
+#include "jobSystem.h"
 #include <string>
 class Game;
 
@@ -11,11 +12,13 @@ class CoreEngine
 {
 public:
 	CoreEngine(double frameRate, Window* window, RenderingEngine* renderingEngine, Game* game);
+	virtual ~CoreEngine();
 	
 	void Start(); //Starts running the game; contains central game loop.
 	void Stop();  //Stops running the game, and disables all subsystems.
 	
 	inline RenderingEngine* GetRenderingEngine() { return m_renderingEngine; }
+	inline JobSystem* GetJobSystem()             { return &m_jobSystem; }
 protected:
 private:
 	bool             m_isRunning;       //Whether or not the engine is running
@@ -23,6 +26,7 @@ private:
 	Window*          m_window;          //Used to display the game
 	RenderingEngine* m_renderingEngine; //Used to render the game. Stored as pointer so the user can pass in a derived class.
 	Game*            m_game;            //The game itself. Stored as pointer so the user can pass in a derived class.
+	JobSystem        m_jobSystem;       //Runs work from the game and the sub-engines on all available cores.
 };
 
 #endif // COREENGINE_H
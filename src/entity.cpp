@@ -1,6 +1,19 @@
 #include "entity.h"
 #include "entityComponent.h"
 #include "coreEngine.h"
+#include "jobSystem.h"
+#include <cassert>
+#include <iostream>
+
+//Subtrees smaller than this are never split further for parallel updates, because
+//the cost of scheduling would outweigh the gain.
+static const unsigned int MIN_PARALLEL_SUBTREE_SIZE = 64;
+
+Entity::Slot*             Entity::s_slotChunks[Entity::MAX_SLOT_CHUNKS];
+unsigned int              Entity::s_numSlots = 0;
+unsigned int              Entity::s_firstFreeSlot = Entity::NO_FREE_SLOT;
+std::vector<EntityHandle> Entity::s_pendingDestroys;
+std::mutex                Entity::s_slotMutex;
 
 Entity::~Entity()
 {
@@ -8,10 +21,16 @@ Entity::~Entity()
 	{
 		if(m_components[i])
 		{	
+			if(m_coreEngine)
+			{
+				m_components[i]->RemoveFromEngine(m_coreEngine);
+			}
+			
 			delete m_components[i];
 		}
 	}
 	
+	//Not DeleteAllChildren, since there's no point in keeping this entity's bookkeeping up to date.
 	for(unsigned int i = 0; i < m_children.size(); i++)
 	{
 		if(m_children[i]) 
@@ -19,13 +38,26 @@ Entity::~Entity()
 			delete m_children[i];
 		}
 	}
+	
+	FreeHandle(m_handle);
+}
+
+Entity* Entity::Create(MemoryArena* arena, const Vector3f& pos, const Quaternion& rot, float scale)
+{
+	Entity* result = arena ? new(*arena) Entity(pos, rot, scale) : new Entity(pos, rot, scale);
+	result->m_arena = arena;
+	return result;
 }
 
 Entity* Entity::AddChild(Entity* child)
 {
+	child->m_indexInParent = (unsigned int)m_children.size();
 	m_children.push_back(child); 
+	child->m_parent = this;
 	child->GetTransform()->SetParent(&m_transform);
 	child->SetEngine(m_coreEngine);
+	InvalidateSubtreeInfo();
+	IncrementSubtreeVersion();
 	return this;
 }
 
@@ -33,9 +65,111 @@ Entity* Entity::AddComponent(EntityComponent* component)
 {
 	m_components.push_back(component);
 	component->SetParent(this);
+	
+	//Components added to an entity that's already in the scene would otherwise never be registered.
+	if(m_coreEngine)
+	{
+		component->AddToEngine(m_coreEngine);
+	}
+	
+	InvalidateSubtreeInfo();
 	return this;
 }
 
+Entity* Entity::CreateChild(const Vector3f& pos, const Quaternion& rot, float scale)
+{
+	Entity* child = Create(m_arena, pos, rot, scale);
+	AddChild(child);
+	return child;
+}
+
+void Entity::DeleteAllChildren()
+{
+	for(unsigned int i = 0; i < m_children.size(); i++)
+	{
+		if(m_children[i]) 
+		{
+			delete m_children[i];
+		}
+	}
+	
+	m_children.clear();
+	InvalidateSubtreeInfo();
+	IncrementSubtreeVersion();
+}
+
+void Entity::Destroy()
+{
+	if(m_isPendingDestroy)
+	{
+		return;
+	}
+	
+	m_isPendingDestroy = true;
+	
+	std::lock_guard<std::mutex> lock(s_slotMutex);
+	s_pendingDestroys.push_back(m_handle);
+}
+
+void Entity::DestroyPendingEntities()
+{
+	std::vector<EntityHandle> pendingDestroys;
+	{
+		std::lock_guard<std::mutex> lock(s_slotMutex);
+		pendingDestroys.swap(s_pendingDestroys);
+	}
+	
+	for(unsigned int i = 0; i < pendingDestroys.size(); i++)
+	{
+		//If an ancestor was destroyed first, this entity is already gone.
+		Entity* entity = Resolve(pendingDestroys[i]);
+		if(entity)
+		{
+			entity->RemoveFromParent();
+			delete entity;
+		}
+	}
+	
+	//Keep the memory around for next time, unless another batch was queued in the meantime.
+	std::lock_guard<std::mutex> lock(s_slotMutex);
+	if(s_pendingDestroys.empty())
+	{
+		pendingDestroys.clear();
+		s_pendingDestroys.swap(pendingDestroys);
+	}
+}
+
+Entity* Entity::Resolve(const EntityHandle& handle)
+{
+	if(handle.m_generation == 0)
+	{
+		return 0;
+	}
+	
+	const Slot& slot = s_slotChunks[handle.m_index / SLOTS_PER_CHUNK][handle.m_index % SLOTS_PER_CHUNK];
+	return slot.generation == handle.m_generation ? slot.entity : 0;
+}
+
+void Entity::RemoveFromParent()
+{
+	if(m_parent == 0)
+	{
+		return;
+	}
+	
+	//The last child takes this one's place, so removal doesn't depend on the number of siblings.
+	std::vector<Entity*>& siblings = m_parent->m_children;
+	Entity* lastSibling = siblings.back();
+	siblings[m_indexInParent] = lastSibling;
+	lastSibling->m_indexInParent = m_indexInParent;
+	siblings.pop_back();
+	
+	m_parent->InvalidateSubtreeInfo();
+	m_parent->IncrementSubtreeVersion();
+	m_parent = 0;
+	m_transform.SetParent(0);
+}
+
 void Entity::ProcessInputAll(const Input& input, float delta)
 {
 	ProcessInput(input, delta);
@@ -56,6 +190,16 @@ void Entity::UpdateAll(float delta)
 	}
 }
 
+void Entity::ProcessInputAll(const Input& input, float delta, JobSystem* jobSystem)
+{
+	RunStageAllParallel(STAGE_PROCESS_INPUT, &input, delta, jobSystem);
+}
+
+void Entity::UpdateAll(float delta, JobSystem* jobSystem)
+{
+	RunStageAllParallel(STAGE_UPDATE, 0, delta, jobSystem);
+}
+
 void Entity::RenderAll(const Shader& shader, const RenderingEngine& renderingEngine, const Camera& camera) const
 {
 	Render(shader, renderingEngine, camera);
@@ -92,16 +236,200 @@ void Entity::Render(const Shader& shader, const RenderingEngine& renderingEngine
 	}
 }
 
+void Entity::RunStage(UpdateStage stage, const Input* input, float delta)
+{
+	if(stage == STAGE_PROCESS_INPUT)
+		ProcessInput(*input, delta);
+	else
+		Update(delta);
+}
+
+void Entity::RunStageAll(UpdateStage stage, const Input* input, float delta)
+{
+	if(stage == STAGE_PROCESS_INPUT)
+		ProcessInputAll(*input, delta);
+	else
+		UpdateAll(delta);
+}
+
+void Entity::RunStageAllParallel(UpdateStage stage, const Input* input, float delta, JobSystem* jobSystem)
+{
+	if(jobSystem == 0 || jobSystem->GetNumWorkers() == 1)
+	{
+		RunStageAll(stage, input, delta);
+		return;
+	}
+	
+	UpdateSubtreeInfo();
+	
+	//Aim for a few subtrees per worker, so stealing can even out differences in their cost.
+	unsigned int maxSubtreeSize = m_subtreeSize / (jobSystem->GetNumWorkers() * 4);
+	if(maxSubtreeSize < MIN_PARALLEL_SUBTREE_SIZE)
+	{
+		maxSubtreeSize = MIN_PARALLEL_SUBTREE_SIZE;
+	}
+	
+	std::vector<Entity*> subtrees;
+	CollectParallelSubtrees(stage, input, delta, maxSubtreeSize, subtrees);
+	
+	//The entities above the subtrees are shared between them, and reading a world matrix writes
+	//the cached parent matrices above it, so those are filled in here and left alone until the
+	//subtrees are done.
+	for(unsigned int i = 0; i < subtrees.size(); i++)
+	{
+		if(subtrees[i]->m_parent)
+		{
+			subtrees[i]->m_parent->m_transform.FreezeParentMatrices();
+		}
+	}
+	
+	jobSystem->ParallelFor(0, (unsigned int)subtrees.size(), 0, [&](unsigned int rangeBegin, unsigned int rangeEnd)
+	{
+		for(unsigned int i = rangeBegin; i < rangeEnd; i++)
+		{
+			subtrees[i]->RunStageAll(stage, input, delta);
+		}
+	});
+	
+	for(unsigned int i = 0; i < subtrees.size(); i++)
+	{
+		if(subtrees[i]->m_parent)
+		{
+			subtrees[i]->m_parent->m_transform.UnfreezeParentMatrices();
+		}
+	}
+}
+
+void Entity::CollectParallelSubtrees(UpdateStage stage, const Input* input, float delta, unsigned int maxSubtreeSize, std::vector<Entity*>& result)
+{
+	if(m_subtreeIsEntityLocal && m_subtreeSize <= maxSubtreeSize)
+	{
+		result.push_back(this);
+		return;
+	}
+	
+	//This entity is either too big to be a single task, or something in it has to run on the main
+	//thread. Either way, it has to be processed before it's children, so it is done right away.
+	RunStage(stage, input, delta);
+	
+	for(unsigned int i = 0; i < m_children.size(); i++)
+	{
+		m_children[i]->CollectParallelSubtrees(stage, input, delta, maxSubtreeSize, result);
+	}
+}
+
+void Entity::InvalidateSubtreeInfo()
+{
+	//If an entity is dirty, then so are all of it's ancestors, so there's no need to go further.
+	for(Entity* entity = this; entity != 0 && !entity->m_subtreeInfoDirty; entity = entity->m_parent)
+	{
+		entity->m_subtreeInfoDirty = true;
+	}
+}
+
+void Entity::UpdateSubtreeInfo()
+{
+	if(!m_subtreeInfoDirty)
+	{
+		return;
+	}
+	
+	m_subtreeSize = 1;
+	m_subtreeIsEntityLocal = true;
+	
+	for(unsigned int i = 0; i < m_components.size(); i++)
+	{
+		if(m_components[i]->GetUpdateAccess() != EntityComponent::ACCESS_ENTITY_LOCAL)
+		{
+			m_subtreeIsEntityLocal = false;
+		}
+	}
+	
+	for(unsigned int i = 0; i < m_children.size(); i++)
+	{
+		m_children[i]->UpdateSubtreeInfo();
+		m_subtreeSize += m_children[i]->m_subtreeSize;
+		m_subtreeIsEntityLocal = m_subtreeIsEntityLocal && m_children[i]->m_subtreeIsEntityLocal;
+	}
+	
+	m_subtreeInfoDirty = false;
+}
+
+EntityHandle Entity::AllocateHandle(Entity* entity)
+{
+	std::lock_guard<std::mutex> lock(s_slotMutex);
+	
+	unsigned int index = s_firstFreeSlot;
+	if(index != NO_FREE_SLOT)
+	{
+		s_firstFreeSlot = s_slotChunks[index / SLOTS_PER_CHUNK][index % SLOTS_PER_CHUNK].nextFreeSlot;
+	}
+	else
+	{
+		index = s_numSlots;
+		unsigned int chunk = index / SLOTS_PER_CHUNK;
+		
+		if(chunk >= MAX_SLOT_CHUNKS)
+		{
+			std::cerr << "Error: Too many entities; at most " << SLOTS_PER_CHUNK * MAX_SLOT_CHUNKS << " can exist at once" << std::endl;
+			assert(chunk < MAX_SLOT_CHUNKS);
+		}
+		
+		if(s_slotChunks[chunk] == 0)
+		{
+			s_slotChunks[chunk] = new Slot[SLOTS_PER_CHUNK];
+			for(unsigned int i = 0; i < SLOTS_PER_CHUNK; i++)
+			{
+				s_slotChunks[chunk][i].entity = 0;
+				s_slotChunks[chunk][i].generation = 1;
+				s_slotChunks[chunk][i].nextFreeSlot = NO_FREE_SLOT;
+			}
+		}
+		
+		s_numSlots++;
+	}
+	
+	Slot& slot = s_slotChunks[index / SLOTS_PER_CHUNK][index % SLOTS_PER_CHUNK];
+	slot.entity = entity;
+	return EntityHandle(index, slot.generation);
+}
+
+void Entity::FreeHandle(const EntityHandle& handle)
+{
+	std::lock_guard<std::mutex> lock(s_slotMutex);
+	
+	Slot& slot = s_slotChunks[handle.m_index / SLOTS_PER_CHUNK][handle.m_index % SLOTS_PER_CHUNK];
+	slot.entity = 0;
+	
+	//Generation 0 is never used, since default constructed handles have it.
+	slot.generation++;
+	if(slot.generation == 0)
+	{
+		slot.generation = 1;
+	}
+	
+	slot.nextFreeSlot = s_firstFreeSlot;
+	s_firstFreeSlot = handle.m_index;
+}
+
 void Entity::SetEngine(CoreEngine* engine)
 {
 	if(m_coreEngine != engine)
 	{
-		m_coreEngine = engine;
-		
 		for(unsigned int i = 0; i < m_components.size(); i++)
 		{
-			m_components[i]->AddToEngine(engine);
+			if(m_coreEngine)
+			{
+				m_components[i]->RemoveFromEngine(m_coreEngine);
+			}
+			
+			if(engine)
+			{
+				m_components[i]->AddToEngine(engine);
+			}
 		}
+		
+		m_coreEngine = engine;
 
 		for(unsigned int i = 0; i < m_children.size(); i++)
 		{
@@ -110,16 +438,58 @@ void Entity::SetEngine(CoreEngine* engine)
 	}
 }
 
-std::vector<Entity*> Entity::GetAllAttached()
+const std::vector<Entity*>& Entity::GetAllAttached()
+{
+	if(m_attachedCacheVersion != m_subtreeVersion)
+	{
+		//Clearing keeps the capacity, so rebuilding only allocates when the subtree has grown.
+		m_attachedCache.clear();
+		for(EntityIterator it(this); !it.IsDone(); it.Next())
+		{
+			m_attachedCache.push_back(it.Get());
+		}
+		
+		m_attachedCacheVersion = m_subtreeVersion;
+	}
+	
+	return m_attachedCache;
+}
+
+void Entity::IncrementSubtreeVersion()
+{
+	for(Entity* entity = this; entity != 0; entity = entity->m_parent)
+	{
+		entity->m_subtreeVersion++;
+	}
+}
+
+void EntityIterator::Next()
 {
-	std::vector<Entity*> result;
+	if(m_current != 0 && !m_current->m_children.empty())
+	{
+		m_current = m_current->m_children[0];
+		return;
+	}
 	
-	for(unsigned int i = 0; i < m_children.size(); i++)
+	NextSkipChildren();
+}
+
+void EntityIterator::NextSkipChildren()
+{
+	//Climb up until there's a next sibling, but never past the entity the iteration started at.
+	while(m_current != 0 && m_current != m_root)
 	{
-		std::vector<Entity*> childObjects = m_children[i]->GetAllAttached();
-		result.insert(result.end(), childObjects.begin(), childObjects.end());
+		Entity* parent = m_current->m_parent;
+		unsigned int nextSibling = m_current->m_indexInParent + 1;
+		
+		if(nextSibling < parent->m_children.size())
+		{
+			m_current = parent->m_children[nextSibling];
+			return;
+		}
+		
+		m_current = parent;
 	}
 	
-	result.push_back(this);
-	return result;
+	m_current = 0;
 }
@@ -1,34 +1,167 @@
 #ifndef ENTITYOBJECT_H
 #define ENTITYOBJECT_H
 
+#include <mutex>
+#include <utility>
 #include <vector>
 #include "transform.h"
 #include "input.h"
+#include "memoryArena.h"
+#include "memoryPool.h"
 class Camera;
 class CoreEngine;
+class Entity;
 class EntityComponent;
+class JobSystem;
 class Shader;
 class RenderingEngine;
 
+//Refers to an entity without pointing to it. Handles are an index into a table of entity
+//slots, plus the generation of the slot at the time the handle was made. Every time a slot
+//is reused, it's generation goes up, so handles to destroyed entities never resolve to the
+//entity that took their place, and can be kept around safely.
+class EntityHandle
+{
+public:
+	EntityHandle() :
+		m_index(0),
+		m_generation(0) {}
+	
+	//Returns the entity, or 0 if it has been destroyed.
+	inline Entity* Get() const;
+	inline bool IsValid() const { return Get() != 0; }
+	
+	inline unsigned int GetIndex()      const { return m_index; }
+	inline unsigned int GetGeneration() const { return m_generation; }
+	
+	inline bool operator==(const EntityHandle& other) const { return m_index == other.m_index && m_generation == other.m_generation; }
+	inline bool operator!=(const EntityHandle& other) const { return !operator==(other); }
+private:
+	friend class Entity;
+	
+	EntityHandle(unsigned int index, unsigned int generation) :
+		m_index(index),
+		m_generation(generation) {}
+	
+	unsigned int m_index;
+	unsigned int m_generation; //Generations start at 1, so a default handle never resolves
+};
+
+//Walks over an entity and everything attached to it, parents before their children. The
+//parent links in the tree double as the iterator's stack, so it never allocates. The tree
+//must not be changed while it's being iterated over; use Entity::Destroy to remove entities.
+class EntityIterator
+{
+public:
+	EntityIterator(Entity* root) :
+		m_root(root),
+		m_current(root) {}
+	
+	//Moves on to the next entity, or past the end, in which case Get returns 0.
+	void Next();
+	//Like Next, but skips everything attached to the current entity.
+	void NextSkipChildren();
+	
+	inline Entity* Get()   const { return m_current; }
+	inline bool IsDone()   const { return m_current == 0; }
+private:
+	Entity* m_root;
+	Entity* m_current;
+};
+
+//What a visitor passed to Entity::Visit wants to happen next.
+enum VisitResult
+{
+	VISIT_CONTINUE,
+	VISIT_SKIP_CHILDREN,
+	VISIT_STOP
+};
+
 class Entity
 {
 public:
 	Entity(const Vector3f& pos = Vector3f(0,0,0), const Quaternion& rot = Quaternion(0,0,0,1), float scale = 1.0f) : 
 		m_transform(pos, rot, scale),
-		m_coreEngine(0) {}
+		m_coreEngine(0),
+		m_parent(0),
+		m_indexInParent(0),
+		m_arena(0),
+		m_handle(AllocateHandle(this)),
+		m_isPendingDestroy(false),
+		m_subtreeSize(1),
+		m_subtreeIsEntityLocal(true),
+		m_subtreeInfoDirty(true),
+		m_subtreeVersion(0),
+		m_attachedCacheVersion(-1) {}
 		
 	virtual ~Entity();
 	
+	//Entities are allocated from size class pools, or from a MemoryArena when one is given.
+	//Either way, they are deleted the regular way.
+	static void* operator new(size_t size)                        { return MemoryPool::AllocateObject(size); }
+	static void* operator new(size_t size, MemoryArena& arena)    { return MemoryPool::AllocateObject(size, arena); }
+	static void operator delete(void* memory)                     { MemoryPool::FreeObject(memory); }
+	static void operator delete(void* memory, MemoryArena& arena) { MemoryPool::FreeObject(memory); }
+	
+	//Creates an entity in the given arena, or in a pool if there is none. Children and components
+	//created through CreateChild and CreateComponent are allocated from the same arena.
+	static Entity* Create(MemoryArena* arena, const Vector3f& pos = Vector3f(0,0,0), const Quaternion& rot = Quaternion(0,0,0,1), float scale = 1.0f);
+	
 	Entity* AddChild(Entity* child);
 	Entity* AddComponent(EntityComponent* component);
 	
+	//Unlike AddChild and AddComponent, these return the newly created object.
+	Entity* CreateChild(const Vector3f& pos = Vector3f(0,0,0), const Quaternion& rot = Quaternion(0,0,0,1), float scale = 1.0f);
+	template<class T, typename... Args>
+	T* CreateComponent(Args&&... args);
+	
+	void DeleteAllChildren();
+	
+	//Queues this entity, and everything attached to it, for destruction. Until the queue is flushed
+	//with DestroyPendingEntities, the entity stays where it is and keeps being updated and rendered,
+	//so it is safe to call this from anywhere that runs on the main thread, such as ACCESS_SHARED
+	//components. Entities that come and go a lot should not be created in an arena, since the
+	//arena only gets it's memory back when it's reset.
+	void Destroy();
+	inline bool IsPendingDestroy() const { return m_isPendingDestroy; }
+	
+	//Deletes everything queued with Destroy. Game does this after each update.
+	static void DestroyPendingEntities();
+	
+	//Handles may be resolved from any thread, as long as no entities are being created or
+	//deleted at the same time, which is the case during parallel updates.
+	static Entity* Resolve(const EntityHandle& handle);
+	
 	void ProcessInputAll(const Input& input, float delta);
 	void UpdateAll(float delta);
+	
+	//Parallel versions of ProcessInputAll and UpdateAll. Subtrees where every component is
+	//ACCESS_ENTITY_LOCAL are processed on the job system; everything else, including the entities
+	//above those subtrees, is processed on the calling thread first.
+	void ProcessInputAll(const Input& input, float delta, JobSystem* jobSystem);
+	void UpdateAll(float delta, JobSystem* jobSystem);
 	void RenderAll(const Shader& shader, const RenderingEngine& renderingEngine, const Camera& camera) const;
 	
-	std::vector<Entity*> GetAllAttached();
+	//Calls visitor(Entity*) on this entity and everything attached to it, parents before their
+	//children. The visitor returns a VisitResult, so it can skip parts of the tree or stop early.
+	//Returns false if the visitor stopped.
+	template<typename Visitor>
+	bool Visit(Visitor& visitor);
+	
+	//This entity and everything attached to it, parents before their children. The list is cached,
+	//and only rebuilt when entities are added to or removed from this part of the tree.
+	const std::vector<Entity*>& GetAllAttached();
+	
+	inline unsigned int GetNumChildren()                 const { return (unsigned int)m_children.size(); }
+	inline Entity* GetChild(unsigned int index)                { return m_children[index]; }
+	inline Entity* GetParent()                                 { return m_parent; }
+	inline unsigned int GetNumComponents()               const { return (unsigned int)m_components.size(); }
+	inline EntityComponent* GetComponent(unsigned int index)   { return m_components[index]; }
 	
 	inline Transform* GetTransform() { return &m_transform; }
+	inline CoreEngine* GetEngine()   { return m_coreEngine; }
+	inline MemoryArena* GetArena()   { return m_arena; }
+	inline EntityHandle GetHandle() const { return m_handle; }
 	void SetEngine(CoreEngine* engine);
 protected:
 private:
@@ -36,13 +169,98 @@ private:
 	std::vector<EntityComponent*> m_components;
 	Transform                     m_transform;
 	CoreEngine*                   m_coreEngine;
+	Entity*                       m_parent;
+	unsigned int                  m_indexInParent;        //Where this entity is in it's parent's children
+	MemoryArena*                  m_arena;                //Where CreateChild and CreateComponent allocate from; 0 for the pools
+	EntityHandle                  m_handle;
+	bool                          m_isPendingDestroy;
+	
+	unsigned int                  m_subtreeSize;          //Number of entities in this subtree, including this one
+	bool                          m_subtreeIsEntityLocal; //Whether every component in this subtree is ACCESS_ENTITY_LOCAL
+	bool                          m_subtreeInfoDirty;     //Whether the two above need to be recalculated
+	int                           m_subtreeVersion;       //Goes up whenever entities are added to or removed from this subtree
+	int                           m_attachedCacheVersion; //The subtree version m_attachedCache was built for
+	std::vector<Entity*>          m_attachedCache;
+
+	enum UpdateStage
+	{
+		STAGE_PROCESS_INPUT,
+		STAGE_UPDATE
+	};
 
 	void ProcessInput(const Input& input, float delta);
 	void Update(float delta);
 	void Render(const Shader& shader, const RenderingEngine& renderingEngine, const Camera& camera) const;
 	
+	void RunStage(UpdateStage stage, const Input* input, float delta);
+	void RunStageAll(UpdateStage stage, const Input* input, float delta);
+	void RunStageAllParallel(UpdateStage stage, const Input* input, float delta, JobSystem* jobSystem);
+	void CollectParallelSubtrees(UpdateStage stage, const Input* input, float delta, unsigned int maxSubtreeSize, std::vector<Entity*>& result);
+	void InvalidateSubtreeInfo();
+	void UpdateSubtreeInfo();
+	void RemoveFromParent();
+	void IncrementSubtreeVersion();
+	
+	//Entity slots are stored in fixed size chunks which are never moved or freed, so growing
+	//the table never copies it, and never invalidates slots that are being looked at.
+	static const unsigned int SLOTS_PER_CHUNK = 4096;
+	static const unsigned int MAX_SLOT_CHUNKS = 1024;
+	static const unsigned int NO_FREE_SLOT = 0xFFFFFFFF;
+	
+	struct Slot
+	{
+		Entity*      entity;
+		unsigned int generation;
+		unsigned int nextFreeSlot;
+	};
+	
+	static Slot*                     s_slotChunks[MAX_SLOT_CHUNKS];
+	static unsigned int              s_numSlots;
+	static unsigned int              s_firstFreeSlot;
+	static std::vector<EntityHandle> s_pendingDestroys;
+	static std::mutex                s_slotMutex;
+	
+	static EntityHandle AllocateHandle(Entity* entity);
+	static void FreeHandle(const EntityHandle& handle);
+	
+	friend class EntityIterator;
+	
 	Entity(const Entity& other) {}
 	void operator=(const Entity& other) {}
 };
 
+template<typename Visitor>
+bool Entity::Visit(Visitor& visitor)
+{
+	EntityIterator it(this);
+	while(!it.IsDone())
+	{
+		VisitResult result = visitor(it.Get());
+		if(result == VISIT_STOP)
+		{
+			return false;
+		}
+		
+		if(result == VISIT_SKIP_CHILDREN)
+			it.NextSkipChildren();
+		else
+			it.Next();
+	}
+	
+	return true;
+}
+
+inline Entity* EntityHandle::Get() const
+{
+	return Entity::Resolve(*this);
+}
+
+template<class T, typename... Args>
+T* Entity::CreateComponent(Args&&... args)
+{
+	T* component = m_arena ? new(*m_arena) T(std::forward<Args>(args)...) : new T(std::forward<Args>(args)...);
+	AddComponent(component);
+	return component;
+}
+
 #endif // GAMEOBJECT_H
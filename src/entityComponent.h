@@ -5,23 +5,53 @@
 #include "entity.h"
 #include "input.h"
 class RenderingEngine;
+class SceneComponentWriter;
 class Shader;
 
 class EntityComponent
 {
 public:
+	//Declares what state a component touches in ProcessInput and Update, so the engine knows
+	//whether it may run on a worker thread while other parts of the scene are being updated.
+	enum UpdateAccess
+	{
+		//Only reads and writes it's own state and it's entity's transform, and at most reads
+		//the transforms of the entity's ancestors. Ancestors outside the part of the scene being
+		//updated on a worker have their parent matrices frozen meanwhile, so reading them, even
+		//their world matrices, never writes to them.
+		ACCESS_ENTITY_LOCAL,
+		//Touches anything else, such as other entities, the engine, the window or global state,
+		//or adds and removes entities. These components are always updated on the main thread.
+		ACCESS_SHARED
+	};
+
 	EntityComponent() :
 		m_parent(0) {}
 	virtual ~EntityComponent() {}
+	
+	//Components are allocated the same way as entities; see Entity.
+	static void* operator new(size_t size)                        { return MemoryPool::AllocateObject(size); }
+	static void* operator new(size_t size, MemoryArena& arena)    { return MemoryPool::AllocateObject(size, arena); }
+	static void operator delete(void* memory)                     { MemoryPool::FreeObject(memory); }
+	static void operator delete(void* memory, MemoryArena& arena) { MemoryPool::FreeObject(memory); }
 
 	virtual void ProcessInput(const Input& input, float delta) {}
 	virtual void Update(float delta) {}
 	virtual void Render(const Shader& shader, const RenderingEngine& renderingEngine, const Camera& camera) const {}
 	
 	virtual void AddToEngine(CoreEngine* engine) const { }
+	virtual void RemoveFromEngine(CoreEngine* engine) const { }
+	
+	virtual UpdateAccess GetUpdateAccess() const { return ACCESS_ENTITY_LOCAL; }
+	
+	//Components with a scene type name are saved to scene files with WriteToScene, and
+	//loaded with whatever was registered for that name; see sceneFile.h.
+	virtual const char* GetSceneTypeName() const { return 0; }
+	virtual void WriteToScene(SceneComponentWriter& writer) const {}
 	
 	inline Transform* GetTransform()             { return m_parent->GetTransform(); }
 	inline const Transform& GetTransform() const { return *m_parent->GetTransform(); }
+	inline CoreEngine* GetEngine()               { return m_parent->GetEngine(); }
 	
 	virtual void SetParent(Entity* parent) { m_parent = parent; }
 private:
@@ -1,4 +1,5 @@
 #include "freeLook.h"
+#include "sceneFile.h"
 #include "window.h"
 
 void FreeLook::ProcessInput(const Input& input, float delta)
@@ -38,3 +39,10 @@ void FreeLook::ProcessInput(const Input& input, float delta)
 		m_mouseLocked = true;
 	}
 }
+
+void FreeLook::WriteToScene(SceneComponentWriter& writer) const
+{
+	writer.WriteVector2f(m_windowCenter);
+	writer.WriteFloat(m_sensitivity);
+	writer.WriteInt(m_unlockMouseKey);
+}
@@ -14,6 +14,13 @@ public:
 		m_windowCenter(windowCenter) {}
 	
 	virtual void ProcessInput(const Input& input, float delta);
+	
+	//Moves the mouse and changes the cursor, which is window state.
+	virtual UpdateAccess GetUpdateAccess() const { return ACCESS_SHARED; }
+	
+	//The window center is stored as well, so scenes should be loaded at the resolution they were saved at.
+	virtual const char* GetSceneTypeName() const { return "FreeLook"; }
+	virtual void WriteToScene(SceneComponentWriter& writer) const;
 protected:
 private:
 	float    m_sensitivity;
@@ -1,4 +1,5 @@
 #include "freeMove.h"
+#include "sceneFile.h"
 	
 void FreeMove::ProcessInput(const Input& input, float delta)
 {
@@ -18,3 +19,12 @@ void FreeMove::Move(const Vector3f& direction, float amt)
 {
 	GetTransform()->SetPos(*GetTransform()->GetPos() + (direction * amt));
 }
+
+void FreeMove::WriteToScene(SceneComponentWriter& writer) const
+{
+	writer.WriteFloat(m_speed);
+	writer.WriteInt(m_forwardKey);
+	writer.WriteInt(m_backKey);
+	writer.WriteInt(m_leftKey);
+	writer.WriteInt(m_rightKey);
+}
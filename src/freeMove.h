@@ -15,6 +15,9 @@ public:
 		m_rightKey(rightKey) {}
 	
 	virtual void ProcessInput(const Input& input, float delta);
+	
+	virtual const char* GetSceneTypeName() const { return "FreeMove"; }
+	virtual void WriteToScene(SceneComponentWriter& writer) const;
 protected:
 private:
 	void Move(const Vector3f& direction, float amt);
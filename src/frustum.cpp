@@ -0,0 +1,90 @@
+#include "frustum.h"
+#include "simdaccel.h"
+#include <cassert>
+#include <cmath>
+
+Frustum::Frustum(const Matrix4f& viewProjection)
+{
+	//Each plane is a sum or difference of the rows of the matrix, since a clip space point is
+	//inside when -w <= x, y, z <= w.
+	for(unsigned int i = 0; i < 3; i++)
+	{
+		for(unsigned int j = 0; j < 4; j++)
+		{
+			m_planes[i * 2][j]     = viewProjection[j][3] + viewProjection[j][i];
+			m_planes[i * 2 + 1][j] = viewProjection[j][3] - viewProjection[j][i];
+		}
+	}
+
+	//Normalized, so plane distances are real distances, which can be compared with radii.
+	for(unsigned int i = 0; i < NUM_PLANES; i++)
+	{
+		Vector4f& plane = m_planes[i];
+		float length = sqrtf(plane.GetX() * plane.GetX() + plane.GetY() * plane.GetY() + plane.GetZ() * plane.GetZ());
+		plane = Vector4f(plane.GetX() / length, plane.GetY() / length, plane.GetZ() / length, plane.GetW() / length);
+	}
+}
+
+bool Frustum::IntersectsSphere(const Vector3f& center, float radius) const
+{
+	for(unsigned int i = 0; i < NUM_PLANES; i++)
+	{
+		const Vector4f& plane = m_planes[i];
+		float distance = plane.GetX() * center.GetX() + plane.GetY() * center.GetY() + plane.GetZ() * center.GetZ() + plane.GetW();
+
+		if(distance < -radius)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+unsigned int Frustum::CullSpheres(const float* centersX, const float* centersY, const float* centersZ, const float* radii,
+	unsigned int count, unsigned char* results) const
+{
+	assert(count % 4 == 0);
+
+	SIMD4f planeX[NUM_PLANES];
+	SIMD4f planeY[NUM_PLANES];
+	SIMD4f planeZ[NUM_PLANES];
+	SIMD4f planeW[NUM_PLANES];
+
+	for(unsigned int i = 0; i < NUM_PLANES; i++)
+	{
+		planeX[i] = SIMD4f(m_planes[i].GetX());
+		planeY[i] = SIMD4f(m_planes[i].GetY());
+		planeZ[i] = SIMD4f(m_planes[i].GetZ());
+		planeW[i] = SIMD4f(m_planes[i].GetW());
+	}
+
+	unsigned int numVisible = 0;
+	const SIMD4f zero(0.0f);
+
+	for(unsigned int i = 0; i < count; i += 4)
+	{
+		SIMD4f x, y, z, radius;
+		x.Set(centersX + i);
+		y.Set(centersY + i);
+		z.Set(centersZ + i);
+		radius.Set(radii + i);
+
+		//A sphere is outside once it's completely behind any one of the planes.
+		SIMD4f outside = zero;
+		for(unsigned int j = 0; j < NUM_PLANES; j++)
+		{
+			SIMD4f distance = planeX[j] * x + planeY[j] * y + planeZ[j] * z + planeW[j] + radius;
+			outside |= distance < zero;
+		}
+
+		int outsideMask = outside.GetSignMask();
+		for(unsigned int j = 0; j < 4; j++)
+		{
+			results[i + j] = (unsigned char)(((outsideMask >> j) & 1) ^ 1);
+			numVisible += results[i + j];
+		}
+	}
+
+	return numVisible;
+}
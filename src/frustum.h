@@ -0,0 +1,50 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "math3d.h"
+#include <cfloat>
+
+//The volume a camera can see, stored as six planes that point inwards. Used to skip
+//everything that can't possibly end up on screen before any draw is issued.
+class Frustum
+{
+public:
+	enum
+	{
+		PLANE_LEFT,
+		PLANE_RIGHT,
+		PLANE_BOTTOM,
+		PLANE_TOP,
+		PLANE_NEAR,
+		PLANE_FAR,
+
+		NUM_PLANES
+	};
+
+	Frustum() {}
+
+	//Extracts the planes from a view projection matrix, such as Camera::GetViewProjection.
+	//The planes are in whatever space the matrix transforms from, usually world space.
+	Frustum(const Matrix4f& viewProjection);
+
+	bool IntersectsSphere(const Vector3f& center, float radius) const;
+
+	//Tests count spheres, stored as separate arrays of center coordinates and radii, four at a
+	//time. The arrays have to be padded to a multiple of 4. results[i] is set to 1 if sphere i
+	//is at least partially inside, and 0 otherwise. Returns the number of visible spheres.
+	unsigned int CullSpheres(const float* centersX, const float* centersY, const float* centersZ, const float* radii,
+		unsigned int count, unsigned char* results) const;
+
+	//Makes a plane let everything through, so the volume goes on forever past it. Shadow maps are
+	//rendered with depth clamping, so their frusta don't have a near plane.
+	inline void IgnorePlane(unsigned int index) { m_planes[index] = Vector4f(0.0f, 0.0f, 0.0f, FLT_MAX); }
+
+	//The plane's normal is in x, y and z, and it's distance from the origin in w, so a point p
+	//is inside when dot(plane.xyz, p) + plane.w >= 0.
+	inline const Vector4f& GetPlane(unsigned int index) const { return m_planes[index]; }
+protected:
+private:
+	Vector4f m_planes[NUM_PLANES];
+};
+
+#endif // FRUSTUM_H
@@ -1,21 +1,70 @@
 #include "game.h"
 #include "renderingEngine.h"
+#include "sceneFile.h"
+#include "worldPartition.h"
 #include <iostream>
 
 void Game::ProcessInput(const Input& input, float delta)
 {
 	m_inputTimer.StartInvocation();
-	m_root.ProcessInputAll(input, delta);
+	if(m_parallelUpdate && m_jobSystem)
+		m_root.ProcessInputAll(input, delta, m_jobSystem);
+	else
+		m_root.ProcessInputAll(input, delta);
 	m_inputTimer.StopInvocation();
 }
 
 void Game::Update(float delta)
 {
 	m_updateTimer.StartInvocation();
-	m_root.UpdateAll(delta);
+	if(m_parallelUpdate && m_jobSystem)
+		m_root.UpdateAll(delta, m_jobSystem);
+	else
+		m_root.UpdateAll(delta);
+	
+	if(m_worldPartition && m_engine && m_engine->GetRenderingEngine()->GetMainCamera())
+	{
+		m_worldPartition->Update(m_engine->GetRenderingEngine()->GetMainCamera()->GetTransform().GetTransformedPos(), m_root);
+	}
+	
+	//Entities destroyed during the update are deleted before anything is rendered.
+	Entity::DestroyPendingEntities();
 	m_updateTimer.StopInvocation();
 }
 
+void Game::DisplayStreamingStats(double dividend)
+{
+	//Attaching cells is part of the update, so it's already included in the update time.
+	if(m_worldPartition)
+	{
+		m_worldPartition->DisplayAndResetStats(dividend);
+	}
+}
+
+Entity* Game::AddToScene(const Vector3f& pos, const Quaternion& rot, float scale)
+{
+	Entity* result = Entity::Create(&m_sceneArena, pos, rot, scale);
+	m_root.AddChild(result);
+	return result;
+}
+
+Entity* Game::LoadScene(const std::string& fileName)
+{
+	Entity* result = SceneFile::Load(fileName, &m_sceneArena);
+	if(result)
+	{
+		m_root.AddChild(result);
+	}
+	
+	return result;
+}
+
+void Game::ClearScene()
+{
+	m_root.DeleteAllChildren();
+	m_sceneArena.Reset();
+}
+
 void Game::Render(RenderingEngine* renderingEngine)
 {
 	renderingEngine->Render(m_root);
@@ -3,12 +3,19 @@
 
 #include "entity.h"
 #include "coreEngine.h"
+#include "memoryArena.h"
 #include "profiling.h"
 
+class WorldPartition;
+
 class Game
 {
 public:
-	Game() {}
+	Game() :
+		m_engine(0),
+		m_jobSystem(0),
+		m_worldPartition(0),
+		m_parallelUpdate(false) {}
 	virtual ~Game() {}
 
 	virtual void Init(const Window& window) {}
@@ -18,17 +25,46 @@ public:
 	
 	inline double DisplayInputTime(double dividend) { return m_inputTimer.DisplayAndReset("Input Time: ", dividend); }
 	inline double DisplayUpdateTime(double dividend) { return m_updateTimer.DisplayAndReset("Update Time: ", dividend); }
+	void DisplayStreamingStats(double dividend);
+	
+	inline void SetEngine(CoreEngine* engine) { m_engine = engine; m_jobSystem = engine ? engine->GetJobSystem() : 0; m_root.SetEngine(engine); }
+	inline JobSystem* GetJobSystem()          { return m_jobSystem; }
+	//SetEngine uses the engine's job system. This is for games run without an engine, like the
+	//benchmarks.
+	inline void SetJobSystem(JobSystem* jobSystem) { m_jobSystem = jobSystem; }
 	
-	inline void SetEngine(CoreEngine* engine) { m_root.SetEngine(engine); }
+	//When enabled, independent parts of the scene are processed and updated on the job system.
+	//See EntityComponent::UpdateAccess for what components have to guarantee for this.
+	inline void SetParallelUpdate(bool parallelUpdate) { m_parallelUpdate = parallelUpdate; }
 protected:
 	void AddToScene(Entity* child) { m_root.AddChild(child); }
+	
+	//Creates a new entity in the scene arena and adds it to the scene. Everything created
+	//through it with CreateChild and CreateComponent is allocated from the scene arena as well.
+	Entity* AddToScene(const Vector3f& pos = Vector3f(0,0,0), const Quaternion& rot = Quaternion(0,0,0,1), float scale = 1.0f);
+	
+	//Loads a scene file into the scene arena and adds it to the scene. Returns the root of the
+	//loaded scene, or 0 if it couldn't be loaded.
+	Entity* LoadScene(const std::string& fileName);
+	
+	//Deletes everything in the scene, and releases the whole scene arena at once.
+	void ClearScene();
+	
+	//Streams the cells of worldPartition in and out around the main camera after every update.
+	//The game keeps ownership, and has to keep it alive until it's set back to 0.
+	inline void SetWorldPartition(WorldPartition* worldPartition) { m_worldPartition = worldPartition; }
 private:
 	Game(Game& game) {}
 	void operator=(Game& game) {}
 	
-	ProfileTimer m_updateTimer;
-	ProfileTimer m_inputTimer;
-	Entity       m_root;
+	ProfileTimer    m_updateTimer;
+	ProfileTimer    m_inputTimer;
+	MemoryArena     m_sceneArena; //Declared before the root, so it outlives all entities in it
+	Entity          m_root;
+	CoreEngine*     m_engine;
+	JobSystem*      m_jobSystem;
+	WorldPartition* m_worldPartition;
+	bool            m_parallelUpdate;
 };
 
 #endif
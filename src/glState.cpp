@@ -0,0 +1,288 @@
+#include "glState.h"
+#include "profiling.h"
+#include <cassert>
+
+GLuint GLState::s_program = GLState::UNKNOWN;
+GLuint GLState::s_vertexArray = GLState::UNKNOWN;
+GLuint GLState::s_frameBuffer = GLState::UNKNOWN;
+GLuint GLState::s_activeTextureUnit = GLState::UNKNOWN;
+GLenum GLState::s_textureTargets[MAX_TEXTURE_UNITS];
+GLuint GLState::s_textures[MAX_TEXTURE_UNITS];
+int    GLState::s_viewport[4];
+int    GLState::s_scissor[4];
+int    GLState::s_capabilities[NUM_CAPABILITIES];
+GLenum GLState::s_blendFactors[2];
+GLenum GLState::s_depthFunc = GLState::UNKNOWN;
+int    GLState::s_depthMask = -1;
+GLenum GLState::s_cullFace = GLState::UNKNOWN;
+GLenum GLState::s_frontFace = GLState::UNKNOWN;
+
+void GLState::UseProgram(GLuint program)
+{
+	if(Change(s_program, program))
+	{
+		RenderCounters::numProgramBinds++;
+		glUseProgram(program);
+	}
+}
+
+void GLState::BindVertexArray(GLuint vertexArray)
+{
+	if(Change(s_vertexArray, vertexArray))
+	{
+		RenderCounters::numVertexArrayBinds++;
+		glBindVertexArray(vertexArray);
+	}
+}
+
+void GLState::BindFramebuffer(GLuint frameBuffer)
+{
+	if(Change(s_frameBuffer, frameBuffer))
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+	}
+}
+
+void GLState::BindTexture(unsigned int unit, GLenum target, GLuint texture)
+{
+	assert(unit < MAX_TEXTURE_UNITS);
+
+	//Only the last target bound on each unit is remembered, so binding another target's texture
+	//and then going back always reaches GL, which is still correct.
+	if(s_textureTargets[unit] == target && s_textures[unit] == texture)
+	{
+		RenderCounters::numRedundantStateChanges++;
+		return;
+	}
+
+	if(s_activeTextureUnit != unit)
+	{
+		RenderCounters::numStateChanges++;
+		s_activeTextureUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+
+	RenderCounters::numStateChanges++;
+	RenderCounters::numTextureBinds++;
+	s_textureTargets[unit] = target;
+	s_textures[unit] = texture;
+	glBindTexture(target, texture);
+}
+
+void GLState::Viewport(int x, int y, int width, int height)
+{
+	if(s_viewport[0] == x && s_viewport[1] == y && s_viewport[2] == width && s_viewport[3] == height)
+	{
+		RenderCounters::numRedundantStateChanges++;
+		return;
+	}
+
+	RenderCounters::numStateChanges++;
+	s_viewport[0] = x;
+	s_viewport[1] = y;
+	s_viewport[2] = width;
+	s_viewport[3] = height;
+	glViewport(x, y, width, height);
+}
+
+void GLState::Scissor(int x, int y, int width, int height)
+{
+	if(s_scissor[0] == x && s_scissor[1] == y && s_scissor[2] == width && s_scissor[3] == height)
+	{
+		RenderCounters::numRedundantStateChanges++;
+		return;
+	}
+
+	RenderCounters::numStateChanges++;
+	s_scissor[0] = x;
+	s_scissor[1] = y;
+	s_scissor[2] = width;
+	s_scissor[3] = height;
+	glScissor(x, y, width, height);
+}
+
+void GLState::Enable(GLenum capability)
+{
+	SetCapability(capability, true);
+}
+
+void GLState::Disable(GLenum capability)
+{
+	SetCapability(capability, false);
+}
+
+void GLState::BlendFunc(GLenum sourceFactor, GLenum destFactor)
+{
+	if(s_blendFactors[0] == sourceFactor && s_blendFactors[1] == destFactor)
+	{
+		RenderCounters::numRedundantStateChanges++;
+		return;
+	}
+
+	RenderCounters::numStateChanges++;
+	s_blendFactors[0] = sourceFactor;
+	s_blendFactors[1] = destFactor;
+	glBlendFunc(sourceFactor, destFactor);
+}
+
+void GLState::DepthFunc(GLenum func)
+{
+	if(Change(s_depthFunc, func))
+	{
+		glDepthFunc(func);
+	}
+}
+
+void GLState::DepthMask(bool mask)
+{
+	if(s_depthMask == (int)mask)
+	{
+		RenderCounters::numRedundantStateChanges++;
+		return;
+	}
+
+	RenderCounters::numStateChanges++;
+	s_depthMask = (int)mask;
+	glDepthMask(mask ? GL_TRUE : GL_FALSE);
+}
+
+void GLState::CullFace(GLenum face)
+{
+	if(Change(s_cullFace, face))
+	{
+		glCullFace(face);
+	}
+}
+
+void GLState::FrontFace(GLenum face)
+{
+	if(Change(s_frontFace, face))
+	{
+		glFrontFace(face);
+	}
+}
+
+void GLState::DeleteProgram(GLuint program)
+{
+	//GL stops using a deleted program only once another one is used.
+	if(s_program == program)
+	{
+		s_program = UNKNOWN;
+	}
+	glDeleteProgram(program);
+}
+
+void GLState::DeleteVertexArray(GLuint vertexArray)
+{
+	//GL binds 0 in place of a deleted vertex array, framebuffer or texture.
+	if(s_vertexArray == vertexArray)
+	{
+		s_vertexArray = 0;
+	}
+	glDeleteVertexArrays(1, &vertexArray);
+}
+
+void GLState::DeleteFramebuffer(GLuint frameBuffer)
+{
+	if(s_frameBuffer == frameBuffer)
+	{
+		s_frameBuffer = 0;
+	}
+	glDeleteFramebuffers(1, &frameBuffer);
+}
+
+void GLState::DeleteTextures(int numTextures, const GLuint* textures)
+{
+	for(int i = 0; i < numTextures; i++)
+	{
+		for(unsigned int j = 0; j < MAX_TEXTURE_UNITS; j++)
+		{
+			if(s_textures[j] == textures[i])
+			{
+				s_textures[j] = 0;
+			}
+		}
+	}
+	glDeleteTextures(numTextures, textures);
+}
+
+void GLState::Invalidate()
+{
+	s_program = UNKNOWN;
+	s_vertexArray = UNKNOWN;
+	s_frameBuffer = UNKNOWN;
+	s_activeTextureUnit = UNKNOWN;
+
+	for(unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		s_textureTargets[i] = UNKNOWN;
+		s_textures[i] = UNKNOWN;
+	}
+
+	for(int i = 0; i < 4; i++)
+	{
+		s_viewport[i] = -1;
+		s_scissor[i] = -1;
+	}
+
+	for(int i = 0; i < NUM_CAPABILITIES; i++)
+	{
+		s_capabilities[i] = -1;
+	}
+
+	s_blendFactors[0] = s_blendFactors[1] = UNKNOWN;
+	s_depthFunc = UNKNOWN;
+	s_depthMask = -1;
+	s_cullFace = UNKNOWN;
+	s_frontFace = UNKNOWN;
+}
+
+GLState::Capability GLState::GetCapability(GLenum capability)
+{
+	switch(capability)
+	{
+		case GL_BLEND:        return CAPABILITY_BLEND;
+		case GL_CULL_FACE:    return CAPABILITY_CULL_FACE;
+		case GL_DEPTH_CLAMP:  return CAPABILITY_DEPTH_CLAMP;
+		case GL_DEPTH_TEST:   return CAPABILITY_DEPTH_TEST;
+		case GL_SCISSOR_TEST: return CAPABILITY_SCISSOR_TEST;
+		default:              return CAPABILITY_UNCACHED;
+	}
+}
+
+void GLState::SetCapability(GLenum capability, bool enabled)
+{
+	Capability index = GetCapability(capability);
+	if(index != CAPABILITY_UNCACHED)
+	{
+		if(s_capabilities[index] == (int)enabled)
+		{
+			RenderCounters::numRedundantStateChanges++;
+			return;
+		}
+		s_capabilities[index] = (int)enabled;
+	}
+
+	RenderCounters::numStateChanges++;
+	if(enabled)
+	{
+		glEnable(capability);
+	}
+	else
+	{
+		glDisable(capability);
+	}
+}
+
+bool GLState::Change(GLuint& current, GLuint value)
+{
+	if(current == value)
+	{
+		RenderCounters::numRedundantStateChanges++;
+		return false;
+	}
+
+	RenderCounters::numStateChanges++;
+	current = value;
+	return true;
+}
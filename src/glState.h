@@ -0,0 +1,83 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <GL/glew.h>
+
+//Remembers the GL state that's set through it, so setting something to what it already is
+//never reaches GL. Every change to this state has to go through here, including the binds made
+//while creating objects, or the cache goes out of date. Objects have to be deleted through here
+//too, since GL reuses the names of deleted objects. Nothing is cached until Invalidate() is
+//called for a new context.
+//
+//Every call counts as a state change in RenderCounters, either issued or redundant.
+class GLState
+{
+public:
+	static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+	static void UseProgram(GLuint program);
+	static void BindVertexArray(GLuint vertexArray);
+	static void BindFramebuffer(GLuint frameBuffer);
+	static void BindTexture(unsigned int unit, GLenum target, GLuint texture);
+	static void Viewport(int x, int y, int width, int height);
+	static void Scissor(int x, int y, int width, int height);
+
+	//Only the capabilities the renderer uses are cached, the rest always reach GL.
+	static void Enable(GLenum capability);
+	static void Disable(GLenum capability);
+	static void BlendFunc(GLenum sourceFactor, GLenum destFactor);
+	static void DepthFunc(GLenum func);
+	static void DepthMask(bool mask);
+	static void CullFace(GLenum face);
+	static void FrontFace(GLenum face);
+
+	static void DeleteProgram(GLuint program);
+	static void DeleteVertexArray(GLuint vertexArray);
+	static void DeleteFramebuffer(GLuint frameBuffer);
+	static void DeleteTextures(int numTextures, const GLuint* textures);
+
+	//Forgets everything, for a new context, or when something outside the engine may have changed
+	//GL's state.
+	static void Invalidate();
+protected:
+private:
+	enum Capability
+	{
+		CAPABILITY_BLEND,
+		CAPABILITY_CULL_FACE,
+		CAPABILITY_DEPTH_CLAMP,
+		CAPABILITY_DEPTH_TEST,
+		CAPABILITY_SCISSOR_TEST,
+
+		NUM_CAPABILITIES,
+		CAPABILITY_UNCACHED = NUM_CAPABILITIES
+	};
+
+	//Nothing is known about GL's state until it's first set.
+	static const GLuint UNKNOWN = ~0u;
+
+	static GLuint s_program;
+	static GLuint s_vertexArray;
+	static GLuint s_frameBuffer;
+	static GLuint s_activeTextureUnit;
+	static GLenum s_textureTargets[MAX_TEXTURE_UNITS];
+	static GLuint s_textures[MAX_TEXTURE_UNITS];
+	static int    s_viewport[4];
+	static int    s_scissor[4];
+	static int    s_capabilities[NUM_CAPABILITIES]; //-1 if unknown
+	static GLenum s_blendFactors[2];
+	static GLenum s_depthFunc;
+	static int    s_depthMask;                       //-1 if unknown
+	static GLenum s_cullFace;
+	static GLenum s_frontFace;
+
+	static Capability GetCapability(GLenum capability);
+	static void SetCapability(GLenum capability, bool enabled);
+	//Returns true, and counts an issued state change, if value isn't what's already set, after
+	//which value is set.
+	static bool Change(GLuint& current, GLuint value);
+
+	GLState() {}
+};
+
+#endif // GLSTATE_H
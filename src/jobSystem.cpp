@@ -0,0 +1,393 @@
+#include "jobSystem.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+//Number of times an idle worker yields before it goes to sleep. Sleeping workers are woken
+//up when new jobs are run, or after a millisecond at the latest.
+static const int IDLE_SPINS_BEFORE_SLEEP = 64;
+
+//Each worker thread knows which job system it belongs to, and which worker it is. The thread
+//that started a job system is not a worker thread, and is always recognized as worker 0.
+static thread_local const JobSystem* t_jobSystem = 0;
+static thread_local int t_workerIndex = -1;
+
+//--------------------------------------------------------------------------------
+// WorkStealingQueue
+//--------------------------------------------------------------------------------
+bool WorkStealingQueue::Push(Job* job)
+{
+	long long bottom = m_bottom.load(std::memory_order_relaxed);
+	long long top = m_top.load(std::memory_order_acquire);
+
+	if(bottom - top >= CAPACITY)
+	{
+		return false;
+	}
+
+	//The release store makes the job visible to thieves before the new bottom is.
+	m_jobs[bottom & MASK].store(job, std::memory_order_relaxed);
+	m_bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+Job* WorkStealingQueue::Pop()
+{
+	long long bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long top = m_top.load(std::memory_order_relaxed);
+
+	if(top > bottom)
+	{
+		//The queue was already empty
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return 0;
+	}
+
+	Job* job = m_jobs[bottom & MASK].load(std::memory_order_relaxed);
+	if(top == bottom)
+	{
+		//This is the last job in the queue, so a thief may be trying to take it at the same time.
+		if(!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			job = 0;
+		}
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+Job* WorkStealingQueue::Steal()
+{
+	long long top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long bottom = m_bottom.load(std::memory_order_acquire);
+
+	if(top >= bottom)
+	{
+		return 0;
+	}
+
+	Job* job = m_jobs[top & MASK].load(std::memory_order_relaxed);
+	if(!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		//Lost the race against the owner or another thief
+		return 0;
+	}
+
+	return job;
+}
+
+//--------------------------------------------------------------------------------
+// Constructors/Destructors
+//--------------------------------------------------------------------------------
+JobSystem::JobSystem() :
+	m_mainThreadId(std::this_thread::get_id()),
+	m_isRunning(false),
+	m_numSleepingWorkers(0)
+{
+	//A single worker without a thread, so jobs can be used before the system is started.
+	CreateWorkers(1);
+}
+
+JobSystem::~JobSystem()
+{
+	Stop();
+	DestroyWorkers();
+}
+
+//--------------------------------------------------------------------------------
+// Member Function Implementation
+//--------------------------------------------------------------------------------
+void JobSystem::Start(unsigned int numWorkers)
+{
+	if(m_isRunning)
+	{
+		return;
+	}
+
+	if(numWorkers == 0)
+	{
+		numWorkers = std::thread::hardware_concurrency();
+		numWorkers = numWorkers == 0 ? 1 : numWorkers;
+	}
+
+	DestroyWorkers();
+	CreateWorkers(numWorkers);
+
+	m_mainThreadId = std::this_thread::get_id();
+	m_isRunning = true;
+
+	for(unsigned int i = 1; i < m_workers.size(); i++)
+	{
+		m_workers[i]->thread = std::thread(&JobSystem::WorkerMain, this, (int)i);
+	}
+}
+
+void JobSystem::Stop()
+{
+	if(!m_isRunning)
+	{
+		return;
+	}
+
+	m_isRunning = false;
+	m_wakeCondition.notify_all();
+
+	for(unsigned int i = 1; i < m_workers.size(); i++)
+	{
+		m_workers[i]->thread.join();
+	}
+
+	DestroyWorkers();
+	CreateWorkers(1);
+}
+
+Job* JobSystem::CreateJob(JobFunction function, const void* data, size_t dataSize)
+{
+	return CreateChildJob(0, function, data, dataSize);
+}
+
+Job* JobSystem::CreateChildJob(Job* parent, JobFunction function, const void* data, size_t dataSize)
+{
+	int workerIndex = GetWorkerIndex();
+	if(workerIndex < 0)
+	{
+		std::cerr << "Error: Jobs can only be created by the thread that started the job system, or by other jobs" << std::endl;
+		assert(workerIndex >= 0);
+		return 0;
+	}
+
+	assert(dataSize <= Job::MAX_DATA_SIZE);
+
+	Job* job = AllocateJob(workerIndex);
+	job->m_function = function;
+	job->m_parent = parent;
+	job->m_unfinishedJobs.store(1, std::memory_order_relaxed);
+
+	if(dataSize > 0)
+	{
+		memcpy(job->m_data, data, dataSize);
+	}
+
+	if(parent)
+	{
+		parent->m_unfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+void JobSystem::Run(Job* job)
+{
+	int workerIndex = GetWorkerIndex();
+	if(workerIndex < 0 || !m_workers[workerIndex]->queue.Push(job))
+	{
+		//There's nowhere to put the job, so the current thread has to do it.
+		Execute(job);
+		return;
+	}
+
+	if(m_numSleepingWorkers.load(std::memory_order_relaxed) > 0)
+	{
+		m_wakeCondition.notify_one();
+	}
+}
+
+void JobSystem::Wait(const Job* job)
+{
+	int workerIndex = GetWorkerIndex();
+
+	while(!job->IsFinished())
+	{
+		Job* nextJob = workerIndex >= 0 ? GetJob(workerIndex) : 0;
+		if(nextJob)
+		{
+			Execute(nextJob);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+int JobSystem::GetWorkerIndex() const
+{
+	if(t_jobSystem == this)
+	{
+		return t_workerIndex;
+	}
+
+	if(std::this_thread::get_id() == m_mainThreadId)
+	{
+		return 0;
+	}
+
+	return -1;
+}
+
+Job* JobSystem::AllocateJob(int workerIndex)
+{
+	Worker* worker = m_workers[workerIndex];
+
+	//Jobs are recycled in a ring, and a slot may only be reused once the job that was previously
+	//in it has finished. Slots still in use are skipped, and if every job in the ring is still
+	//running, the worker helps out with other work until one of them has finished.
+	while(true)
+	{
+		for(unsigned int i = 0; i < MAX_JOBS_PER_WORKER; i++)
+		{
+			Job* job = &worker->jobPool[worker->numAllocatedJobs++ & (MAX_JOBS_PER_WORKER - 1)];
+			if(job->IsFinished())
+			{
+				return job;
+			}
+		}
+
+		Job* otherJob = GetJob(workerIndex);
+		if(otherJob)
+		{
+			Execute(otherJob);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+Job* JobSystem::GetJob(int workerIndex)
+{
+	Worker* worker = m_workers[workerIndex];
+
+	Job* job = worker->queue.Pop();
+	if(job)
+	{
+		return job;
+	}
+
+	unsigned int numWorkers = (unsigned int)m_workers.size();
+	if(numWorkers <= 1)
+	{
+		return 0;
+	}
+
+	//Start stealing at a random worker so thieves don't all pile onto the same queue.
+	worker->randomSeed ^= worker->randomSeed << 13;
+	worker->randomSeed ^= worker->randomSeed >> 17;
+	worker->randomSeed ^= worker->randomSeed << 5;
+	unsigned int firstVictim = worker->randomSeed % numWorkers;
+
+	for(unsigned int i = 0; i < numWorkers; i++)
+	{
+		unsigned int victim = (firstVictim + i) % numWorkers;
+		if(victim == (unsigned int)workerIndex)
+		{
+			continue;
+		}
+
+		job = m_workers[victim]->queue.Steal();
+		if(job)
+		{
+			return job;
+		}
+	}
+
+	return 0;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	job->m_function(this, job, job->m_data);
+	Finish(job);
+}
+
+void JobSystem::Finish(Job* job)
+{
+	//The parent has to be read first, because the job may be recycled as soon
+	//as it's counter reaches zero.
+	Job* parent = job->m_parent;
+
+	if(job->m_unfinishedJobs.fetch_sub(1, std::memory_order_acq_rel) == 1 && parent)
+	{
+		Finish(parent);
+	}
+}
+
+void JobSystem::WorkerMain(int workerIndex)
+{
+	t_jobSystem = this;
+	t_workerIndex = workerIndex;
+
+	int idleSpins = 0;
+	while(m_isRunning)
+	{
+		Job* job = GetJob(workerIndex);
+		if(job)
+		{
+			Execute(job);
+			idleSpins = 0;
+		}
+		else if(idleSpins < IDLE_SPINS_BEFORE_SLEEP)
+		{
+			std::this_thread::yield();
+			idleSpins++;
+		}
+		else
+		{
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_numSleepingWorkers++;
+			m_wakeCondition.wait_for(lock, std::chrono::milliseconds(1));
+			m_numSleepingWorkers--;
+		}
+	}
+
+	t_jobSystem = 0;
+	t_workerIndex = -1;
+}
+
+void JobSystem::CreateWorkers(unsigned int numWorkers)
+{
+	for(unsigned int i = 0; i < numWorkers; i++)
+	{
+		Worker* worker = new Worker();
+		worker->randomSeed = 2463534242u + i * 7919u;
+		m_workers.push_back(worker);
+	}
+}
+
+void JobSystem::DestroyWorkers()
+{
+	for(unsigned int i = 0; i < m_workers.size(); i++)
+	{
+		delete m_workers[i];
+	}
+
+	m_workers.clear();
+}
+
+//--------------------------------------------------------------------------------
+// Static Function Implementations
+//--------------------------------------------------------------------------------
+void JobSystem::ParallelForJob(JobSystem* jobSystem, Job* job, const void* data)
+{
+	ParallelForData range = *(const ParallelForData*)data;
+
+	//The upper half of the range is split off until the rest is small enough. Thieves take the
+	//oldest jobs in a queue, so idle workers always steal the largest remaining pieces.
+	while(range.end - range.begin > range.grainSize)
+	{
+		ParallelForData upperHalf = range;
+		upperHalf.begin = range.begin + (range.end - range.begin)/2;
+		range.end = upperHalf.begin;
+
+		jobSystem->Run(jobSystem->CreateChildJob(job, &ParallelForJob, &upperHalf, sizeof(upperHalf)));
+	}
+
+	range.invoke(range.function, range.begin, range.end);
+}
@@ -0,0 +1,194 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Job;
+class JobSystem;
+
+//Signature of all functions run by the job system. The data pointer refers to the copy of
+//the data that was handed to CreateJob, stored inside the job itself.
+typedef void (*JobFunction)(JobSystem* jobSystem, Job* job, const void* data);
+
+//A Job is a small unit of work that can run on any worker thread. Jobs are allocated
+//by the job system and are only valid until they have finished; they should never be
+//created or deleted by the user.
+class Job
+{
+public:
+	//Number of bytes of user data that can be stored inside a job.
+	static const size_t MAX_DATA_SIZE = 104;
+
+	Job() :
+		m_function(0),
+		m_parent(0),
+		m_unfinishedJobs(0),
+		m_padding(0) {}
+
+	inline bool IsFinished() const { return m_unfinishedJobs.load(std::memory_order_acquire) <= 0; }
+private:
+	friend class JobSystem;
+
+	JobFunction      m_function;       //What this job does
+	Job*             m_parent;         //Job that can't finish until this one has
+	std::atomic<int> m_unfinishedJobs; //This job, plus all of it's unfinished children
+	int              m_padding;
+	unsigned char    m_data[MAX_DATA_SIZE];
+};
+
+//Lock free Chase-Lev deque. The worker owning the queue pushes and pops jobs at the bottom,
+//while any other worker may steal jobs from the top. The capacity is fixed; Push fails
+//when the queue is full, in which case the caller should just run the job itself.
+class WorkStealingQueue
+{
+public:
+	WorkStealingQueue() :
+		m_top(0),
+		m_bottom(0) {}
+
+	bool Push(Job* job);
+	Job* Pop();
+	Job* Steal();
+
+	inline int GetSize() const { return (int)(m_bottom.load(std::memory_order_relaxed) - m_top.load(std::memory_order_relaxed)); }
+private:
+	static const long long CAPACITY = 4096;
+	static const long long MASK = CAPACITY - 1;
+
+	//Top and bottom are kept on separate cache lines so thieves and the owner don't
+	//invalidate each other's cache every time they touch the queue.
+	alignas(64) std::atomic<long long> m_top;
+	alignas(64) std::atomic<long long> m_bottom;
+	alignas(64) std::atomic<Job*>      m_jobs[CAPACITY];
+
+	WorkStealingQueue(const WorkStealingQueue& other) {}
+	void operator=(const WorkStealingQueue& other) {}
+};
+
+//The JobSystem runs one worker per core, where the thread that calls Start is always
+//worker 0. Each worker owns a work stealing queue, and workers without work steal from
+//the others. Jobs can be created as children of other jobs, and waiting on a job means
+//waiting for it and all of it's children to finish. Until Start is called (or after Stop),
+//all jobs are executed by the calling thread.
+class JobSystem
+{
+public:
+	JobSystem();
+	virtual ~JobSystem();
+
+	//Starts the worker threads. A thread count of 0 means one worker per core.
+	void Start(unsigned int numWorkers = 0);
+	void Stop();
+
+	Job* CreateJob(JobFunction function, const void* data = 0, size_t dataSize = 0);
+	Job* CreateChildJob(Job* parent, JobFunction function, const void* data = 0, size_t dataSize = 0);
+
+	void Run(Job* job);
+
+	//Blocks until the job and all of it's children have finished. The waiting thread
+	//executes other jobs in the meantime, so it is safe to wait from inside a job.
+	void Wait(const Job* job);
+
+	//Calls function(rangeBegin, rangeEnd) over [begin, end), split into ranges of no more than grainSize
+	//elements which are executed in parallel. A grain size of 0 picks one based on the number of workers.
+	template<typename Function>
+	void ParallelFor(unsigned int begin, unsigned int end, unsigned int grainSize, const Function& function);
+
+	inline unsigned int GetNumWorkers() const { return (unsigned int)m_workers.size(); }
+	inline bool IsRunning()             const { return m_isRunning; }
+protected:
+private:
+	//Maximum number of unfinished jobs created by a single worker
+	static const unsigned int MAX_JOBS_PER_WORKER = 4096;
+
+	struct Worker
+	{
+		Worker() :
+			jobPool(new Job[MAX_JOBS_PER_WORKER]),
+			numAllocatedJobs(0),
+			randomSeed(0) {}
+		~Worker() { delete[] jobPool; }
+
+		WorkStealingQueue queue;
+		Job*              jobPool;
+		unsigned int      numAllocatedJobs;
+		unsigned int      randomSeed;
+		std::thread       thread;
+	};
+
+	struct ParallelForData
+	{
+		void (*invoke)(const void* function, unsigned int rangeBegin, unsigned int rangeEnd);
+		const void*  function;
+		unsigned int begin;
+		unsigned int end;
+		unsigned int grainSize;
+	};
+
+	std::vector<Worker*>    m_workers;
+	std::thread::id         m_mainThreadId;
+	std::atomic<bool>       m_isRunning;
+	std::atomic<int>        m_numSleepingWorkers;
+	std::mutex              m_sleepMutex;
+	std::condition_variable m_wakeCondition;
+
+	int GetWorkerIndex() const;
+	Job* AllocateJob(int workerIndex);
+	Job* GetJob(int workerIndex);
+	void Execute(Job* job);
+	void Finish(Job* job);
+	void WorkerMain(int workerIndex);
+	void CreateWorkers(unsigned int numWorkers);
+	void DestroyWorkers();
+
+	static void ParallelForJob(JobSystem* jobSystem, Job* job, const void* data);
+
+	template<typename Function>
+	static void InvokeRange(const void* function, unsigned int rangeBegin, unsigned int rangeEnd)
+	{
+		(*(const Function*)function)(rangeBegin, rangeEnd);
+	}
+
+	JobSystem(const JobSystem& other) {}
+	void operator=(const JobSystem& other) {}
+};
+
+template<typename Function>
+void JobSystem::ParallelFor(unsigned int begin, unsigned int end, unsigned int grainSize, const Function& function)
+{
+	if(begin >= end)
+	{
+		return;
+	}
+
+	if(grainSize == 0)
+	{
+		//Several ranges per worker leaves room for stealing to even out the load.
+		grainSize = (end - begin) / (GetNumWorkers() * 8);
+		grainSize = grainSize == 0 ? 1 : grainSize;
+	}
+
+	if(GetNumWorkers() == 1 || end - begin <= grainSize)
+	{
+		function(begin, end);
+		return;
+	}
+
+	ParallelForData data;
+	data.invoke = &InvokeRange<Function>;
+	data.function = &function;
+	data.begin = begin;
+	data.end = end;
+	data.grainSize = grainSize;
+
+	Job* root = CreateJob(&ParallelForJob, &data, sizeof(data));
+	Run(root);
+	Wait(root);
+}
+
+#endif // JOBSYSTEM_H
@@ -0,0 +1,286 @@
+#include "lightClusters.h"
+#include "uniformBlocks.h"
+#include "jobSystem.h"
+#include "simdaccel.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+//Four RGBA texels per light
+static const unsigned int LIGHT_DATA_SIZE = 16;
+
+LightClusters::LightClusters() :
+	m_tanHalfFovX(1.0f),
+	m_tanHalfFovY(1.0f),
+	m_near(1.0f),
+	m_far(2.0f),
+	m_depthSliceScale(0.0f),
+	m_depthSliceBias(0.0f),
+	m_clusters(NUM_CLUSTERS * 2, 0)
+{
+	glGenBuffers(NUM_BUFFERS, m_buffers);
+
+	//A buffer texture can't refer to an empty buffer, so each one starts with something in it.
+	float emptyLightData[LIGHT_DATA_SIZE] = { 0 };
+	unsigned short emptyLightIndex = 0;
+	Upload(m_buffers[BUFFER_LIGHT_DATA], emptyLightData, sizeof(emptyLightData));
+	Upload(m_buffers[BUFFER_CLUSTERS], &m_clusters[0], m_clusters.size() * sizeof(unsigned int));
+	Upload(m_buffers[BUFFER_LIGHT_INDICES], &emptyLightIndex, sizeof(emptyLightIndex));
+
+	m_lightDataTexture = Texture(GL_TEXTURE_BUFFER, m_buffers[BUFFER_LIGHT_DATA], GL_RGBA32F);
+	m_clusterTexture = Texture(GL_TEXTURE_BUFFER, m_buffers[BUFFER_CLUSTERS], GL_RG32UI);
+	m_lightIndexTexture = Texture(GL_TEXTURE_BUFFER, m_buffers[BUFFER_LIGHT_INDICES], GL_R16UI);
+}
+
+LightClusters::~LightClusters()
+{
+	glDeleteBuffers(NUM_BUFFERS, m_buffers);
+}
+
+bool LightClusters::Begin(const Matrix4f& view, const Matrix4f& projection)
+{
+	//Only a perspective projection copies depth into w.
+	if(projection[2][3] == 0.0f)
+	{
+		return false;
+	}
+
+	//See Matrix4f::InitPerspective.
+	m_view = view;
+	m_tanHalfFovX = 1.0f / projection[0][0];
+	m_tanHalfFovY = 1.0f / projection[1][1];
+	m_near = -projection[3][2] / (projection[2][2] + 1.0f);
+	m_far = -projection[3][2] / (projection[2][2] - 1.0f);
+
+	m_depthSliceScale = (float)GRID_Z / logf(m_far / m_near);
+	m_depthSliceBias = -logf(m_near) * m_depthSliceScale;
+
+	m_lights.clear();
+	m_lightData.clear();
+	return true;
+}
+
+void LightClusters::AddLight(const Vector3f& center, float radius, const LightBlockData& lightData)
+{
+	if(m_lights.size() >= MAX_LIGHTS)
+	{
+		return;
+	}
+
+	Vector3f viewCenter(m_view.Transform(center));
+	float nearZ = viewCenter.GetZ() - radius;
+	float farZ = viewCenter.GetZ() + radius;
+
+	if(farZ < m_near || nearZ > m_far)
+	{
+		return;
+	}
+
+	ClusterLight light;
+	light.x = viewCenter.GetX();
+	light.y = viewCenter.GetY();
+	light.z = viewCenter.GetZ();
+	light.radius = radius;
+	light.minZ = (unsigned int)Clamp(floorf(logf(std::max(nearZ, m_near)) * m_depthSliceScale + m_depthSliceBias), 0.0f, (float)(GRID_Z - 1));
+	light.maxZ = (unsigned int)Clamp(floorf(logf(std::min(farZ, m_far)) * m_depthSliceScale + m_depthSliceBias), 0.0f, (float)(GRID_Z - 1));
+
+	if(nearZ <= m_near)
+	{
+		//Part of the box around the light is behind the near plane, where it can't be projected.
+		light.minX = 0;
+		light.maxX = GRID_X - 1;
+		light.minY = 0;
+		light.maxY = GRID_Y - 1;
+	}
+	else
+	{
+		//The box around the light is in front of the camera, so it's furthest out on screen at
+		//one of it's near or far corners.
+		float minX = std::min((light.x - radius) / nearZ, (light.x - radius) / farZ) / m_tanHalfFovX;
+		float maxX = std::max((light.x + radius) / nearZ, (light.x + radius) / farZ) / m_tanHalfFovX;
+		float minY = std::min((light.y - radius) / nearZ, (light.y - radius) / farZ) / m_tanHalfFovY;
+		float maxY = std::max((light.y + radius) / nearZ, (light.y + radius) / farZ) / m_tanHalfFovY;
+
+		if(minX > 1.0f || maxX < -1.0f || minY > 1.0f || maxY < -1.0f)
+		{
+			return;
+		}
+
+		light.minX = CalcTile(minX, GRID_X);
+		light.maxX = CalcTile(maxX, GRID_X);
+		light.minY = CalcTile(minY, GRID_Y);
+		light.maxY = CalcTile(maxY, GRID_Y);
+	}
+
+	m_lights.push_back(light);
+
+	const float data[LIGHT_DATA_SIZE] =
+	{
+		lightData.position[0], lightData.position[1], lightData.position[2], lightData.range,
+		lightData.color[0], lightData.color[1], lightData.color[2], lightData.intensity,
+		lightData.attenuation[0], lightData.attenuation[1], lightData.attenuation[2], lightData.cutoff,
+		lightData.direction[0], lightData.direction[1], lightData.direction[2], 0.0f
+	};
+	m_lightData.insert(m_lightData.end(), data, data + LIGHT_DATA_SIZE);
+}
+
+void LightClusters::Assign(JobSystem* jobSystem)
+{
+	//Each slice only writes to it's own clusters and index list, so they can all be filled in at
+	//once. The index lists are joined afterwards.
+	if(jobSystem != 0)
+	{
+		jobSystem->ParallelFor(0, GRID_Z, 1, [this](unsigned int rangeBegin, unsigned int rangeEnd)
+		{
+			for(unsigned int i = rangeBegin; i < rangeEnd; i++)
+			{
+				AssignSlice(i);
+			}
+		});
+	}
+	else
+	{
+		for(unsigned int i = 0; i < GRID_Z; i++)
+		{
+			AssignSlice(i);
+		}
+	}
+
+	m_lightIndices.clear();
+	for(unsigned int i = 0; i < GRID_Z; i++)
+	{
+		unsigned int sliceOffset = (unsigned int)m_lightIndices.size();
+		unsigned int* clusters = &m_clusters[i * GRID_X * GRID_Y * 2];
+		for(unsigned int j = 0; j < GRID_X * GRID_Y; j++)
+		{
+			clusters[j * 2] += sliceOffset;
+		}
+
+		m_lightIndices.insert(m_lightIndices.end(), m_sliceLightIndices[i].begin(), m_sliceLightIndices[i].end());
+	}
+
+	if(!m_lightData.empty())
+	{
+		Upload(m_buffers[BUFFER_LIGHT_DATA], &m_lightData[0], m_lightData.size() * sizeof(float));
+	}
+	Upload(m_buffers[BUFFER_CLUSTERS], &m_clusters[0], m_clusters.size() * sizeof(unsigned int));
+	if(!m_lightIndices.empty())
+	{
+		Upload(m_buffers[BUFFER_LIGHT_INDICES], &m_lightIndices[0], m_lightIndices.size() * sizeof(unsigned short));
+	}
+}
+
+float LightClusters::CalcSliceDepth(unsigned int slice) const
+{
+	return m_near * powf(m_far / m_near, (float)slice / (float)GRID_Z);
+}
+
+unsigned int LightClusters::CalcTile(float ndc, unsigned int gridSize) const
+{
+	return (unsigned int)Clamp(floorf((ndc * 0.5f + 0.5f) * (float)gridSize), 0.0f, (float)(gridSize - 1));
+}
+
+void LightClusters::AssignSlice(unsigned int slice)
+{
+	std::vector<unsigned short>& indices = m_sliceLightIndices[slice];
+	unsigned int* clusters = &m_clusters[slice * GRID_X * GRID_Y * 2];
+	indices.clear();
+
+	float sliceNear = CalcSliceDepth(slice);
+	float sliceFar = CalcSliceDepth(slice + 1);
+
+	//The view space box around each cluster in the slice. Since the tiles are parts of the view
+	//frustum, the box's extent on x only depends on the column, and on y only on the row.
+	float tileMinX[GRID_X];
+	float tileMaxX[GRID_X];
+	float tileMinY[GRID_Y];
+	float tileMaxY[GRID_Y];
+
+	for(unsigned int i = 0; i < GRID_X; i++)
+	{
+		float left = (-1.0f + 2.0f * (float)i / (float)GRID_X) * m_tanHalfFovX;
+		float right = (-1.0f + 2.0f * (float)(i + 1) / (float)GRID_X) * m_tanHalfFovX;
+		tileMinX[i] = std::min(left * sliceNear, left * sliceFar);
+		tileMaxX[i] = std::max(right * sliceNear, right * sliceFar);
+	}
+
+	for(unsigned int i = 0; i < GRID_Y; i++)
+	{
+		float bottom = (-1.0f + 2.0f * (float)i / (float)GRID_Y) * m_tanHalfFovY;
+		float top = (-1.0f + 2.0f * (float)(i + 1) / (float)GRID_Y) * m_tanHalfFovY;
+		tileMinY[i] = std::min(bottom * sliceNear, bottom * sliceFar);
+		tileMaxY[i] = std::max(top * sliceNear, top * sliceFar);
+	}
+
+	//Bit i of a light's mask is set if it reaches the cluster in column i of the current row.
+	std::vector<unsigned int> sliceLights;
+	std::vector<unsigned int> rowMasks;
+	for(unsigned int i = 0; i < m_lights.size(); i++)
+	{
+		if(m_lights[i].minZ <= slice && slice <= m_lights[i].maxZ)
+		{
+			sliceLights.push_back(i);
+		}
+	}
+	rowMasks.resize(sliceLights.size());
+
+	const SIMD4f zero(0.0f);
+	for(unsigned int row = 0; row < GRID_Y; row++)
+	{
+		for(unsigned int i = 0; i < sliceLights.size(); i++)
+		{
+			const ClusterLight& light = m_lights[sliceLights[i]];
+			rowMasks[i] = 0;
+
+			if(row < light.minY || row > light.maxY)
+			{
+				continue;
+			}
+
+			//Closest distance from the light's center to each box. Only x changes along the row, so
+			//that's tested four columns at a time, starting with the group holding the first one
+			//the light's bounding box covers.
+			float distanceY = std::max(std::max(tileMinY[row] - light.y, light.y - tileMaxY[row]), 0.0f);
+			float distanceZ = std::max(std::max(sliceNear - light.z, light.z - sliceFar), 0.0f);
+			SIMD4f rowDistanceSq(distanceY * distanceY + distanceZ * distanceZ);
+			SIMD4f radiusSq(light.radius * light.radius);
+			SIMD4f lightX(light.x);
+
+			for(unsigned int column = light.minX & ~3u; column <= light.maxX; column += 4)
+			{
+				SIMD4f minX, maxX;
+				minX.Set(tileMinX + column);
+				maxX.Set(tileMaxX + column);
+
+				SIMD4f distanceX = (minX - lightX).Max(lightX - maxX).Max(zero);
+				SIMD4f outside = radiusSq < distanceX * distanceX + rowDistanceSq;
+				rowMasks[i] |= (unsigned int)((~outside.GetSignMask()) & 0xF) << column;
+			}
+		}
+
+		for(unsigned int column = 0; column < GRID_X; column++)
+		{
+			unsigned int* cluster = &clusters[(row * GRID_X + column) * 2];
+			cluster[0] = (unsigned int)indices.size();
+
+			for(unsigned int i = 0; i < sliceLights.size(); i++)
+			{
+				if(rowMasks[i] & (1u << column))
+				{
+					indices.push_back((unsigned short)sliceLights[i]);
+				}
+			}
+
+			cluster[1] = (unsigned int)indices.size() - cluster[0];
+		}
+	}
+}
+
+void LightClusters::Upload(GLuint buffer, const void* data, size_t dataSize)
+{
+	//Orphaned every time, so the driver doesn't have to wait for the last frame to finish with
+	//the old contents.
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, dataSize, data, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
@@ -0,0 +1,101 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include "math3d.h"
+#include "texture.h"
+#include <GL/glew.h>
+#include <vector>
+class JobSystem;
+struct LightBlockData;
+
+//Splits the camera's view into a grid of clusters, GRID_X by GRID_Y tiles on screen, and
+//GRID_Z slices in depth, which get exponentially thicker further away. Each frame, every light
+//is assigned to the clusters it's range reaches, so a single forward pass can light each pixel
+//with only the lights that can affect it.
+//
+//The results are read by res/shaders/clusters.glh from three buffer textures:
+// - Light data: four RGBA32F texels per light.
+// - Clusters: an RG32UI offset into the light index list, and a count, per cluster.
+// - Light indices: R16UI indices into the light data.
+class LightClusters
+{
+public:
+	//These have to match the ones in clusters.glh. GRID_X is a multiple of 4, since tiles are
+	//tested four at a time.
+	static const unsigned int GRID_X = 16;
+	static const unsigned int GRID_Y = 9;
+	static const unsigned int GRID_Z = 24;
+	static const unsigned int NUM_CLUSTERS = GRID_X * GRID_Y * GRID_Z;
+	static const unsigned int MAX_LIGHTS = 65536;
+
+	LightClusters();
+	virtual ~LightClusters();
+
+	//Starts a new frame, seen by a camera with view matrix view and a perspective projection.
+	//Returns false if the projection isn't a perspective, in which case clusters can't be used.
+	bool Begin(const Matrix4f& view, const Matrix4f& projection);
+	//Adds a light with a world space bounding sphere, and the data a light block would have
+	//for it. Lights that are completely outside the view are ignored.
+	void AddLight(const Vector3f& center, float radius, const LightBlockData& lightData);
+	//Assigns all the lights to clusters, one depth slice per job, and uploads the results.
+	void Assign(JobSystem* jobSystem);
+
+	//The scale and bias that turn the natural log of a view space depth into a slice.
+	inline float GetDepthSliceScale()            const { return m_depthSliceScale; }
+	inline float GetDepthSliceBias()             const { return m_depthSliceBias; }
+	inline unsigned int GetNumLights()           const { return (unsigned int)m_lights.size(); }
+	inline unsigned int GetNumLightIndices()     const { return (unsigned int)m_lightIndices.size(); }
+	inline const Texture& GetLightDataTexture()  const { return m_lightDataTexture; }
+	inline const Texture& GetClusterTexture()    const { return m_clusterTexture; }
+	inline const Texture& GetLightIndexTexture() const { return m_lightIndexTexture; }
+protected:
+private:
+	//A light in view space, and the range of clusters it's bounding box covers, which is
+	//narrowed down to the clusters it's sphere actually touches during assignment.
+	struct ClusterLight
+	{
+		float x, y, z;
+		float radius;
+		unsigned int minX, maxX;
+		unsigned int minY, maxY;
+		unsigned int minZ, maxZ;
+	};
+
+	enum
+	{
+		BUFFER_LIGHT_DATA,
+		BUFFER_CLUSTERS,
+		BUFFER_LIGHT_INDICES,
+
+		NUM_BUFFERS
+	};
+
+	Matrix4f                    m_view;
+	float                       m_tanHalfFovX;
+	float                       m_tanHalfFovY;
+	float                       m_near;
+	float                       m_far;
+	float                       m_depthSliceScale;
+	float                       m_depthSliceBias;
+
+	std::vector<ClusterLight>   m_lights;
+	std::vector<float>          m_lightData;
+	std::vector<unsigned int>   m_clusters;           //Offset and count, per cluster
+	std::vector<unsigned short> m_sliceLightIndices[GRID_Z];
+	std::vector<unsigned short> m_lightIndices;
+
+	GLuint                      m_buffers[NUM_BUFFERS];
+	Texture                     m_lightDataTexture;
+	Texture                     m_clusterTexture;
+	Texture                     m_lightIndexTexture;
+
+	float CalcSliceDepth(unsigned int slice) const;
+	unsigned int CalcTile(float ndc, unsigned int gridSize) const;
+	void AssignSlice(unsigned int slice);
+	void Upload(GLuint buffer, const void* data, size_t dataSize);
+
+	LightClusters(const LightClusters& other) {}
+	void operator=(const LightClusters& other) {}
+};
+
+#endif // LIGHTCLUSTERS_H
@@ -1,21 +1,42 @@
 #include "lighting.h"
+#include "camera.h"
 #include "renderingEngine.h"
 #include "coreEngine.h"
+#include "sceneFile.h"
+
+#include <algorithm>
+#include <cmath>
 
 #define COLOR_DEPTH 256
 
+//How much cascade splits follow a logarithmic distribution, rather than a uniform one. Purely
+//logarithmic splits make the first cascades tiny when the camera's near plane is close.
+#define CASCADE_SPLIT_LOG_WEIGHT 0.8f
+
 void BaseLight::AddToEngine(CoreEngine* engine) const
 {
 	engine->GetRenderingEngine()->AddLight(*this);
 }
 
-ShadowCameraTransform BaseLight::CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot) const
+void BaseLight::RemoveFromEngine(CoreEngine* engine) const
+{
+	engine->GetRenderingEngine()->RemoveLight(*this);
+}
+
+ShadowCameraTransform BaseLight::CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot, int shadowMapSize) const
 {
 	return ShadowCameraTransform(GetTransform().GetTransformedPos(), GetTransform().GetTransformedRot());
 }
 
+ShadowCameraTransform BaseLight::CalcShadowCascade(const Camera& mainCamera, int cascade, int shadowMapSize, Matrix4f& projection, float& splitDistance) const
+{
+	projection = GetShadowInfo().GetProjection();
+	splitDistance = 0.0f;
+	return CalcShadowCameraTransform(mainCamera.GetTransform().GetTransformedPos(), mainCamera.GetTransform().GetTransformedRot(), shadowMapSize);
+}
+
 DirectionalLight::DirectionalLight(const Vector3f& color, float intensity, int shadowMapSizeAsPowerOf2, 
-	                 float shadowArea, float shadowSoftness, float lightBleedReductionAmount, float minVariance) :
+	                 float shadowArea, float shadowSoftness, float lightBleedReductionAmount, float minVariance, int numCascades) :
 	BaseLight(color, intensity, Shader("forward-directional")),
 	m_halfShadowArea(shadowArea / 2.0f)
 {
@@ -23,17 +44,18 @@ DirectionalLight::DirectionalLight(const Vector3f& color, float intensity, int s
 	{
 		SetShadowInfo(ShadowInfo(Matrix4f().InitOrthographic(-m_halfShadowArea, m_halfShadowArea, -m_halfShadowArea, 
 		                                                      m_halfShadowArea, -m_halfShadowArea, m_halfShadowArea), 
-								 true, shadowMapSizeAsPowerOf2, shadowSoftness, lightBleedReductionAmount, minVariance));
+								 true, shadowMapSizeAsPowerOf2, shadowSoftness, lightBleedReductionAmount, minVariance,
+								 Clamp(numCascades, 1, (int)MAX_SHADOW_CASCADES)));
 	}
 }
 
 
-ShadowCameraTransform DirectionalLight::CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot) const
+ShadowCameraTransform DirectionalLight::CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot, int shadowMapSize) const
 {
 	Vector3f resultPos = mainCameraPos + mainCameraRot.GetForward() * GetHalfShadowArea();
 	Quaternion resultRot = GetTransform().GetTransformedRot();
 	
-	float worldTexelSize = (GetHalfShadowArea()*2)/((float)(1 << GetShadowInfo().GetShadowMapSizeAsPowerOf2()));
+	float worldTexelSize = (GetHalfShadowArea()*2)/((float)shadowMapSize);
 	
 	Vector3f lightSpaceCameraPos = resultPos.Rotate(resultRot.Conjugate());
 	
@@ -45,6 +67,64 @@ ShadowCameraTransform DirectionalLight::CalcShadowCameraTransform(const Vector3f
 	return ShadowCameraTransform(resultPos, resultRot);
 }
 
+ShadowCameraTransform DirectionalLight::CalcShadowCascade(const Camera& mainCamera, int cascade, int shadowMapSize, Matrix4f& projection, float& splitDistance) const
+{
+	int numCascades = GetShadowInfo().GetNumCascades();
+	
+	//See Matrix4f::InitPerspective.
+	const Matrix4f& cameraProjection = mainCamera.GetProjection();
+	float tanHalfFovX = 1.0f / cameraProjection[0][0];
+	float tanHalfFovY = 1.0f / cameraProjection[1][1];
+	float cameraNear = -cameraProjection[3][2] / (cameraProjection[2][2] + 1.0f);
+	float shadowDistance = GetHalfShadowArea() * 2.0f;
+	
+	float splits[2];
+	for(int i = 0; i < 2; i++)
+	{
+		float t = (float)(cascade + i) / (float)numCascades;
+		float logSplit = cameraNear * powf(shadowDistance / cameraNear, t);
+		float uniformSplit = cameraNear + (shadowDistance - cameraNear) * t;
+		splits[i] = CASCADE_SPLIT_LOG_WEIGHT * logSplit + (1.0f - CASCADE_SPLIT_LOG_WEIGHT) * uniformSplit;
+	}
+	
+	//The smallest sphere around the part of the view between the splits, which is centered on the
+	//view's axis. Spheres don't change size as the camera turns, so the shadow doesn't shimmer.
+	float cornerScaleSq = tanHalfFovX * tanHalfFovX + tanHalfFovY * tanHalfFovY;
+	float centerDistance = std::min((splits[0] + splits[1]) * 0.5f * (1.0f + cornerScaleSq), splits[1]);
+	float radius = sqrtf((splits[1] - centerDistance) * (splits[1] - centerDistance) + splits[1] * splits[1] * cornerScaleSq);
+	
+	Vector3f resultPos = mainCamera.GetTransform().GetTransformedPos() + mainCamera.GetTransform().GetTransformedRot().GetForward() * centerDistance;
+	Quaternion resultRot = GetTransform().GetTransformedRot();
+	
+	//The cascade only moves in whole texels of it's part of the shadow map.
+	float worldTexelSize = (radius * 2.0f)/((float)shadowMapSize);
+	
+	Vector3f lightSpaceCameraPos = resultPos.Rotate(resultRot.Conjugate());
+	
+	lightSpaceCameraPos.SetX(worldTexelSize * floor(lightSpaceCameraPos.GetX() / worldTexelSize));
+	lightSpaceCameraPos.SetY(worldTexelSize * floor(lightSpaceCameraPos.GetY() / worldTexelSize));
+	
+	resultPos = lightSpaceCameraPos.Rotate(resultRot);
+	
+	projection = Matrix4f().InitOrthographic(-radius, radius, -radius, radius, -radius, radius);
+	splitDistance = splits[1];
+	return ShadowCameraTransform(resultPos, resultRot);
+}
+
+void DirectionalLight::WriteToScene(SceneComponentWriter& writer) const
+{
+	const ShadowInfo& shadowInfo = GetShadowInfo();
+	
+	writer.WriteVector3f(GetColor());
+	writer.WriteFloat(GetIntensity());
+	writer.WriteInt(shadowInfo.GetShadowMapSizeAsPowerOf2());
+	writer.WriteFloat(GetHalfShadowArea() * 2.0f);
+	writer.WriteFloat(shadowInfo.GetShadowSoftness());
+	writer.WriteFloat(shadowInfo.GetLightBleedReductionAmount());
+	writer.WriteFloat(shadowInfo.GetMinVariance());
+	writer.WriteInt(shadowInfo.GetNumCascades());
+}
+
 PointLight::PointLight(const Vector3f& color, float intensity, const Attenuation& attenuation, const Shader& shader) :
 	BaseLight(color, intensity, shader),
 	m_attenuation(attenuation)
@@ -67,3 +147,110 @@ SpotLight::SpotLight(const Vector3f& color, float intensity, const Attenuation&
 		                             shadowSoftness, lightBleedReductionAmount, minVariance));
 	}
 }
+
+void BaseLight::WriteUniformBlock(LightBlockData& block) const
+{
+	Vector3f direction = GetTransform().GetTransformedRot().GetForward();
+	Vector3f position = GetTransform().GetTransformedPos();
+	
+	for(unsigned int i = 0; i < 3; i++)
+	{
+		block.color[i] = m_color[i];
+		block.direction[i] = direction[i];
+		block.position[i] = position[i];
+		block.attenuation[i] = 0.0f;
+	}
+	
+	block.intensity = m_intensity;
+	block.range = 0.0f;
+	block.cutoff = -1.0f; //No cone
+}
+
+void PointLight::WriteUniformBlock(LightBlockData& block) const
+{
+	BaseLight::WriteUniformBlock(block);
+	
+	block.attenuation[0] = m_attenuation.GetConstant();
+	block.attenuation[1] = m_attenuation.GetLinear();
+	block.attenuation[2] = m_attenuation.GetExponent();
+	block.range = m_range;
+}
+
+void SpotLight::WriteUniformBlock(LightBlockData& block) const
+{
+	PointLight::WriteUniformBlock(block);
+	
+	block.cutoff = m_cutoff;
+}
+
+bool PointLight::AffectsSphere(const Vector3f& center, float radius) const
+{
+	float maxDistance = m_range + radius;
+	return (center - GetTransform().GetTransformedPos()).LengthSq() <= maxDistance * maxDistance;
+}
+
+bool PointLight::CalcBoundingSphere(Vector3f& center, float& radius) const
+{
+	center = GetTransform().GetTransformedPos();
+	radius = m_range;
+	return true;
+}
+
+bool SpotLight::AffectsSphere(const Vector3f& center, float radius) const
+{
+	if(!PointLight::AffectsSphere(center, radius))
+	{
+		return false;
+	}
+	
+	//Cones wider than a half space are close enough to the sphere around them.
+	if(m_cutoff <= 0.0f)
+	{
+		return true;
+	}
+	
+	//The sphere is outside if it's further from the cone's surface than it's radius, measured
+	//perpendicular to the surface.
+	Vector3f toCenter = center - GetTransform().GetTransformedPos();
+	Vector3f direction = GetTransform().GetTransformedRot().GetForward();
+	
+	float distanceAlongAxis = toCenter.Dot(direction);
+	float distanceFromAxis = sqrtf(std::max(0.0f, toCenter.LengthSq() - distanceAlongAxis * distanceAlongAxis));
+	float sinHalfAngle = sqrtf(1.0f - m_cutoff * m_cutoff);
+	
+	float distanceFromSurface = distanceFromAxis * m_cutoff - distanceAlongAxis * sinHalfAngle;
+	return distanceFromSurface <= radius && distanceAlongAxis >= -radius;
+}
+
+bool SpotLight::CalcBoundingCone(float& length, float& width) const
+{
+	if(m_cutoff <= 0.0f)
+	{
+		return false;
+	}
+	
+	//A cone as long as the sphere's radius has the smaller volume until it's base's radius is
+	//twice it's length.
+	length = GetRange();
+	width = sqrtf(1.0f - m_cutoff * m_cutoff) / m_cutoff;
+	return width < 2.0f;
+}
+
+void PointLight::WriteToScene(SceneComponentWriter& writer) const
+{
+	writer.WriteVector3f(GetColor());
+	writer.WriteFloat(GetIntensity());
+	writer.WriteVector3f(Vector3f(m_attenuation.GetConstant(), m_attenuation.GetLinear(), m_attenuation.GetExponent()));
+}
+
+void SpotLight::WriteToScene(SceneComponentWriter& writer) const
+{
+	const ShadowInfo& shadowInfo = GetShadowInfo();
+	
+	PointLight::WriteToScene(writer);
+	writer.WriteFloat(2.0f * acosf(m_cutoff));
+	writer.WriteInt(shadowInfo.GetShadowMapSizeAsPowerOf2());
+	writer.WriteFloat(shadowInfo.GetShadowSoftness());
+	writer.WriteFloat(shadowInfo.GetLightBleedReductionAmount());
+	writer.WriteFloat(shadowInfo.GetMinVariance());
+}
@@ -4,8 +4,11 @@
 #include "math3d.h"
 #include "entityComponent.h"
 #include "shader.h"
+#include "uniformBlocks.h"
 
+class Camera;
 class CoreEngine;
+class SceneComponentWriter;
 
 class ShadowCameraTransform
 {
@@ -24,13 +27,14 @@ private:
 class ShadowInfo
 {
 public:
-	ShadowInfo(const Matrix4f& projection = Matrix4f().InitIdentity(), bool flipFaces = false, int shadowMapSizeAsPowerOf2 = 0, float shadowSoftness = 1.0f, float lightBleedReductionAmount = 0.2f, float minVariance = 0.00002f) :
+	ShadowInfo(const Matrix4f& projection = Matrix4f().InitIdentity(), bool flipFaces = false, int shadowMapSizeAsPowerOf2 = 0, float shadowSoftness = 1.0f, float lightBleedReductionAmount = 0.2f, float minVariance = 0.00002f, int numCascades = 1) :
 		m_projection(projection),
 		m_flipFaces(flipFaces),
 		m_shadowMapSizeAsPowerOf2(shadowMapSizeAsPowerOf2),
 		m_shadowSoftness(shadowSoftness),
 		m_lightBleedReductionAmount(lightBleedReductionAmount),
-		m_minVariance(minVariance) {}
+		m_minVariance(minVariance),
+		m_numCascades(numCascades) {}
 		
 	inline const Matrix4f& GetProjection()      const { return m_projection; }
 	inline bool GetFlipFaces()                  const { return m_flipFaces; }
@@ -38,6 +42,7 @@ public:
 	inline float GetShadowSoftness()            const { return m_shadowSoftness; }
 	inline float GetMinVariance()               const { return m_minVariance; }
 	inline float GetLightBleedReductionAmount() const { return m_lightBleedReductionAmount; }
+	inline int GetNumCascades()                 const { return m_numCascades; }
 protected:
 private:
 	Matrix4f m_projection;
@@ -46,6 +51,7 @@ private:
 	float m_shadowSoftness;
 	float m_lightBleedReductionAmount;
 	float m_minVariance;
+	int m_numCascades; //With more than one, each gets a quarter of the shadow map
 };
 
 class BaseLight : public EntityComponent
@@ -57,8 +63,30 @@ public:
 		m_shader(shader),
 		m_shadowInfo(ShadowInfo()) {}
 	
-	virtual ShadowCameraTransform CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot) const;
+	//shadowMapSize is the width in texels of the part of the shadow atlas the shadow map was given,
+	//which can be less than the light asked for.
+	virtual ShadowCameraTransform CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot, int shadowMapSize) const;
+	//For lights with more than one shadow cascade. Finds the shadow camera for cascade, and the
+	//distance from mainCamera up to which it's used. shadowMapSize is the cascade's width in texels.
+	virtual ShadowCameraTransform CalcShadowCascade(const Camera& mainCamera, int cascade, int shadowMapSize, Matrix4f& projection, float& splitDistance) const;
 	virtual void AddToEngine(CoreEngine* engine) const;	
+	virtual void RemoveFromEngine(CoreEngine* engine) const;
+	
+	//Whether the light can reach anything inside the sphere, so objects it can't reach can be
+	//left out of it's pass. Lights that reach everywhere, like directional lights, always can.
+	virtual bool AffectsSphere(const Vector3f& center, float radius) const { return true; }
+	
+	//Finds a sphere around everything the light can reach. Returns false if it's reach is unbounded.
+	virtual bool CalcBoundingSphere(Vector3f& center, float& radius) const { return false; }
+	
+	//Finds a cone around everything the light can reach, with it's apex at the light, along it's
+	//forward direction. width is the cone's radius at a length of 1. Returns false if the light's
+	//bounding sphere is smaller.
+	virtual bool CalcBoundingCone(float& length, float& width) const { return false; }
+	
+	//Fills in the members of the light block that describe this light. The rendering engine
+	//fills in the shadow related ones.
+	virtual void WriteUniformBlock(LightBlockData& block) const;
 	
 	inline const Vector3f& GetColor()        const { return m_color; }
 	inline const float GetIntensity()        const { return m_intensity; }
@@ -76,10 +104,18 @@ private:
 class DirectionalLight : public BaseLight
 {
 public:
+	//With more than one cascade, shadowArea is how far from the camera shadows reach, and the
+	//view up to there is split between the cascades, so the ones closer to the camera cover
+	//less and have more detail.
 	DirectionalLight(const Vector3f& color = Vector3f(0,0,0), float intensity = 0, int shadowMapSizeAsPowerOf2 = 0, 
-	                 float shadowArea = 80.0f, float shadowSoftness = 1.0f, float lightBleedReductionAmount = 0.2f, float minVariance = 0.00002f);
+	                 float shadowArea = 80.0f, float shadowSoftness = 1.0f, float lightBleedReductionAmount = 0.2f, float minVariance = 0.00002f,
+	                 int numCascades = 1);
 	                 
-	virtual ShadowCameraTransform CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot) const;
+	virtual ShadowCameraTransform CalcShadowCameraTransform(const Vector3f& mainCameraPos, const Quaternion& mainCameraRot, int shadowMapSize) const;
+	virtual ShadowCameraTransform CalcShadowCascade(const Camera& mainCamera, int cascade, int shadowMapSize, Matrix4f& projection, float& splitDistance) const;
+	
+	virtual const char* GetSceneTypeName() const { return "DirectionalLight"; }
+	virtual void WriteToScene(SceneComponentWriter& writer) const;
 	
 	inline float GetHalfShadowArea() const { return m_halfShadowArea; }
 private:
@@ -109,6 +145,13 @@ public:
 	PointLight(const Vector3f& color = Vector3f(0,0,0), float intensity = 0, const Attenuation& atten = Attenuation(), 
 	           const Shader& shader = Shader("forward-point"));
 	           
+	virtual bool AffectsSphere(const Vector3f& center, float radius) const;
+	virtual bool CalcBoundingSphere(Vector3f& center, float& radius) const;
+	virtual void WriteUniformBlock(LightBlockData& block) const;
+	
+	virtual const char* GetSceneTypeName() const { return "PointLight"; }
+	virtual void WriteToScene(SceneComponentWriter& writer) const;
+	
 	inline const Attenuation& GetAttenuation() const { return m_attenuation; }
 	inline const float GetRange()              const { return m_range; }
 private:
@@ -122,6 +165,13 @@ public:
 	SpotLight(const Vector3f& color = Vector3f(0,0,0), float intensity = 0, const Attenuation& atten = Attenuation(), float viewAngle = ToRadians(170.0f),
 			  int shadowMapSizeAsPowerOf2 = 0, float shadowSoftness = 1.0f, float lightBleedReductionAmount = 0.2f, float minVariance = 0.00002f);
 			  
+	virtual bool AffectsSphere(const Vector3f& center, float radius) const;
+	virtual bool CalcBoundingCone(float& length, float& width) const;
+	virtual void WriteUniformBlock(LightBlockData& block) const;
+	
+	virtual const char* GetSceneTypeName() const { return "SpotLight"; }
+	virtual void WriteToScene(SceneComponentWriter& writer) const;
+	
 	inline float GetCutoff() const { return m_cutoff; }
 private:
 	float m_cutoff;
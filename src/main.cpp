@@ -32,40 +32,49 @@ void TestGame::Init(const Window& window)
 	}
 	Mesh customMesh("square", square.Finalize());
 	
-	AddToScene((new Entity(Vector3f(0, -1, 5), Quaternion(), 32.0f))
-		->AddComponent(new MeshRenderer(Mesh("terrain02.obj"), Material("bricks"))));
+	AddToScene(Vector3f(0, -1, 5), Quaternion(), 32.0f)
+		->CreateComponent<MeshRenderer>(Mesh("terrain02.obj"), Material("bricks"));
 		
-	AddToScene((new Entity(Vector3f(7,0,7)))
-		->AddComponent(new PointLight(Vector3f(0,1,0), 0.4f, Attenuation(0,0,1))));
+	AddToScene(Vector3f(7,0,7))
+		->CreateComponent<PointLight>(Vector3f(0,1,0), 0.4f, Attenuation(0,0,1));
 	
-	AddToScene((new Entity(Vector3f(20,-11.0f,5), Quaternion(Vector3f(1,0,0), ToRadians(-60.0f)) * Quaternion(Vector3f(0,1,0), ToRadians(90.0f))))
-		->AddComponent(new SpotLight(Vector3f(0,1,1), 0.4f, Attenuation(0,0,0.02f), ToRadians(91.1f), 7, 1.0f, 0.5f)));
+	AddToScene(Vector3f(20,-11.0f,5), Quaternion(Vector3f(1,0,0), ToRadians(-60.0f)) * Quaternion(Vector3f(0,1,0), ToRadians(90.0f)))
+		->CreateComponent<SpotLight>(Vector3f(0,1,1), 0.4f, Attenuation(0,0,0.02f), ToRadians(91.1f), 7, 1.0f, 0.5f);
 	
-	AddToScene((new Entity(Vector3f(), Quaternion(Vector3f(1,0,0), ToRadians(-45))))
-		->AddComponent(new DirectionalLight(Vector3f(1,1,1), 0.4f, 10, 80.0f, 1.0f)));
+	AddToScene(Vector3f(), Quaternion(Vector3f(1,0,0), ToRadians(-45)))
+		->CreateComponent<DirectionalLight>(Vector3f(1,1,1), 0.4f, 10, 80.0f, 1.0f, 0.2f, 0.00002f, 4);
 	
-	AddToScene((new Entity(Vector3f(0, 2, 0), Quaternion(Vector3f(0,1,0), 0.4f), 1.0f))
-		->AddComponent(new MeshRenderer(Mesh("plane3.obj"), Material("bricks2")))
-		->AddChild((new Entity(Vector3f(0, 0, 25)))
-			->AddComponent(new MeshRenderer(Mesh("plane3.obj"), Material("bricks2")))
-			->AddChild((new Entity())
-				->AddComponent(new CameraComponent(Matrix4f().InitPerspective(ToRadians(70.0f), window.GetAspect(), 0.1f, 1000.0f)))
-				->AddComponent(new FreeLook(window.GetCenter()))
-				->AddComponent(new FreeMove(10.0f)))));
+	Entity* plane = AddToScene(Vector3f(0, 2, 0), Quaternion(Vector3f(0,1,0), 0.4f), 1.0f);
+	plane->CreateComponent<MeshRenderer>(Mesh("plane3.obj"), Material("bricks2"));
 	
-	AddToScene((new Entity(Vector3f(24,-12,5), Quaternion(Vector3f(0,1,0), ToRadians(30.0f))))
-		->AddComponent(new MeshRenderer(Mesh("cube.obj"), Material("bricks2"))));
+	Entity* childPlane = plane->CreateChild(Vector3f(0, 0, 25));
+	childPlane->CreateComponent<MeshRenderer>(Mesh("plane3.obj"), Material("bricks2"));
+	
+	Entity* player = childPlane->CreateChild();
+	player->CreateComponent<CameraComponent>(Matrix4f().InitPerspective(ToRadians(70.0f), window.GetAspect(), 0.1f, 1000.0f));
+	player->CreateComponent<FreeLook>(window.GetCenter());
+	player->CreateComponent<FreeMove>(10.0f);
+	
+	AddToScene(Vector3f(24,-12,5), Quaternion(Vector3f(0,1,0), ToRadians(30.0f)))
+		->CreateComponent<MeshRenderer>(Mesh("cube.obj"), Material("bricks2"));
 		
-	AddToScene((new Entity(Vector3f(0,0,7), Quaternion(), 1.0f))
-		->AddComponent(new MeshRenderer(Mesh("square"), Material("bricks2"))));
+	AddToScene(Vector3f(0,0,7), Quaternion(), 1.0f)
+		->CreateComponent<MeshRenderer>(Mesh("square"), Material("bricks2"));
 }
 
 #include "boundingSphere.h"
 #include "aabb.h"
+#include "benchmarks.h"
+#include "profiling.h"
 #include <iostream>
 
 int main()
 {
+	#if PROFILING_RUN_BENCHMARKS != 0
+		Benchmarks::RunAll();
+		return 0;
+	#endif
+
 	BoundingSphere sphere1(Vector3f(0.0f, 0.0f, 0.0f), 1.0f);
 	BoundingSphere sphere2(Vector3f(0.0f, 3.0f, 0.0f), 1.0f);
 	BoundingSphere sphere3(Vector3f(0.0f, 0.0f, 2.0f), 1.0f);
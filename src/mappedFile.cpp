@@ -0,0 +1,118 @@
+#include "mappedFile.h"
+#include <iostream>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(_WIN64) || defined(WIN64)
+	#define OS_WINDOWS
+#endif
+
+#ifdef OS_WINDOWS
+	#include <Windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+	m_data(0),
+	m_size(0),
+	m_fileHandle(0),
+	m_mappingHandle(0) {}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& fileName)
+{
+	Close();
+
+	#ifdef OS_WINDOWS
+		HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if(file == INVALID_HANDLE_VALUE)
+		{
+			std::cerr << "Error: Unable to open " << fileName << std::endl;
+			return false;
+		}
+
+		LARGE_INTEGER size;
+		if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		{
+			std::cerr << "Error: Unable to map " << fileName << ", because it is empty or it's size is unknown" << std::endl;
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+		const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+		if(data == 0)
+		{
+			std::cerr << "Error: Unable to map " << fileName << std::endl;
+			if(mapping)
+			{
+				CloseHandle(mapping);
+			}
+			CloseHandle(file);
+			return false;
+		}
+
+		m_fileHandle = file;
+		m_mappingHandle = mapping;
+		m_data = data;
+		m_size = (size_t)size.QuadPart;
+	#else
+		int file = open(fileName.c_str(), O_RDONLY);
+		if(file == -1)
+		{
+			std::cerr << "Error: Unable to open " << fileName << std::endl;
+			return false;
+		}
+
+		struct stat fileInfo;
+		if(fstat(file, &fileInfo) == -1 || fileInfo.st_size == 0)
+		{
+			std::cerr << "Error: Unable to map " << fileName << ", because it is empty or it's size is unknown" << std::endl;
+			close(file);
+			return false;
+		}
+
+		void* data = mmap(0, (size_t)fileInfo.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+		//The mapping stays valid after the file is closed.
+		close(file);
+
+		if(data == MAP_FAILED)
+		{
+			std::cerr << "Error: Unable to map " << fileName << std::endl;
+			return false;
+		}
+
+		m_data = data;
+		m_size = (size_t)fileInfo.st_size;
+	#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(m_data == 0)
+	{
+		return;
+	}
+
+	#ifdef OS_WINDOWS
+		UnmapViewOfFile(m_data);
+		CloseHandle((HANDLE)m_mappingHandle);
+		CloseHandle((HANDLE)m_fileHandle);
+	#else
+		munmap((void*)m_data, m_size);
+	#endif
+
+	m_data = 0;
+	m_size = 0;
+	m_fileHandle = 0;
+	m_mappingHandle = 0;
+}
@@ -0,0 +1,32 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+//Maps a whole file into memory, read only. The operating system pages the file in as it's
+//accessed, so opening even a large file is cheap, and nothing is copied.
+class MappedFile
+{
+public:
+	MappedFile();
+	virtual ~MappedFile();
+
+	bool Open(const std::string& fileName);
+	void Close();
+
+	inline const void* GetData() const { return m_data; }
+	inline size_t GetSize()      const { return m_size; }
+	inline bool IsOpen()         const { return m_data != 0; }
+protected:
+private:
+	const void* m_data;
+	size_t      m_size;
+	void*       m_fileHandle;    //Only used on Windows
+	void*       m_mappingHandle; //Only used on Windows
+
+	MappedFile(const MappedFile& other) {}
+	void operator=(const MappedFile& other) {}
+};
+
+#endif // MAPPEDFILE_H
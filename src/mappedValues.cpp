@@ -1,34 +1,86 @@
 #include "mappedValues.h"
 
-const Vector3f& MappedValues::GetVector3f(const std::string& name) const
+//--------------------------------------------------------------------------------
+// Forward declarations
+//--------------------------------------------------------------------------------
+template<class T> static void SetValue(std::vector<int>& indices, std::deque<T>& values, unsigned int id, const T& value);
+template<class T> static const T* FindValue(const std::vector<int>& indices, const std::deque<T>& values, unsigned int id);
+
+std::map<std::string, unsigned int> MappedValues::s_valueIds;
+
+unsigned int MappedValues::GetValueId(const std::string& name)
 {
-	std::map<std::string, Vector3f>::const_iterator it = m_vector3fMap.find(name);
-	if(it != m_vector3fMap.end())
+	std::map<std::string, unsigned int>::const_iterator it = s_valueIds.find(name);
+	if(it != s_valueIds.end())
 	{
 		return it->second;
 	}
-		
-	return m_defaultVector3f;
+	
+	unsigned int id = (unsigned int)s_valueIds.size();
+	s_valueIds[name] = id;
+	return id;
+}
+
+void MappedValues::SetVector3f(unsigned int id, const Vector3f& value)
+{
+	SetValue(m_vector3fIndices, m_vector3fs, id, value);
+}
+
+void MappedValues::SetFloat(unsigned int id, float value)
+{
+	SetValue(m_floatIndices, m_floats, id, value);
+}
+
+void MappedValues::SetTexture(unsigned int id, const Texture& value)
+{
+	SetValue(m_textureIndices, m_textures, id, value);
+}
+
+const Vector3f& MappedValues::GetVector3f(unsigned int id) const
+{
+	const Vector3f* value = FindValue(m_vector3fIndices, m_vector3fs, id);
+	return value ? *value : m_defaultVector3f;
 }
 
-float MappedValues::GetFloat(const std::string& name) const
+float MappedValues::GetFloat(unsigned int id) const
 {
-	std::map<std::string, float>::const_iterator it = m_floatMap.find(name);
-	if(it != m_floatMap.end())
+	const float* value = FindValue(m_floatIndices, m_floats, id);
+	return value ? *value : 0;
+}
+
+const Texture& MappedValues::GetTexture(unsigned int id) const
+{
+	const Texture* value = FindValue(m_textureIndices, m_textures, id);
+	return value ? *value : m_defaultTexture;
+}
+
+//--------------------------------------------------------------------------------
+// Static Function Implementations
+//--------------------------------------------------------------------------------
+template<class T> static void SetValue(std::vector<int>& indices, std::deque<T>& values, unsigned int id, const T& value)
+{
+	if(id >= indices.size())
 	{
-		return it->second;
+		indices.resize(id + 1, -1);
+	}
+	
+	if(indices[id] < 0)
+	{
+		indices[id] = (int)values.size();
+		values.push_back(value);
+	}
+	else
+	{
+		values[indices[id]] = value;
 	}
-		
-	return 0;
 }
 
-const Texture& MappedValues::GetTexture(const std::string& name) const
+template<class T> static const T* FindValue(const std::vector<int>& indices, const std::deque<T>& values, unsigned int id)
 {
-	std::map<std::string, Texture>::const_iterator it = m_textureMap.find(name);
-	if(it != m_textureMap.end())
+	if(id < indices.size() && indices[id] >= 0)
 	{
-		return it->second;
+		return &values[indices[id]];
 	}
-		
-	return m_defaultTexture;
+	
+	return 0;
 }
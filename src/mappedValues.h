@@ -2,6 +2,8 @@
 #define MAPPEDVALUES_H_INCLUDED
 
 #include <map>
+#include <deque>
+#include <vector>
 
 #include "texture.h"
 #include "math3d.h"
@@ -13,18 +15,36 @@ public:
 		m_defaultTexture(Texture("defaultTexture.png")),
 		m_defaultVector3f(Vector3f(0,0,0)) {}
 
-	inline void SetVector3f(const std::string& name, const Vector3f& value) { m_vector3fMap[name] = value; }
-	inline void SetFloat(const std::string& name, float value)              { m_floatMap[name] = value; }
-	inline void SetTexture(const std::string& name, const Texture& value)   { m_textureMap[name] = value; }
+	//Every name is given an ID the first time it's used, which is the same in every MappedValues.
+	//Finding a value by it's ID doesn't compare any strings, so shaders find the IDs of their
+	//uniforms' values when they're loaded, and use those to set them.
+	static unsigned int GetValueId(const std::string& name);
+
+	inline void SetVector3f(const std::string& name, const Vector3f& value) { SetVector3f(GetValueId(name), value); }
+	inline void SetFloat(const std::string& name, float value)              { SetFloat(GetValueId(name), value); }
+	inline void SetTexture(const std::string& name, const Texture& value)   { SetTexture(GetValueId(name), value); }
+	void SetVector3f(unsigned int id, const Vector3f& value);
+	void SetFloat(unsigned int id, float value);
+	void SetTexture(unsigned int id, const Texture& value);
 	
-	const Vector3f& GetVector3f(const std::string& name) const;
-	float GetFloat(const std::string& name)              const;
-	const Texture& GetTexture(const std::string& name)   const;
+	inline const Vector3f& GetVector3f(const std::string& name) const { return GetVector3f(GetValueId(name)); }
+	inline float GetFloat(const std::string& name)              const { return GetFloat(GetValueId(name)); }
+	inline const Texture& GetTexture(const std::string& name)   const { return GetTexture(GetValueId(name)); }
+	const Vector3f& GetVector3f(unsigned int id) const;
+	float GetFloat(unsigned int id)              const;
+	const Texture& GetTexture(unsigned int id)   const;
 protected:
 private:
-	std::map<std::string, Vector3f> m_vector3fMap;
-	std::map<std::string, float> m_floatMap;
-	std::map<std::string, Texture> m_textureMap;
+	static std::map<std::string, unsigned int> s_valueIds;
+	
+	//Where each ID's value is in the deques, or -1 if it hasn't been set. Values are only ever
+	//added to the deques, which leaves the others where they are, so references to them stay valid.
+	std::vector<int> m_vector3fIndices;
+	std::vector<int> m_floatIndices;
+	std::vector<int> m_textureIndices;
+	std::deque<Vector3f> m_vector3fs;
+	std::deque<float> m_floats;
+	std::deque<Texture> m_textures;
 	
 	Texture m_defaultTexture;
 	Vector3f m_defaultVector3f;
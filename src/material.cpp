@@ -3,6 +3,7 @@
 #include <cassert>
 
 std::map<std::string, MaterialData*> Material::s_resourceMap;
+unsigned int MaterialData::s_numMaterials = 0;
 
 Material::Material(const std::string& materialName) :
 	m_materialName(materialName)
@@ -59,3 +60,8 @@ Material::Material(const std::string& materialName, const Texture& diffuse, floa
 	m_materialData->SetFloat("dispMapScale", dispMapScale);
 	m_materialData->SetFloat("dispMapBias", -baseBias + baseBias * dispMapOffset);
 }
+
+bool Material::Exists(const std::string& materialName)
+{
+	return materialName.length() > 0 && s_resourceMap.find(materialName) != s_resourceMap.end();
+}
@@ -9,7 +9,13 @@
 class MaterialData : public ReferenceCounter, public MappedValues
 {
 public:
+	MaterialData() :
+		m_sortId(s_numMaterials++) {}
+	
+	inline unsigned int GetSortId() const { return m_sortId; }
 private:
+	static unsigned int s_numMaterials;
+	unsigned int m_sortId;
 };
 
 class Material
@@ -30,6 +36,15 @@ public:
 	inline const Vector3f& GetVector3f(const std::string& name) const { return m_materialData->GetVector3f(name); }
 	inline float GetFloat(const std::string& name)              const { return m_materialData->GetFloat(name); }
 	inline const Texture& GetTexture(const std::string& name)   const { return m_materialData->GetTexture(name); }
+	//By the ID MappedValues::GetValueId gives the name.
+	inline const Vector3f& GetVector3f(unsigned int id)         const { return m_materialData->GetVector3f(id); }
+	inline float GetFloat(unsigned int id)                      const { return m_materialData->GetFloat(id); }
+	inline const Texture& GetTexture(unsigned int id)           const { return m_materialData->GetTexture(id); }
+	inline const std::string& GetName()                         const { return m_materialName; }
+	inline unsigned int GetSortId()                             const { return m_materialData->GetSortId(); }
+	
+	//Whether a material has been created with this name, so it can be found by name.
+	static bool Exists(const std::string& materialName);
 protected:
 private:
 	static std::map<std::string, MaterialData*> s_resourceMap;
@@ -52,6 +52,17 @@ public:
 		return result;
 	}
 
+	inline Vector<T,D> Min(const Vector<T,D>& r) const
+	{
+		Vector<T,D> result;
+		for(unsigned int i = 0; i < D; i++)
+		{
+			result[i] = values[i] < r[i] ? values[i] : r[i];
+		}
+
+		return result;
+	}
+
 	inline T Max() const
 	{
 		T maxVal = (*this)[0];
@@ -364,12 +375,15 @@ public:
 // This function doesn't appear to work!
 	inline Matrix<T, D> Inverse() const
 	{
+		//D is unsigned, and the backward loop counts down past 0, so the loops use a signed size.
+		const int size = (int)D;
 		int i, j, k;
 		Matrix<T, D> s;
 		Matrix<T, D> t(*this);
+		s.InitIdentity();
 
 		// Forward elimination
-		for (i = 0; i < D - 1 ; i++) {
+		for (i = 0; i < size - 1 ; i++) {
 			int pivot = i;
 
 			T pivotsize = t[i][i];
@@ -377,7 +391,7 @@ public:
 			if (pivotsize < 0)
 				pivotsize = -pivotsize;
 
-			for (j = i + 1; j < D; j++) {
+			for (j = i + 1; j < size; j++) {
 				T tmp = t[j][i];
 
 				if (tmp < 0)
@@ -397,7 +411,7 @@ public:
 			}
 
 			if (pivot != i) {
-				for (j = 0; j < D; j++) {
+				for (j = 0; j < size; j++) {
 					T tmp;
 
 					tmp = t[i][j];
@@ -410,10 +424,10 @@ public:
 				}
 			}
 
-			for (j = i + 1; j < D; j++) {
+			for (j = i + 1; j < size; j++) {
 				T f = t[j][i] / t[i][i];
 
-				for (k = 0; k < D; k++) {
+				for (k = 0; k < size; k++) {
 					t[j][k] -= f * t[i][k];
 					s[j][k] -= f * s[i][k];
 				}
@@ -421,7 +435,7 @@ public:
 		}
 
 		// Backward substitution
-		for (i = D - 1; i >= 0; --i) {
+		for (i = size - 1; i >= 0; --i) {
 			T f;
 
 			if ((f = t[i][i]) == 0) {
@@ -431,7 +445,7 @@ public:
 				return Matrix<T, D>();
 			}
 
-			for (j = 0; j < D; j++) {
+			for (j = 0; j < size; j++) {
 				t[i][j] /= f;
 				s[i][j] /= f;
 			}
@@ -439,7 +453,7 @@ public:
 			for (j = 0; j < i; j++) {
 				f = t[j][i];
 
-				for (k = 0; k < D; k++) {
+				for (k = 0; k < size; k++) {
 					t[j][k] -= f * t[i][k];
 					s[j][k] -= f * s[i][k];
 				}
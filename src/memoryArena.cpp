@@ -0,0 +1,77 @@
+#include "memoryArena.h"
+
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+
+MemoryArena::MemoryArena(size_t blockSize) :
+	m_blockSize(blockSize),
+	m_currentBlock(0),
+	m_currentOffset(0),
+	m_numBytesAllocated(0),
+	m_numBytesReserved(0),
+	m_numLiveObjects(0) {}
+
+MemoryArena::~MemoryArena()
+{
+	if(m_numLiveObjects != 0)
+	{
+		std::cerr << "Error: MemoryArena destroyed while " << m_numLiveObjects << " objects still live in it" << std::endl;
+		assert(m_numLiveObjects == 0);
+	}
+
+	for(unsigned int i = 0; i < m_blocks.size(); i++)
+	{
+		delete[] m_blocks[i].memory;
+	}
+}
+
+void* MemoryArena::Allocate(size_t size, size_t alignment)
+{
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+	while(m_currentBlock < m_blocks.size())
+	{
+		Block& block = m_blocks[m_currentBlock];
+
+		uintptr_t start = (uintptr_t)block.memory + m_currentOffset;
+		uintptr_t alignedStart = (start + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		size_t end = (size_t)(alignedStart - (uintptr_t)block.memory) + size;
+
+		if(end <= block.size)
+		{
+			m_currentOffset = end;
+			m_numBytesAllocated += size;
+			return (void*)alignedStart;
+		}
+
+		//Whatever is left at the end of this block is wasted; the blocks are large enough
+		//compared to the objects in them that this doesn't matter much.
+		m_currentBlock++;
+		m_currentOffset = 0;
+	}
+
+	//Allocations that don't fit into a regular block get a block of their own.
+	Block block;
+	block.size = (size + alignment > m_blockSize) ? size + alignment : m_blockSize;
+	block.memory = new char[block.size];
+	m_blocks.push_back(block);
+	m_numBytesReserved += block.size;
+
+	m_currentBlock = m_blocks.size() - 1;
+	m_currentOffset = 0;
+	return Allocate(size, alignment);
+}
+
+void MemoryArena::Reset()
+{
+	if(m_numLiveObjects != 0)
+	{
+		std::cerr << "Error: MemoryArena reset while " << m_numLiveObjects << " objects still live in it" << std::endl;
+		assert(m_numLiveObjects == 0);
+	}
+
+	m_currentBlock = 0;
+	m_currentOffset = 0;
+	m_numBytesAllocated = 0;
+}
@@ -0,0 +1,50 @@
+#ifndef MEMORYARENA_H
+#define MEMORYARENA_H
+
+#include <cstddef>
+#include <vector>
+
+//A MemoryArena hands out memory by bumping a pointer through large blocks, so everything
+//allocated from it ends up packed together in the order it was created. Individual
+//allocations are never freed; instead, Reset releases everything at once. Objects that
+//live in an arena still have to be destructed before the arena is reset.
+//
+//Arenas are not thread safe, and should only be used by one thread at a time.
+class MemoryArena
+{
+public:
+	MemoryArena(size_t blockSize = 64 * 1024);
+	virtual ~MemoryArena();
+
+	void* Allocate(size_t size, size_t alignment = 16);
+
+	//Makes all memory in the arena available again. The blocks are kept, so filling the
+	//arena up again (for instance, by loading the next level) doesn't touch the heap.
+	void Reset();
+
+	inline size_t GetNumBytesAllocated() const { return m_numBytesAllocated; }
+	inline size_t GetNumBytesReserved()  const { return m_numBytesReserved; }
+	inline int GetNumLiveObjects()       const { return m_numLiveObjects; }
+protected:
+private:
+	friend class MemoryPool;
+
+	struct Block
+	{
+		char*  memory;
+		size_t size;
+	};
+
+	std::vector<Block> m_blocks;
+	size_t             m_blockSize;
+	size_t             m_currentBlock;
+	size_t             m_currentOffset;
+	size_t             m_numBytesAllocated;
+	size_t             m_numBytesReserved;
+	int                m_numLiveObjects; //Objects allocated through MemoryPool::AllocateObject that haven't been destructed yet
+
+	MemoryArena(const MemoryArena& other) {}
+	void operator=(const MemoryArena& other) {}
+};
+
+#endif // MEMORYARENA_H
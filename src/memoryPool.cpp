@@ -0,0 +1,180 @@
+#include "memoryPool.h"
+#include "memoryArena.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+//Placed in front of every object allocated by AllocateObject. It is padded to 16 bytes so
+//the object behind it is just as aligned as the memory it came from.
+struct ObjectHeader
+{
+	enum Source
+	{
+		SOURCE_POOL,
+		SOURCE_ARENA,
+		SOURCE_HEAP
+	};
+
+	void* owner; //The MemoryPool or MemoryArena the object came from
+	int   source;
+	int   padding;
+};
+
+static const size_t OBJECT_HEADER_SIZE = 16;
+
+std::atomic<MemoryPool*> MemoryPool::s_sizeClassPools[MemoryPool::NUM_SIZE_CLASSES];
+std::mutex               MemoryPool::s_sizeClassPoolsMutex;
+bool                     MemoryPool::s_poolingEnabled = true;
+
+MemoryPool::MemoryPool(size_t blockSize, size_t blocksPerChunk) :
+	m_blockSize(blockSize < sizeof(FreeBlock) ? sizeof(FreeBlock) : blockSize),
+	m_blocksPerChunk(blocksPerChunk),
+	m_freeList(0),
+	m_numAllocatedBlocks(0) {}
+
+MemoryPool::~MemoryPool()
+{
+	if(m_numAllocatedBlocks != 0)
+	{
+		std::cerr << "Error: MemoryPool destroyed while " << m_numAllocatedBlocks << " blocks are still in use" << std::endl;
+		assert(m_numAllocatedBlocks == 0);
+	}
+
+	for(unsigned int i = 0; i < m_chunks.size(); i++)
+	{
+		delete[] m_chunks[i];
+	}
+}
+
+void* MemoryPool::Allocate()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if(m_freeList == 0)
+	{
+		//The blocks of a new chunk are put on the free list in order, so objects allocated
+		//one after the other end up next to each other in memory.
+		char* chunk = new char[m_blockSize * m_blocksPerChunk];
+		m_chunks.push_back(chunk);
+
+		for(size_t i = m_blocksPerChunk; i > 0; i--)
+		{
+			FreeBlock* block = (FreeBlock*)(chunk + (i - 1) * m_blockSize);
+			block->next = m_freeList;
+			m_freeList = block;
+		}
+	}
+
+	FreeBlock* result = m_freeList;
+	m_freeList = result->next;
+	m_numAllocatedBlocks++;
+	return result;
+}
+
+void MemoryPool::Free(void* block)
+{
+	if(block == 0)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	FreeBlock* freeBlock = (FreeBlock*)block;
+	freeBlock->next = m_freeList;
+	m_freeList = freeBlock;
+	m_numAllocatedBlocks--;
+}
+
+void* MemoryPool::AllocateObject(size_t size)
+{
+	size_t totalSize = size + OBJECT_HEADER_SIZE;
+	ObjectHeader* header;
+
+	MemoryPool* pool = GetSizeClassPool(totalSize);
+	if(pool)
+	{
+		header = (ObjectHeader*)pool->Allocate();
+		header->owner = pool;
+		header->source = ObjectHeader::SOURCE_POOL;
+	}
+	else
+	{
+		header = (ObjectHeader*)malloc(totalSize);
+		if(header == 0)
+		{
+			throw std::bad_alloc();
+		}
+
+		header->owner = 0;
+		header->source = ObjectHeader::SOURCE_HEAP;
+	}
+
+	return (char*)header + OBJECT_HEADER_SIZE;
+}
+
+void* MemoryPool::AllocateObject(size_t size, MemoryArena& arena)
+{
+	ObjectHeader* header = (ObjectHeader*)arena.Allocate(size + OBJECT_HEADER_SIZE, OBJECT_HEADER_SIZE);
+	header->owner = &arena;
+	header->source = ObjectHeader::SOURCE_ARENA;
+	arena.m_numLiveObjects++;
+
+	return (char*)header + OBJECT_HEADER_SIZE;
+}
+
+void MemoryPool::FreeObject(void* object)
+{
+	if(object == 0)
+	{
+		return;
+	}
+
+	ObjectHeader* header = (ObjectHeader*)((char*)object - OBJECT_HEADER_SIZE);
+	switch(header->source)
+	{
+		case ObjectHeader::SOURCE_POOL:
+			((MemoryPool*)header->owner)->Free(header);
+			break;
+		case ObjectHeader::SOURCE_ARENA:
+			//The memory itself is released when the arena is reset.
+			((MemoryArena*)header->owner)->m_numLiveObjects--;
+			break;
+		case ObjectHeader::SOURCE_HEAP:
+			free(header);
+			break;
+		default:
+			std::cerr << "Error: Freeing object " << object << " which was not allocated by MemoryPool::AllocateObject" << std::endl;
+			assert(false);
+	}
+}
+
+MemoryPool* MemoryPool::GetSizeClassPool(size_t size)
+{
+	if(!s_poolingEnabled || size > MAX_POOLED_OBJECT_SIZE)
+	{
+		return 0;
+	}
+
+	size_t sizeClass = (size + SIZE_CLASS_GRANULARITY - 1) / SIZE_CLASS_GRANULARITY - 1;
+
+	MemoryPool* pool = s_sizeClassPools[sizeClass].load(std::memory_order_acquire);
+	if(pool)
+	{
+		return pool;
+	}
+
+	//Pools are created the first time something of their size is allocated. They are
+	//never destroyed, since objects may still be deleted during static destruction.
+	std::lock_guard<std::mutex> lock(s_sizeClassPoolsMutex);
+	pool = s_sizeClassPools[sizeClass].load(std::memory_order_relaxed);
+	if(pool == 0)
+	{
+		pool = new MemoryPool((sizeClass + 1) * SIZE_CLASS_GRANULARITY);
+		s_sizeClassPools[sizeClass].store(pool, std::memory_order_release);
+	}
+
+	return pool;
+}
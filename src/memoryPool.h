@@ -0,0 +1,68 @@
+#ifndef MEMORYPOOL_H
+#define MEMORYPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+class MemoryArena;
+
+//A MemoryPool hands out blocks of one fixed size. Blocks are carved out of large chunks,
+//and freed blocks are kept on a free list for reuse, so allocating and freeing is cheap
+//and objects of the same kind stay close together in memory.
+//
+//The static functions at the bottom are used by classes that route their operator new and
+//delete through pools, such as Entity and EntityComponent. Every object they allocate gets
+//a small header telling where it came from, so it can always be deleted the regular way,
+//whether it lives in a pool, in a MemoryArena or on the heap.
+class MemoryPool
+{
+public:
+	MemoryPool(size_t blockSize, size_t blocksPerChunk = 256);
+	virtual ~MemoryPool();
+
+	void* Allocate();
+	void Free(void* block);
+
+	inline size_t GetBlockSize()          const { return m_blockSize; }
+	inline size_t GetNumAllocatedBlocks() const { return m_numAllocatedBlocks; }
+
+	static void* AllocateObject(size_t size);
+	static void* AllocateObject(size_t size, MemoryArena& arena);
+	static void FreeObject(void* object);
+	
+	//When disabled, AllocateObject puts objects on the heap instead of in pools. Useful for
+	//comparisons, and for tools that find memory errors by tracking heap allocations.
+	static void SetPoolingEnabled(bool enabled) { s_poolingEnabled = enabled; }
+protected:
+private:
+	//Objects up to this size get pools; anything larger goes on the heap.
+	static const size_t MAX_POOLED_OBJECT_SIZE = 1024;
+	//Object sizes are rounded up to a multiple of this, and each multiple has it's own pool.
+	static const size_t SIZE_CLASS_GRANULARITY = 16;
+	static const size_t NUM_SIZE_CLASSES = MAX_POOLED_OBJECT_SIZE / SIZE_CLASS_GRANULARITY;
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	size_t             m_blockSize;
+	size_t             m_blocksPerChunk;
+	FreeBlock*         m_freeList;
+	std::vector<char*> m_chunks;
+	size_t             m_numAllocatedBlocks;
+	std::mutex         m_mutex;
+
+	static std::atomic<MemoryPool*> s_sizeClassPools[NUM_SIZE_CLASSES];
+	static std::mutex               s_sizeClassPoolsMutex;
+	static bool                     s_poolingEnabled;
+
+	static MemoryPool* GetSizeClassPool(size_t size);
+
+	MemoryPool(const MemoryPool& other) {}
+	void operator=(const MemoryPool& other) {}
+};
+
+#endif // MEMORYPOOL_H
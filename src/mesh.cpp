@@ -1,16 +1,20 @@
 #include "mesh.h"
-#include "profiling.h"
+#include "meshOptimizer.h"
 #include <GL/glew.h>
 #include <iostream>
 
-#include <vector>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <vector>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
 std::map<std::string, MeshData*> Mesh::s_resourceMap;
+unsigned int MeshData::s_numMeshes = 0;
+MeshPool MeshData::s_pool;
 
 bool IndexedModel::IsValid() const
 {
@@ -39,6 +43,41 @@ void IndexedModel::AddTangent(const Vector3f& tangent)
 	m_tangents.push_back(tangent);
 }
 
+AABB IndexedModel::CalcAABB() const
+{
+	if(m_positions.empty())
+	{
+		return AABB(Vector3f(0,0,0), Vector3f(0,0,0));
+	}
+	
+	Vector3f minExtents = m_positions[0];
+	Vector3f maxExtents = m_positions[0];
+	
+	for(unsigned int i = 1; i < m_positions.size(); i++)
+	{
+		minExtents = Vector3f(minExtents.Min(m_positions[i]));
+		maxExtents = Vector3f(maxExtents.Max(m_positions[i]));
+	}
+	
+	return AABB(minExtents, maxExtents);
+}
+
+BoundingSphere IndexedModel::CalcBoundingSphere() const
+{
+	//Centered on the box, which is close enough to the smallest sphere for culling, and much
+	//cheaper to find.
+	AABB aabb = CalcAABB();
+	Vector3f center = (aabb.GetMinExtents() + aabb.GetMaxExtents()) / 2.0f;
+	
+	float radiusSquared = 0.0f;
+	for(unsigned int i = 0; i < m_positions.size(); i++)
+	{
+		radiusSquared = std::max(radiusSquared, (m_positions[i] - center).LengthSq());
+	}
+	
+	return BoundingSphere(center, sqrtf(radiusSquared));
+}
+
 IndexedModel IndexedModel::Finalize()
 {
 	if(IsValid())
@@ -67,6 +106,70 @@ IndexedModel IndexedModel::Finalize()
 	return *this;
 }
 
+void IndexedModel::GenerateLods(unsigned int numLods)
+{
+	m_lodIndices.clear();
+	
+	for(unsigned int lod = 1; lod < numLods; lod++)
+	{
+		const std::vector<unsigned int>& finer = GetLodIndices(lod - 1);
+		std::vector<unsigned int> coarser;
+		MeshOptimizer::Simplify(finer, m_positions, (unsigned int)finer.size() / 6 * 3, coarser);
+		
+		//An LOD with nearly as many triangles isn't worth switching to.
+		if(coarser.size() * 4 > finer.size() * 3)
+		{
+			break;
+		}
+		
+		m_lodIndices.push_back(coarser);
+	}
+}
+
+void IndexedModel::Optimize()
+{
+	assert(IsValid());
+
+	unsigned int numVertices = (unsigned int)m_positions.size();
+	std::vector<unsigned int> clusterStarts;
+	MeshOptimizer::OptimizeVertexCache(m_indices, numVertices, clusterStarts);
+	MeshOptimizer::OptimizeOverdraw(m_indices, m_positions, clusterStarts);
+	
+	for(unsigned int i = 0; i < m_lodIndices.size(); i++)
+	{
+		MeshOptimizer::OptimizeVertexCache(m_lodIndices[i], numVertices, clusterStarts);
+		MeshOptimizer::OptimizeOverdraw(m_lodIndices[i], m_positions, clusterStarts);
+	}
+
+	std::vector<unsigned int> remap;
+	MeshOptimizer::OptimizeVertexFetch(m_indices, numVertices, remap);
+	
+	for(unsigned int i = 0; i < m_lodIndices.size(); i++)
+	{
+		for(unsigned int j = 0; j < m_lodIndices[i].size(); j++)
+		{
+			m_lodIndices[i][j] = remap[m_lodIndices[i][j]];
+		}
+	}
+
+	std::vector<Vector3f> positions(numVertices);
+	std::vector<Vector2f> texCoords(numVertices);
+	std::vector<Vector3f> normals(numVertices);
+	std::vector<Vector3f> tangents(numVertices);
+	for(unsigned int i = 0; i < numVertices; i++)
+	{
+		positions[remap[i]] = m_positions[i];
+		texCoords[remap[i]] = m_texCoords[i];
+		normals[remap[i]] = m_normals[i];
+		tangents[remap[i]] = m_tangents[i];
+	}
+
+	m_positions.swap(positions);
+	m_texCoords.swap(texCoords);
+	m_normals.swap(normals);
+	m_tangents.swap(tangents);
+}
+
 void IndexedModel::AddFace(unsigned int vertIndex0, unsigned int vertIndex1, unsigned int vertIndex2)
 {
 	m_indices.push_back(vertIndex0);
@@ -152,7 +255,9 @@ void IndexedModel::CalcTangents()
 
 MeshData::MeshData(const IndexedModel& model) : 
 	ReferenceCounter(),
-	m_drawCount(model.GetIndices().size())
+	m_aabb(model.CalcAABB()),
+	m_boundingSphere(model.CalcBoundingSphere()),
+	m_sortId(s_numMeshes++)
 {
 	if(!model.IsValid())
 	{
@@ -160,51 +265,42 @@ MeshData::MeshData(const IndexedModel& model) :
 			<< "(Maybe you forgot to Finalize() your IndexedModel?)" << std::endl;
 		assert(0 != 0);
 	}
-	glGenVertexArrays(1, &m_vertexArrayObject);
-	glBindVertexArray(m_vertexArrayObject);
-
-	glGenBuffers(NUM_BUFFERS, m_vertexArrayBuffers);
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[POSITION_VB]);
-	glBufferData(GL_ARRAY_BUFFER, model.GetPositions().size() * sizeof(model.GetPositions()[0]), &model.GetPositions()[0], GL_STATIC_DRAW);
 	
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[TEXCOORD_VB]);
-	glBufferData(GL_ARRAY_BUFFER, model.GetTexCoords().size() * sizeof(model.GetTexCoords()[0]), &model.GetTexCoords()[0], GL_STATIC_DRAW);
-	
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[NORMAL_VB]);
-	glBufferData(GL_ARRAY_BUFFER, model.GetNormals().size() * sizeof(model.GetNormals()[0]), &model.GetNormals()[0], GL_STATIC_DRAW);
-	
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, m_vertexArrayBuffers[TANGENT_VB]);
-	glBufferData(GL_ARRAY_BUFFER, model.GetTangents().size() * sizeof(model.GetTangents()[0]), &model.GetTangents()[0], GL_STATIC_DRAW);
-	
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vertexArrayBuffers[INDEX_VB]);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, model.GetIndices().size() * sizeof(model.GetIndices()[0]), &model.GetIndices()[0], GL_STATIC_DRAW);
+	m_poolRanges.push_back(s_pool.Allocate(model));
+	for(unsigned int i = 1; i < model.GetNumLods(); i++)
+	{
+		m_poolRanges.push_back(s_pool.AllocateIndices(m_poolRanges[0], model.GetLodIndices(i)));
+	}
 }
 
 MeshData::~MeshData() 
 {	
-	glDeleteBuffers(NUM_BUFFERS, m_vertexArrayBuffers);
-	glDeleteVertexArrays(1, &m_vertexArrayObject);
+	for(unsigned int i = 0; i < m_poolRanges.size(); i++)
+	{
+		s_pool.Free(m_poolRanges[i]);
+	}
 }
 
-void MeshData::Draw() const
+void MeshData::Draw(unsigned int lod) const
 {
-	glBindVertexArray(m_vertexArrayObject);
-	
-	#if PROFILING_DISABLE_MESH_DRAWING == 0
-		glDrawElements(GL_TRIANGLES, m_drawCount, GL_UNSIGNED_INT, 0);
-	#endif
+	Bind();
+	DrawElements(lod);
+}
+
+void MeshData::Bind() const
+{
+	s_pool.Bind(m_poolRanges[0].indexType);
+}
+
+void MeshData::DrawInstanced(GLuint instanceBuffer, int numInstances) const
+{
+	s_pool.DrawInstanced(m_poolRanges[0], instanceBuffer, 0, numInstances);
+}
+
+void MeshData::DrawElements(unsigned int lod) const
+{
+	assert(lod < m_poolRanges.size());
+	s_pool.Draw(m_poolRanges[lod]);
 }
 
 
@@ -240,6 +336,7 @@ Mesh::Mesh(const std::string& fileName) :
 		
 		const aiScene* scene = importer.ReadFile(("./res/models/" + fileName).c_str(), 
 		                                         aiProcess_Triangulate |
+		                                         aiProcess_JoinIdenticalVertices |
 		                                         aiProcess_GenSmoothNormals | 
 		                                         aiProcess_FlipUVs |
 		                                         aiProcess_CalcTangentSpace);
@@ -281,7 +378,24 @@ Mesh::Mesh(const std::string& fileName) :
 			indices.push_back(face.mIndices[2]);
 		}
 		
-		m_meshData = new MeshData(IndexedModel(indices, positions, texCoords, normals, tangents));
+		IndexedModel indexedModel(indices, positions, texCoords, normals, tangents);
+		indexedModel.GenerateLods(MAX_LODS);
+		
+		MeshOptimizer::CacheStats before = MeshOptimizer::CalcCacheStats(indexedModel.GetIndices(), model->mNumVertices);
+		indexedModel.Optimize();
+		MeshOptimizer::CacheStats after = MeshOptimizer::CalcCacheStats(indexedModel.GetIndices(), model->mNumVertices);
+
+		std::cout << "Optimized " << fileName << ": ACMR " << before.acmr << " -> " << after.acmr
+		          << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+		
+		std::cout << "LODs of " << fileName << ":";
+		for(unsigned int i = 0; i < indexedModel.GetNumLods(); i++)
+		{
+			std::cout << " " << indexedModel.GetLodIndices(i).size() / 3;
+		}
+		std::cout << " triangles" << std::endl;
+
+		m_meshData = new MeshData(indexedModel);
 		s_resourceMap.insert(std::pair<std::string, MeshData*>(fileName, m_meshData));
 	}
 }
@@ -306,7 +420,7 @@ Mesh::~Mesh()
 	}
 }
 
-void Mesh::Draw() const
+void Mesh::Draw(unsigned int lod) const
 {
-	m_meshData->Draw();
+	m_meshData->Draw(lod);
 }
@@ -1,7 +1,10 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include "aabb.h"
+#include "boundingSphere.h"
 #include "math3d.h"
+#include "meshPool.h"
 #include "referenceCounter.h"
 #include <string>
 #include <vector>
@@ -23,8 +26,20 @@ public:
 	bool IsValid() const;
 	void CalcNormals();
 	void CalcTangents();
+	
+	//Bounds of the positions, in model space.
+	AABB CalcAABB() const;
+	BoundingSphere CalcBoundingSphere() const;
 
 	IndexedModel Finalize();
+	//Simplifies the triangles into up to numLods - 1 coarser LODs, each with about half the
+	//triangles of the one before, which use the same vertices. Stops early if simplifying stops
+	//paying off.
+	void GenerateLods(unsigned int numLods);
+	//Reorders every LOD's triangles for the vertex cache and overdraw, then the vertices into the
+	//order LOD 0 first uses them, with MeshOptimizer. What's drawn doesn't change. The model has
+	//to be valid.
+	void Optimize();
 
 	void AddVertex(const Vector3f& vert);
 	inline void AddVertex(float x, float y, float z) { AddVertex(Vector3f(x, y, z)); }
@@ -45,12 +60,17 @@ public:
 	inline const std::vector<Vector2f>& GetTexCoords()   const { return m_texCoords; }
 	inline const std::vector<Vector3f>& GetNormals()     const { return m_normals; }
 	inline const std::vector<Vector3f>& GetTangents()    const { return m_tangents; }
+	
+	//LOD 0 is the full resolution indices.
+	inline unsigned int GetNumLods()                     const { return (unsigned int)m_lodIndices.size() + 1; }
+	inline const std::vector<unsigned int>& GetLodIndices(unsigned int lod) const { return lod == 0 ? m_indices : m_lodIndices[lod - 1]; }
 private:
 	std::vector<unsigned int> m_indices;
     std::vector<Vector3f> m_positions;
     std::vector<Vector2f> m_texCoords;
     std::vector<Vector3f> m_normals;
     std::vector<Vector3f> m_tangents;  
+    std::vector<std::vector<unsigned int> > m_lodIndices; //LODs 1 and up
 };
 
 class MeshData : public ReferenceCounter
@@ -59,38 +79,65 @@ public:
 	MeshData(const IndexedModel& model);
 	virtual ~MeshData();
 	
-	void Draw() const;
+	void Draw(unsigned int lod) const;
+	void Bind() const;
+	void DrawElements(unsigned int lod) const;
+	void DrawInstanced(GLuint instanceBuffer, int numInstances) const;
+	
+	inline const AABB& GetAABB()                     const { return m_aabb; }
+	inline const BoundingSphere& GetBoundingSphere() const { return m_boundingSphere; }
+	inline unsigned int GetSortId()                  const { return m_sortId; }
+	inline unsigned int GetNumLods()                 const { return (unsigned int)m_poolRanges.size(); }
+	inline const MeshPoolRange& GetPoolRange(unsigned int lod) const { return m_poolRanges[lod]; }
+	
+	//Every mesh is in this pool.
+	static inline const MeshPool& GetPool() { return s_pool; }
 protected:	
 private:
-	MeshData(MeshData& other) {}
+	MeshData(MeshData& other) : m_aabb(other.m_aabb), m_boundingSphere(other.m_boundingSphere) {}
 	void operator=(MeshData& other) {}
-
-	enum
-	{
-		POSITION_VB,
-		TEXCOORD_VB,
-		NORMAL_VB,
-		TANGENT_VB,
-		
-		INDEX_VB,
-		
-		NUM_BUFFERS
-	};
-	
-	GLuint m_vertexArrayObject;
-	GLuint m_vertexArrayBuffers[NUM_BUFFERS];
-	int m_drawCount;
+	
+	std::vector<MeshPoolRange> m_poolRanges; //One per LOD. They all share LOD 0's vertices.
+	AABB m_aabb;
+	BoundingSphere m_boundingSphere;
+	unsigned int m_sortId;
+	
+	static unsigned int s_numMeshes;
+	static MeshPool s_pool;
 };
 
 class Mesh
 {
 public:
+	//The most LODs a loaded mesh gets, including the full resolution one. The render queue only
+	//has room for 2 bits of LOD.
+	static const unsigned int MAX_LODS = 4;
+	
 	Mesh(const std::string& fileName = "cube.obj");
 	Mesh(const std::string& meshName, const IndexedModel& model);
 	Mesh(const Mesh& mesh);
 	virtual ~Mesh();
 
-	void Draw() const;
+	//lod has to be less than GetNumLods(). LOD 0 is the full resolution mesh.
+	void Draw(unsigned int lod = 0) const;
+	
+	//Draw split in two, so consecutive draws only have to bind once. Every mesh with the same
+	//index size is bound the same way, since they're all in the same pool.
+	inline void Bind()                               const { m_meshData->Bind(); }
+	inline void DrawElements(unsigned int lod = 0)   const { m_meshData->DrawElements(lod); }
+	
+	//Draws numInstances copies of the bound mesh. Each reads it's model matrix from
+	//instanceBuffer, as attributes 4 to 7.
+	inline void DrawInstanced(GLuint instanceBuffer, int numInstances) const { m_meshData->DrawInstanced(instanceBuffer, numInstances); }
+	
+	inline const std::string& GetName()              const { return m_fileName; }
+	inline const AABB& GetAABB()                     const { return m_meshData->GetAABB(); }
+	inline const BoundingSphere& GetBoundingSphere() const { return m_meshData->GetBoundingSphere(); }
+	inline unsigned int GetSortId()                  const { return m_meshData->GetSortId(); }
+	inline unsigned int GetNumLods()                 const { return m_meshData->GetNumLods(); }
+	inline const MeshPoolRange& GetPoolRange(unsigned int lod = 0) const { return m_meshData->GetPoolRange(lod); }
+	
+	static inline const MeshPool& GetPool() { return MeshData::GetPool(); }
 protected:
 private:
 	static std::map<std::string, MeshData*> s_resourceMap;
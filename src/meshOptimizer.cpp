@@ -0,0 +1,574 @@
+#include "meshOptimizer.h"
+#include <algorithm>
+#include <cassert>
+#include <stdint.h>
+
+//A cluster of triangles, and how much it faces away from the center of the mesh.
+struct OverdrawCluster
+{
+	unsigned int start;
+	unsigned int end;
+	float        outwardness;
+};
+
+static bool CompareOutwardness(const OverdrawCluster& a, const OverdrawCluster& b)
+{
+	return a.outwardness > b.outwardness;
+}
+
+//The sum of the squared distances to a set of planes, as the upper half of a symmetric 4x4
+//matrix. Doubles, since the terms cancel out a lot near the planes.
+struct Quadric
+{
+	double a2, ab, ac, ad;
+	double     b2, bc, bd;
+	double         c2, cd;
+	double             d2;
+
+	Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0) {}
+
+	void AddPlane(const Vector3f& normal, float distance, float weight)
+	{
+		double a = normal.GetX(), b = normal.GetY(), c = normal.GetZ(), d = distance;
+		a2 += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+		b2 += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+		c2 += weight * c * c; cd += weight * c * d;
+		d2 += weight * d * d;
+	}
+
+	void Add(const Quadric& r)
+	{
+		a2 += r.a2; ab += r.ab; ac += r.ac; ad += r.ad;
+		b2 += r.b2; bc += r.bc; bd += r.bd;
+		c2 += r.c2; cd += r.cd;
+		d2 += r.d2;
+	}
+
+	double Evaluate(const Vector3f& v) const
+	{
+		double x = v.GetX(), y = v.GetY(), z = v.GetZ();
+		return x * x * a2 + 2 * x * y * ab + 2 * x * z * ac + 2 * x * ad
+			+ y * y * b2 + 2 * y * z * bc + 2 * y * bd
+			+ z * z * c2 + 2 * z * cd
+			+ d2;
+	}
+};
+
+struct EdgeCollapse
+{
+	unsigned int source;
+	unsigned int target;
+	double       cost;
+};
+
+static bool CompareCost(const EdgeCollapse& a, const EdgeCollapse& b)
+{
+	return a.cost < b.cost;
+}
+
+static bool ComparePositions(const std::pair<Vector3f, unsigned int>& a, const std::pair<Vector3f, unsigned int>& b)
+{
+	if(a.first.GetX() != b.first.GetX()) return a.first.GetX() < b.first.GetX();
+	if(a.first.GetY() != b.first.GetY()) return a.first.GetY() < b.first.GetY();
+	if(a.first.GetZ() != b.first.GetZ()) return a.first.GetZ() < b.first.GetZ();
+	return a.second < b.second;
+}
+
+static inline uint64_t MakeEdgeKey(unsigned int a, unsigned int b)
+{
+	return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+//Whether moving source to target flips, flattens, or turns too far, any triangle around source
+//that doesn't also use target. Triangles turned by more than 60 degrees in one collapse fold over
+//after a few more.
+static bool CollapseFlipsTriangles(const std::vector<unsigned int>& indices, const std::vector<Vector3f>& positions,
+	const unsigned int* triangles, unsigned int numTriangles, unsigned int source, unsigned int target)
+{
+	static const float MIN_NORMAL_COS = 0.5f;
+
+	for(unsigned int i = 0; i < numTriangles; i++)
+	{
+		const unsigned int* triangle = &indices[triangles[i] * 3];
+		if(triangle[0] == target || triangle[1] == target || triangle[2] == target)
+		{
+			continue;
+		}
+
+		Vector3f p[3];
+		Vector3f moved[3];
+		for(unsigned int j = 0; j < 3; j++)
+		{
+			p[j] = positions[triangle[j]];
+			moved[j] = triangle[j] == source ? positions[target] : p[j];
+		}
+
+		Vector3f normal = (p[1] - p[0]).Cross(p[2] - p[0]);
+		Vector3f movedNormal = (moved[1] - moved[0]).Cross(moved[2] - moved[0]);
+		if(normal.Dot(movedNormal) <= MIN_NORMAL_COS * normal.Length() * movedNormal.Length())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::CalcCacheStats(const std::vector<unsigned int>& indices, unsigned int numVertices, unsigned int cacheSize)
+{
+	//A vertex is in the cache if fewer than cacheSize misses have happened since it was added.
+	std::vector<unsigned int> addedAt(numVertices, 0);
+	std::vector<bool> used(numVertices, false);
+	unsigned int numMisses = 0;
+	unsigned int numUsedVertices = 0;
+
+	for(unsigned int i = 0; i < indices.size(); i++)
+	{
+		unsigned int vertex = indices[i];
+		assert(vertex < numVertices);
+
+		if(!used[vertex])
+		{
+			used[vertex] = true;
+			numUsedVertices++;
+		}
+		else if(numMisses - addedAt[vertex] < cacheSize)
+		{
+			continue;
+		}
+
+		addedAt[vertex] = numMisses;
+		numMisses++;
+	}
+
+	CacheStats stats;
+	stats.acmr = indices.empty() ? 0.0f : (float)numMisses / (float)(indices.size() / 3);
+	stats.atvr = numUsedVertices == 0 ? 0.0f : (float)numMisses / (float)numUsedVertices;
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int numVertices, std::vector<unsigned int>& clusterStarts)
+{
+	const int cacheSize = (int)CACHE_SIZE;
+	unsigned int numTriangles = (unsigned int)indices.size() / 3;
+	clusterStarts.clear();
+
+	if(numTriangles == 0)
+	{
+		return;
+	}
+
+	//The triangles around each vertex, and how many of them haven't been emitted yet.
+	std::vector<unsigned int> liveCounts(numVertices, 0);
+	for(unsigned int i = 0; i < numTriangles * 3; i++)
+	{
+		liveCounts[indices[i]]++;
+	}
+
+	std::vector<unsigned int> adjacencyOffsets(numVertices + 1, 0);
+	for(unsigned int i = 0; i < numVertices; i++)
+	{
+		adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveCounts[i];
+	}
+
+	std::vector<unsigned int> adjacency(numTriangles * 3);
+	std::vector<unsigned int> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for(unsigned int i = 0; i < numTriangles * 3; i++)
+	{
+		adjacency[adjacencyFill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<int> cacheTimes(numVertices, 0);
+	std::vector<bool> emitted(numTriangles, false);
+	std::vector<unsigned int> deadEnds;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> result;
+	result.reserve(numTriangles * 3);
+
+	int time = cacheSize + 1;
+	unsigned int cursor = 0;
+	int fanVertex = 0;
+	bool jumped = true;
+
+	while(fanVertex >= 0)
+	{
+		if(jumped)
+		{
+			clusterStarts.push_back((unsigned int)result.size() / 3);
+			jumped = false;
+		}
+
+		candidates.clear();
+		for(unsigned int i = adjacencyOffsets[fanVertex]; i < adjacencyOffsets[fanVertex + 1]; i++)
+		{
+			unsigned int triangle = adjacency[i];
+			if(emitted[triangle])
+			{
+				continue;
+			}
+
+			for(unsigned int j = 0; j < 3; j++)
+			{
+				unsigned int vertex = indices[triangle * 3 + j];
+				result.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveCounts[vertex]--;
+
+				if(time - cacheTimes[vertex] > cacheSize)
+				{
+					cacheTimes[vertex] = time;
+					time++;
+				}
+			}
+			emitted[triangle] = true;
+		}
+
+		//The next fan is around the candidate that's been in the cache longest, as long as it'll
+		//still be there after it's remaining triangles are emitted.
+		int nextVertex = -1;
+		int bestPriority = -1;
+		for(unsigned int i = 0; i < candidates.size(); i++)
+		{
+			unsigned int vertex = candidates[i];
+			if(liveCounts[vertex] == 0)
+			{
+				continue;
+			}
+
+			int priority = 0;
+			if(time - cacheTimes[vertex] + 2 * (int)liveCounts[vertex] <= cacheSize)
+			{
+				priority = time - cacheTimes[vertex];
+			}
+
+			if(priority > bestPriority)
+			{
+				bestPriority = priority;
+				nextVertex = (int)vertex;
+			}
+		}
+
+		if(nextVertex < 0)
+		{
+			//A dead end, so the most recently used vertex that has triangles left, or else the
+			//next one in order.
+			jumped = true;
+			while(!deadEnds.empty() && nextVertex < 0)
+			{
+				unsigned int vertex = deadEnds.back();
+				deadEnds.pop_back();
+				if(liveCounts[vertex] > 0)
+				{
+					nextVertex = (int)vertex;
+				}
+			}
+
+			while(nextVertex < 0 && cursor < numVertices)
+			{
+				if(liveCounts[cursor] > 0)
+				{
+					nextVertex = (int)cursor;
+				}
+				cursor++;
+			}
+		}
+
+		fanVertex = nextVertex;
+	}
+
+	assert(result.size() == numTriangles * 3);
+	std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vector3f>& positions, const std::vector<unsigned int>& clusterStarts)
+{
+	unsigned int numTriangles = (unsigned int)indices.size() / 3;
+	if(clusterStarts.size() < 2)
+	{
+		return;
+	}
+
+	Vector3f meshCenter(0, 0, 0);
+	for(unsigned int i = 0; i < numTriangles * 3; i++)
+	{
+		meshCenter += positions[indices[i]];
+	}
+	meshCenter = meshCenter / (float)(numTriangles * 3);
+
+	//The cross products are twice each triangle's area, so bigger triangles count for more.
+	std::vector<OverdrawCluster> clusters(clusterStarts.size());
+	for(unsigned int i = 0; i < clusters.size(); i++)
+	{
+		OverdrawCluster& cluster = clusters[i];
+		cluster.start = clusterStarts[i];
+		cluster.end = i + 1 < clusterStarts.size() ? clusterStarts[i + 1] : numTriangles;
+
+		Vector3f center(0, 0, 0);
+		Vector3f normal(0, 0, 0);
+		for(unsigned int j = cluster.start; j < cluster.end; j++)
+		{
+			const Vector3f& p0 = positions[indices[j * 3]];
+			const Vector3f& p1 = positions[indices[j * 3 + 1]];
+			const Vector3f& p2 = positions[indices[j * 3 + 2]];
+
+			center += p0 + p1 + p2;
+			normal += (p1 - p0).Cross(p2 - p0);
+		}
+
+		center = center / (float)((cluster.end - cluster.start) * 3);
+		cluster.outwardness = (center - meshCenter).Dot(normal);
+	}
+
+	//Stable, so clusters that face out as much as each other keep their order.
+	std::stable_sort(clusters.begin(), clusters.end(), CompareOutwardness);
+
+	std::vector<unsigned int> result;
+	result.reserve(numTriangles * 3);
+	for(unsigned int i = 0; i < clusters.size(); i++)
+	{
+		result.insert(result.end(), indices.begin() + clusters[i].start * 3, indices.begin() + clusters[i].end * 3);
+	}
+
+	std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int numVertices, std::vector<unsigned int>& remap)
+{
+	static const unsigned int UNUSED = 0xFFFFFFFF;
+
+	remap.assign(numVertices, UNUSED);
+	unsigned int numRemapped = 0;
+
+	for(unsigned int i = 0; i < indices.size(); i++)
+	{
+		unsigned int& vertex = indices[i];
+		if(remap[vertex] == UNUSED)
+		{
+			remap[vertex] = numRemapped++;
+		}
+		vertex = remap[vertex];
+	}
+
+	for(unsigned int i = 0; i < numVertices; i++)
+	{
+		if(remap[i] == UNUSED)
+		{
+			remap[i] = numRemapped++;
+		}
+	}
+}
+
+void MeshOptimizer::Simplify(const std::vector<unsigned int>& indices, const std::vector<Vector3f>& positions, unsigned int targetNumIndices, std::vector<unsigned int>& result)
+{
+	unsigned int numVertices = (unsigned int)positions.size();
+	result = indices;
+
+	//Each vertex starts with the planes of the triangles around it, weighted by their area.
+	std::vector<Quadric> quadrics(numVertices);
+	for(unsigned int i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const Vector3f& p0 = positions[indices[i]];
+		Vector3f normal = (positions[indices[i + 1]] - p0).Cross(positions[indices[i + 2]] - p0);
+		float doubleArea = normal.Length();
+		if(doubleArea == 0.0f)
+		{
+			continue;
+		}
+
+		normal = normal / doubleArea;
+		for(unsigned int j = 0; j < 3; j++)
+		{
+			quadrics[indices[i + j]].AddPlane(normal, -normal.Dot(p0), doubleArea * 0.5f);
+		}
+	}
+
+	//Vertices that share their position with another are where UVs or normals are split.
+	std::vector<bool> locked(numVertices, false);
+	std::vector<std::pair<Vector3f, unsigned int> > sortedPositions(numVertices);
+	for(unsigned int i = 0; i < numVertices; i++)
+	{
+		sortedPositions[i] = std::make_pair(positions[i], i);
+	}
+	std::sort(sortedPositions.begin(), sortedPositions.end(), ComparePositions);
+
+	for(unsigned int i = 1; i < numVertices; i++)
+	{
+		if(sortedPositions[i].first == sortedPositions[i - 1].first)
+		{
+			locked[sortedPositions[i].second] = true;
+			locked[sortedPositions[i - 1].second] = true;
+		}
+	}
+
+	//Edges with anything but two triangles are on an open edge, or where the mesh isn't a
+	//surface.
+	std::vector<uint64_t> edges;
+	edges.reserve(result.size());
+	for(unsigned int i = 0; i + 2 < result.size(); i += 3)
+	{
+		for(unsigned int j = 0; j < 3; j++)
+		{
+			edges.push_back(MakeEdgeKey(result[i + j], result[i + (j + 1) % 3]));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	for(unsigned int i = 0; i < edges.size();)
+	{
+		unsigned int count = 1;
+		while(i + count < edges.size() && edges[i + count] == edges[i])
+		{
+			count++;
+		}
+
+		if(count != 2)
+		{
+			locked[(unsigned int)(edges[i] >> 32)] = true;
+			locked[(unsigned int)(edges[i] & 0xFFFFFFFF)] = true;
+		}
+		i += count;
+	}
+
+	//Collapsing one edge changes the cost of the ones around it, so each pass only collapses
+	//edges whose neighbourhoods don't overlap, then everything is measured again.
+	std::vector<EdgeCollapse> collapses;
+	std::vector<unsigned int> adjacencyOffsets(numVertices + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<bool> touched(numVertices);
+
+	while(result.size() > targetNumIndices)
+	{
+		edges.clear();
+		for(unsigned int i = 0; i + 2 < result.size(); i += 3)
+		{
+			for(unsigned int j = 0; j < 3; j++)
+			{
+				edges.push_back(MakeEdgeKey(result[i + j], result[i + (j + 1) % 3]));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		collapses.clear();
+		for(unsigned int i = 0; i < edges.size(); i++)
+		{
+			unsigned int a = (unsigned int)(edges[i] >> 32);
+			unsigned int b = (unsigned int)(edges[i] & 0xFFFFFFFF);
+
+			Quadric quadric = quadrics[a];
+			quadric.Add(quadrics[b]);
+
+			EdgeCollapse collapse;
+			collapse.source = 0;
+			collapse.target = 0;
+			collapse.cost = -1.0;
+			if(!locked[a])
+			{
+				collapse.source = a;
+				collapse.target = b;
+				collapse.cost = quadric.Evaluate(positions[b]);
+			}
+
+			if(!locked[b])
+			{
+				double cost = quadric.Evaluate(positions[a]);
+				if(collapse.cost < 0.0 || cost < collapse.cost)
+				{
+					collapse.source = b;
+					collapse.target = a;
+					collapse.cost = cost;
+				}
+			}
+
+			if(collapse.cost >= 0.0)
+			{
+				collapses.push_back(collapse);
+			}
+		}
+
+		//Stable, so edges that cost the same are collapsed in the same order every time.
+		std::stable_sort(collapses.begin(), collapses.end(), CompareCost);
+
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for(unsigned int i = 0; i < result.size(); i++)
+		{
+			adjacencyOffsets[result[i] + 1]++;
+		}
+		for(unsigned int i = 0; i < numVertices; i++)
+		{
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		}
+
+		adjacency.resize(result.size());
+		std::vector<unsigned int> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for(unsigned int i = 0; i < result.size(); i++)
+		{
+			adjacency[adjacencyFill[result[i]]++] = i / 3;
+		}
+
+		//Each collapse of an edge inside the mesh removes two triangles.
+		unsigned int trianglesToRemove = (unsigned int)(result.size() - targetNumIndices + 2) / 3;
+		unsigned int numRemoved = 0;
+		std::fill(touched.begin(), touched.end(), false);
+
+		for(unsigned int i = 0; i < collapses.size() && numRemoved < trianglesToRemove; i++)
+		{
+			const EdgeCollapse& collapse = collapses[i];
+			if(touched[collapse.source] || touched[collapse.target])
+			{
+				continue;
+			}
+
+			const unsigned int* triangles = &adjacency[adjacencyOffsets[collapse.source]];
+			unsigned int numTriangles = adjacencyOffsets[collapse.source + 1] - adjacencyOffsets[collapse.source];
+			if(CollapseFlipsTriangles(result, positions, triangles, numTriangles, collapse.source, collapse.target))
+			{
+				continue;
+			}
+
+			for(unsigned int j = 0; j < numTriangles; j++)
+			{
+				unsigned int* triangle = &result[triangles[j] * 3];
+				bool degenerate = false;
+				for(unsigned int k = 0; k < 3; k++)
+				{
+					touched[triangle[k]] = true;
+					degenerate = degenerate || triangle[k] == collapse.target;
+				}
+
+				for(unsigned int k = 0; k < 3; k++)
+				{
+					if(triangle[k] == collapse.source)
+					{
+						triangle[k] = collapse.target;
+					}
+				}
+
+				if(degenerate)
+				{
+					numRemoved++;
+				}
+			}
+
+			quadrics[collapse.target].Add(quadrics[collapse.source]);
+		}
+
+		if(numRemoved == 0)
+		{
+			break;
+		}
+
+		unsigned int numKept = 0;
+		for(unsigned int i = 0; i + 2 < result.size(); i += 3)
+		{
+			if(result[i] != result[i + 1] && result[i + 1] != result[i + 2] && result[i] != result[i + 2])
+			{
+				result[numKept++] = result[i];
+				result[numKept++] = result[i + 1];
+				result[numKept++] = result[i + 2];
+			}
+		}
+		result.resize(numKept);
+	}
+}
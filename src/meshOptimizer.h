@@ -0,0 +1,50 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "math3d.h"
+#include <vector>
+
+//Reorders a mesh's triangles and vertices so it's cheaper to draw, without changing what's
+//drawn. Everything here is deterministic, so the same mesh always comes out the same.
+namespace MeshOptimizer
+{
+	//The size of the FIFO post transform vertex cache triangles are ordered for, and measured
+	//with. Small enough to suit any GPU.
+	static const unsigned int CACHE_SIZE = 16;
+
+	//ACMR is the average number of vertices transformed per triangle, and ATVR the average
+	//number of times each vertex is transformed. 0.5 and 1 are the best possible.
+	struct CacheStats
+	{
+		float acmr;
+		float atvr;
+	};
+
+	//Simulates drawing the triangles with a FIFO cache of cacheSize vertices.
+	CacheStats CalcCacheStats(const std::vector<unsigned int>& indices, unsigned int numVertices, unsigned int cacheSize = CACHE_SIZE);
+
+	//Tipsify, from Sander, Nehab and Barczak's "Fast Triangle Reordering for Vertex Locality and
+	//Reduced Overdraw". Triangles are fanned around one vertex at a time, choosing the next from
+	//the ones just used that will still be in the cache. Where none are, the order jumps
+	//elsewhere, and a new cluster starts; the first triangle of each is added to clusterStarts.
+	void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int numVertices, std::vector<unsigned int>& clusterStarts);
+
+	//Sorts the clusters OptimizeVertexCache found so the ones facing out from the mesh's center
+	//come first, and are more likely to hide the others. Their insides stay in the same order.
+	void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vector3f>& positions, const std::vector<unsigned int>& clusterStarts);
+
+	//Renumbers the vertices in the order the triangles first use them, so they're read from
+	//memory in order. Vertices no triangle uses go at the end. remap is filled with where each
+	//vertex moves to.
+	void OptimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int numVertices, std::vector<unsigned int>& remap);
+
+	//Quadric error metric simplification, from Garland and Heckbert's "Surface Simplification
+	//Using Quadric Error Metrics". Edges are collapsed into whichever of their vertices moves the
+	//surface least, cheapest first, until there are at most targetNumIndices indices left. Only
+	//the original vertices are used, so they can be shared with the unsimplified mesh. Vertices
+	//on open edges, or split by UV seams or hard edges, never move, so nothing cracks open.
+	//result gets as close to targetNumIndices as it can without folding triangles over.
+	void Simplify(const std::vector<unsigned int>& indices, const std::vector<Vector3f>& positions, unsigned int targetNumIndices, std::vector<unsigned int>& result);
+};
+
+#endif // MESHOPTIMIZER_H
@@ -0,0 +1,330 @@
+#include "meshPool.h"
+#include "mesh.h"
+#include "packedVertex.h"
+#include "glState.h"
+#include "profiling.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+const unsigned int MeshPool::MIN_CAPACITIES[NUM_BUFFERS] = { 196608, 196608, 65536 };
+const GLsizeiptr MeshPool::ELEMENT_SIZES[NUM_BUFFERS] = { sizeof(uint16_t), sizeof(GLuint), sizeof(PackedVertex) };
+
+MeshPool::MeshPool() :
+	m_numAllocations(0)
+{
+	for(unsigned int i = 0; i < NUM_BUFFERS; i++)
+	{
+		m_buffers[i] = 0;
+		m_capacities[i] = 0;
+	}
+
+	for(unsigned int i = 0; i < NUM_VERTEX_ARRAYS; i++)
+	{
+		m_vertexArrays[i] = 0;
+		m_instanceBuffers[i] = 0;
+		m_firstInstances[i] = 0;
+	}
+}
+
+MeshPool::~MeshPool()
+{
+	//Nothing to do with GL here: the pool is static, and outlives the context. The buffers are
+	//deleted along with the last mesh.
+}
+
+MeshPoolRange MeshPool::Allocate(const IndexedModel& model)
+{
+	std::vector<PackedVertex> vertices;
+	VertexPacking::PackVertices(model, vertices);
+
+	MeshPoolRange range;
+	range.numVertices = (unsigned int)vertices.size();
+	range.numIndices = (unsigned int)model.GetIndices().size();
+	range.indexType = range.numVertices < VertexPacking::MAX_SHORT_INDEX_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	if(m_vertexArrays[0] == 0)
+	{
+		glGenVertexArrays(NUM_VERTEX_ARRAYS, m_vertexArrays);
+	}
+
+	range.baseVertex = AllocateElements(VERTEX_BUFFER, range.numVertices);
+	range.firstIndex = AllocateElements(GetVertexArray(range.indexType), range.numIndices);
+
+	if(range.numVertices > 0)
+	{
+		Upload(VERTEX_BUFFER, range.baseVertex, range.numVertices, &vertices[0]);
+	}
+
+	UploadIndices(range, model.GetIndices());
+
+	m_numAllocations++;
+	return range;
+}
+
+MeshPoolRange MeshPool::AllocateIndices(const MeshPoolRange& vertices, const std::vector<unsigned int>& indices)
+{
+	MeshPoolRange range;
+	range.baseVertex = vertices.baseVertex;
+	range.numIndices = (unsigned int)indices.size();
+	range.indexType = vertices.indexType;
+	range.firstIndex = AllocateElements(GetVertexArray(range.indexType), range.numIndices);
+
+	UploadIndices(range, indices);
+
+	m_numAllocations++;
+	return range;
+}
+
+void MeshPool::Free(const MeshPoolRange& range)
+{
+	assert(m_numAllocations > 0);
+
+	ReturnRange(m_freeRanges[VERTEX_BUFFER], range.baseVertex, range.numVertices);
+	ReturnRange(m_freeRanges[GetVertexArray(range.indexType)], range.firstIndex, range.numIndices);
+
+	m_numAllocations--;
+	if(m_numAllocations == 0)
+	{
+		Release();
+	}
+}
+
+void MeshPool::Bind(GLenum indexType) const
+{
+	GLState::BindVertexArray(m_vertexArrays[GetVertexArray(indexType)]);
+}
+
+void MeshPool::Draw(const MeshPoolRange& range) const
+{
+	RenderCounters::numDrawCalls++;
+	RenderCounters::numTriangles += range.numIndices / 3;
+
+	#if PROFILING_DISABLE_MESH_DRAWING == 0
+		glDrawElementsBaseVertex(GL_TRIANGLES, range.numIndices, range.indexType,
+			(const GLvoid*)(range.firstIndex * ELEMENT_SIZES[GetVertexArray(range.indexType)]), range.baseVertex);
+	#endif
+}
+
+void MeshPool::DrawInstanced(const MeshPoolRange& range, GLuint instanceBuffer, unsigned int firstInstance, int numInstances) const
+{
+	SetInstanceBuffer(GetVertexArray(range.indexType), instanceBuffer, firstInstance);
+	RenderCounters::numDrawCalls++;
+	RenderCounters::numTriangles += range.numIndices / 3 * numInstances;
+
+	#if PROFILING_DISABLE_MESH_DRAWING == 0
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.numIndices, range.indexType,
+			(const GLvoid*)(range.firstIndex * ELEMENT_SIZES[GetVertexArray(range.indexType)]), numInstances, range.baseVertex);
+	#endif
+}
+
+void MeshPool::MultiDrawIndirect(GLenum indexType, GLuint instanceBuffer, unsigned int firstCommand, int numCommands) const
+{
+	SetInstanceBuffer(GetVertexArray(indexType), instanceBuffer, 0);
+	RenderCounters::numDrawCalls++;
+
+	#if PROFILING_DISABLE_MESH_DRAWING == 0
+		glMultiDrawElementsIndirect(GL_TRIANGLES, indexType,
+			(const GLvoid*)(firstCommand * sizeof(DrawElementsIndirectCommand)), numCommands, 0);
+	#endif
+}
+
+bool MeshPool::IsMultiDrawIndirectSupported()
+{
+	//Without base instances, every command would read the same model matrices.
+	return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+}
+
+void MeshPool::Release()
+{
+	for(unsigned int i = 0; i < NUM_VERTEX_ARRAYS; i++)
+	{
+		GLState::DeleteVertexArray(m_vertexArrays[i]);
+		m_vertexArrays[i] = 0;
+		m_instanceBuffers[i] = 0;
+		m_firstInstances[i] = 0;
+	}
+
+	glDeleteBuffers(NUM_BUFFERS, m_buffers);
+	for(unsigned int i = 0; i < NUM_BUFFERS; i++)
+	{
+		m_buffers[i] = 0;
+		m_capacities[i] = 0;
+		m_freeRanges[i].clear();
+	}
+}
+
+void MeshPool::Resize(int buffer, unsigned int capacity)
+{
+	GLuint newBuffer;
+	glGenBuffers(1, &newBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, capacity * ELEMENT_SIZES[buffer], 0, GL_STATIC_DRAW);
+
+	if(m_buffers[buffer] != 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, m_buffers[buffer]);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, m_capacities[buffer] * ELEMENT_SIZES[buffer]);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &m_buffers[buffer]);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	ReturnRange(m_freeRanges[buffer], m_capacities[buffer], capacity - m_capacities[buffer]);
+	m_buffers[buffer] = newBuffer;
+	m_capacities[buffer] = capacity;
+	SetVertexAttributes();
+}
+
+void MeshPool::SetVertexAttributes()
+{
+	GLsizei stride = sizeof(PackedVertex);
+
+	for(unsigned int i = 0; i < NUM_VERTEX_ARRAYS; i++)
+	{
+		GLState::BindVertexArray(m_vertexArrays[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, m_buffers[VERTEX_BUFFER]);
+
+		for(GLuint j = 0; j < 4; j++)
+		{
+			glEnableVertexAttribArray(j);
+		}
+
+		//The normal and tangent have 4 components, the last of which the shaders ignore.
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(PackedVertex, position));
+		glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, (const GLvoid*)offsetof(PackedVertex, texCoord));
+		glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (const GLvoid*)offsetof(PackedVertex, normal));
+		glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (const GLvoid*)offsetof(PackedVertex, tangent));
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffers[i]);
+	}
+}
+
+void MeshPool::SetInstanceBuffer(int vertexArray, GLuint instanceBuffer, unsigned int firstInstance) const
+{
+	//The vertex array remembers where the matrices come from, so this only has to be set up
+	//again if that changes.
+	if(m_instanceBuffers[vertexArray] == instanceBuffer && m_firstInstances[vertexArray] == firstInstance)
+	{
+		return;
+	}
+
+	GLState::BindVertexArray(m_vertexArrays[vertexArray]);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(INSTANCE_MODEL_ATTRIBUTE + i);
+		glVertexAttribPointer(INSTANCE_MODEL_ATTRIBUTE + i, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4f),
+			(const GLvoid*)(sizeof(Matrix4f) * firstInstance + sizeof(float) * 4 * i));
+		glVertexAttribDivisor(INSTANCE_MODEL_ATTRIBUTE + i, 1);
+	}
+
+	m_instanceBuffers[vertexArray] = instanceBuffer;
+	m_firstInstances[vertexArray] = firstInstance;
+}
+
+unsigned int MeshPool::AllocateElements(int buffer, unsigned int size)
+{
+	unsigned int offset;
+	while(!AllocateRange(m_freeRanges[buffer], size, offset))
+	{
+		unsigned int capacity = m_capacities[buffer];
+		Resize(buffer, std::max(std::max(capacity * 2, capacity + size), MIN_CAPACITIES[buffer]));
+	}
+	return offset;
+}
+
+void MeshPool::Upload(int buffer, unsigned int offset, unsigned int size, const void* data)
+{
+	//Through the copy target, since the element array binding belongs to whatever vertex array
+	//is bound.
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffers[buffer]);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset * ELEMENT_SIZES[buffer], size * ELEMENT_SIZES[buffer], data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void MeshPool::UploadIndices(const MeshPoolRange& range, const std::vector<unsigned int>& indices)
+{
+	if(range.numIndices == 0)
+	{
+		return;
+	}
+
+	if(range.indexType == GL_UNSIGNED_SHORT)
+	{
+		std::vector<uint16_t> shortIndices;
+		VertexPacking::PackShortIndices(indices, shortIndices);
+		Upload(SHORT_INDEX_BUFFER, range.firstIndex, range.numIndices, &shortIndices[0]);
+	}
+	else
+	{
+		Upload(INT_INDEX_BUFFER, range.firstIndex, range.numIndices, &indices[0]);
+	}
+}
+
+bool MeshPool::AllocateRange(std::vector<FreeRange>& freeRanges, unsigned int size, unsigned int& offset)
+{
+	if(size == 0)
+	{
+		offset = 0;
+		return true;
+	}
+
+	for(unsigned int i = 0; i < freeRanges.size(); i++)
+	{
+		if(freeRanges[i].size >= size)
+		{
+			offset = freeRanges[i].offset;
+			freeRanges[i].offset += size;
+			freeRanges[i].size -= size;
+
+			if(freeRanges[i].size == 0)
+			{
+				freeRanges.erase(freeRanges.begin() + i);
+			}
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void MeshPool::ReturnRange(std::vector<FreeRange>& freeRanges, unsigned int offset, unsigned int size)
+{
+	if(size == 0)
+	{
+		return;
+	}
+
+	//Merged with the free ranges on either side, if it touches them.
+	unsigned int i = 0;
+	while(i < freeRanges.size() && freeRanges[i].offset < offset)
+	{
+		i++;
+	}
+
+	bool mergesBefore = i > 0 && freeRanges[i - 1].offset + freeRanges[i - 1].size == offset;
+	bool mergesAfter = i < freeRanges.size() && offset + size == freeRanges[i].offset;
+
+	if(mergesBefore && mergesAfter)
+	{
+		freeRanges[i - 1].size += size + freeRanges[i].size;
+		freeRanges.erase(freeRanges.begin() + i);
+	}
+	else if(mergesBefore)
+	{
+		freeRanges[i - 1].size += size;
+	}
+	else if(mergesAfter)
+	{
+		freeRanges[i].offset = offset;
+		freeRanges[i].size += size;
+	}
+	else
+	{
+		FreeRange range;
+		range.offset = offset;
+		range.size = size;
+		freeRanges.insert(freeRanges.begin() + i, range);
+	}
+}
@@ -0,0 +1,125 @@
+#ifndef MESHPOOL_H
+#define MESHPOOL_H
+
+#include <GL/glew.h>
+#include <vector>
+class IndexedModel;
+
+//Where a mesh's vertices and indices are in the pool. Indices are relative to baseVertex, and
+//firstIndex counts indices of the mesh's indexType. Ranges that share another range's vertices,
+//like a mesh's LODs, have no vertices of their own.
+struct MeshPoolRange
+{
+	MeshPoolRange() :
+		baseVertex(0),
+		numVertices(0),
+		firstIndex(0),
+		numIndices(0),
+		indexType(GL_UNSIGNED_INT) {}
+
+	unsigned int baseVertex;
+	unsigned int numVertices;
+	unsigned int firstIndex;
+	unsigned int numIndices;
+	GLenum       indexType; //GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+};
+
+//One draw, in the layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER.
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint  baseVertex;
+	GLuint baseInstance;
+};
+
+//Every mesh's vertices and indices, suballocated from one buffer of interleaved PackedVertex
+//vertices, and one index buffer per index size, each with a vertex array. Meshes with fewer
+//than 65536 vertices get 16 bit indices. Drawing a different mesh with the same index size only
+//changes the offsets given to the draw, so draws of different meshes can be submitted together.
+//
+//The buffers are created with the first mesh, grow by copying to a larger buffer when they're
+//full, and are deleted when the last mesh is freed, so the pool never outlives the GL context.
+class MeshPool
+{
+public:
+	MeshPool();
+	virtual ~MeshPool();
+
+	//Packs model's vertices and indices into the pool. model has to be valid.
+	MeshPoolRange Allocate(const IndexedModel& model);
+	//Adds another set of indices for the vertices of a range that's already allocated. The range
+	//returned only owns the indices, so each has to be freed as well.
+	MeshPoolRange AllocateIndices(const MeshPoolRange& vertices, const std::vector<unsigned int>& indices);
+	void Free(const MeshPoolRange& range);
+
+	//The draws all need the pool to be bound for the index type they draw.
+	void Bind(GLenum indexType) const;
+	void Draw(const MeshPoolRange& range) const;
+	//Draws numInstances copies of range. Each reads it's model matrix from instanceBuffer, as
+	//attributes 4 to 7, starting with the matrix at firstInstance.
+	void DrawInstanced(const MeshPoolRange& range, GLuint instanceBuffer, unsigned int firstInstance, int numInstances) const;
+	//Draws numCommands commands at once, starting with firstCommand in the bound
+	//GL_DRAW_INDIRECT_BUFFER, which all have to be for meshes of indexType. Each command's
+	//baseInstance picks the first of it's model matrices in instanceBuffer. Only if multi draw
+	//indirect is supported.
+	void MultiDrawIndirect(GLenum indexType, GLuint instanceBuffer, unsigned int firstCommand, int numCommands) const;
+
+	//glMultiDrawElementsIndirect, and base instances to take the place of per draw data.
+	static bool IsMultiDrawIndirectSupported();
+
+	inline unsigned int GetVertexCapacity() const { return m_capacities[VERTEX_BUFFER]; }
+protected:
+private:
+	struct FreeRange
+	{
+		unsigned int offset;
+		unsigned int size;
+	};
+
+	//The index buffers are in the same order as the vertex arrays.
+	enum
+	{
+		SHORT_INDEX_BUFFER,
+		INT_INDEX_BUFFER,
+		VERTEX_BUFFER,
+
+		NUM_BUFFERS,
+		NUM_VERTEX_ARRAYS = VERTEX_BUFFER
+	};
+
+	//Follows the position, texCoord, normal and tangent attributes. A mat4 takes 4 slots.
+	static const GLuint INSTANCE_MODEL_ATTRIBUTE = 4;
+	static const unsigned int MIN_CAPACITIES[NUM_BUFFERS];
+	static const GLsizeiptr ELEMENT_SIZES[NUM_BUFFERS];
+
+	GLuint                 m_vertexArrays[NUM_VERTEX_ARRAYS];
+	GLuint                 m_buffers[NUM_BUFFERS];
+	unsigned int           m_capacities[NUM_BUFFERS];   //In elements
+	std::vector<FreeRange> m_freeRanges[NUM_BUFFERS];   //Sorted by offset, and never next to each other
+	unsigned int           m_numAllocations;
+	mutable GLuint         m_instanceBuffers[NUM_VERTEX_ARRAYS]; //What each vertex array's per instance model matrices are read from
+	mutable unsigned int   m_firstInstances[NUM_VERTEX_ARRAYS];
+
+	static inline int GetVertexArray(GLenum indexType) { return indexType == GL_UNSIGNED_SHORT ? SHORT_INDEX_BUFFER : INT_INDEX_BUFFER; }
+
+	void Release();
+	//Grows a buffer, keeping what's in it.
+	void Resize(int buffer, unsigned int capacity);
+	void SetVertexAttributes();
+	void SetInstanceBuffer(int vertexArray, GLuint instanceBuffer, unsigned int firstInstance) const;
+	//Finds room for size elements in a buffer, growing it if there isn't any.
+	unsigned int AllocateElements(int buffer, unsigned int size);
+	void Upload(int buffer, unsigned int offset, unsigned int size, const void* data);
+	void UploadIndices(const MeshPoolRange& range, const std::vector<unsigned int>& indices);
+
+	//First fit. Returns false if there's no free range big enough.
+	static bool AllocateRange(std::vector<FreeRange>& freeRanges, unsigned int size, unsigned int& offset);
+	static void ReturnRange(std::vector<FreeRange>& freeRanges, unsigned int offset, unsigned int size);
+
+	MeshPool(const MeshPool& other) {}
+	void operator=(const MeshPool& other) {}
+};
+
+#endif // MESHPOOL_H
@@ -0,0 +1,13 @@
+#include "meshRenderer.h"
+#include "coreEngine.h"
+#include "renderingEngine.h"
+
+void MeshRenderer::AddToEngine(CoreEngine* engine) const
+{
+	engine->GetRenderingEngine()->AddMeshRenderer(*this);
+}
+
+void MeshRenderer::RemoveFromEngine(CoreEngine* engine) const
+{
+	engine->GetRenderingEngine()->RemoveMeshRenderer(*this);
+}
@@ -2,25 +2,51 @@
 #define MESHRENDERER_H_INCLUDED
 
 #include "entityComponent.h"
+#include "material.h"
 #include "mesh.h"
+#include "shader.h"
+#include "sceneFile.h"
 
 class MeshRenderer : public EntityComponent
 {
 public:
 	MeshRenderer(const Mesh& mesh, const Material& material) :
 		m_mesh(mesh),
-		m_material(material) {}
+		m_material(material),
+		m_renderingEngineIndex(0),
+		m_lod(0) {}
 
-	virtual void Render(const Shader& shader, const RenderingEngine& renderingEngine, const Camera& camera) const
+	//Mesh renderers are drawn by the rendering engine, which culls them first, rather than
+	//through Entity::RenderAll.
+	virtual void AddToEngine(CoreEngine* engine) const;
+	virtual void RemoveFromEngine(CoreEngine* engine) const;
+	
+	void Draw(const Shader& shader, const RenderingEngine& renderingEngine, const Camera& camera) const
 	{
 		shader.Bind();
 		shader.UpdateUniforms(GetTransform(), m_material, renderingEngine, camera);
-		m_mesh.Draw();
+		m_mesh.Draw(m_lod);
+	}
+	
+	inline const Mesh& GetMesh()         const { return m_mesh; }
+	inline const Material& GetMaterial() const { return m_material; }
+	//Chosen by the rendering engine from how big the mesh is on screen.
+	inline unsigned int GetLod()         const { return m_lod; }
+	
+	virtual const char* GetSceneTypeName() const { return "MeshRenderer"; }
+	virtual void WriteToScene(SceneComponentWriter& writer) const
+	{
+		writer.WriteString(m_mesh.GetName());
+		writer.WriteString(m_material.GetName());
 	}
 protected:
 private:
+	friend class RenderingEngine;
+	
 	Mesh m_mesh;
 	Material m_material;
+	mutable unsigned int m_renderingEngineIndex; //Where it is in the rendering engine's list, so it can be removed quickly
+	mutable unsigned int m_lod;                  //Which of the mesh's LODs is drawn, kept between frames for hysteresis
 };
 
 #endif // MESHRENDERER_H_INCLUDED
@@ -0,0 +1,144 @@
+#include "packedVertex.h"
+#include "mesh.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+void VertexPacking::PackVertices(const IndexedModel& model, std::vector<PackedVertex>& vertices)
+{
+	assert(model.IsValid());
+
+	const std::vector<Vector3f>& positions = model.GetPositions();
+	const std::vector<Vector2f>& texCoords = model.GetTexCoords();
+	const std::vector<Vector3f>& normals = model.GetNormals();
+	const std::vector<Vector3f>& tangents = model.GetTangents();
+
+	vertices.resize(positions.size());
+	for(unsigned int i = 0; i < positions.size(); i++)
+	{
+		PackedVertex& vertex = vertices[i];
+		vertex.position[0] = positions[i].GetX();
+		vertex.position[1] = positions[i].GetY();
+		vertex.position[2] = positions[i].GetZ();
+		vertex.texCoord[0] = FloatToHalf(texCoords[i].GetX());
+		vertex.texCoord[1] = FloatToHalf(texCoords[i].GetY());
+		vertex.normal = PackSnorm1010102(normals[i]);
+		vertex.tangent = PackSnorm1010102(tangents[i]);
+	}
+}
+
+void VertexPacking::PackShortIndices(const std::vector<unsigned int>& indices, std::vector<uint16_t>& shortIndices)
+{
+	shortIndices.resize(indices.size());
+	for(unsigned int i = 0; i < indices.size(); i++)
+	{
+		assert(indices[i] < MAX_SHORT_INDEX_VERTICES);
+		shortIndices[i] = (uint16_t)indices[i];
+	}
+}
+
+uint16_t VertexPacking::FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t floatExponent = (bits >> 23) & 0xFF;
+	uint32_t mantissa = bits & 0x7FFFFF;
+	int exponent = (int)floatExponent - 127 + 15;
+
+	if(floatExponent == 0xFF)
+	{
+		//Infinity stays infinity, and NaN stays NaN.
+		return (uint16_t)(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+	}
+
+	if(exponent >= 31)
+	{
+		return (uint16_t)(sign | 0x7C00);
+	}
+
+	if(exponent <= 0)
+	{
+		//Too small for a normal half float, so it's denormal, or rounds to 0.
+		if(exponent < -10)
+		{
+			return (uint16_t)sign;
+		}
+
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+
+		if(remainder > halfway || (remainder == halfway && (half & 1)))
+		{
+			half++;
+		}
+		return (uint16_t)(sign | half);
+	}
+
+	//Rounding up can carry into the exponent, which is still the right result, up to infinity.
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1FFF;
+	if(remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+	{
+		half++;
+	}
+	return (uint16_t)half;
+}
+
+float VertexPacking::HalfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	uint32_t bits;
+
+	if(exponent == 0)
+	{
+		float value = ldexpf((float)mantissa, -24);
+		return sign != 0 ? -value : value;
+	}
+	else if(exponent == 31)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+uint32_t VertexPacking::PackSnorm1010102(const Vector3f& vector)
+{
+	int x = (int)roundf(Clamp(vector.GetX(), -1.0f, 1.0f) * 511.0f);
+	int y = (int)roundf(Clamp(vector.GetY(), -1.0f, 1.0f) * 511.0f);
+	int z = (int)roundf(Clamp(vector.GetZ(), -1.0f, 1.0f) * 511.0f);
+
+	return ((uint32_t)x & 0x3FF) | (((uint32_t)y & 0x3FF) << 10) | (((uint32_t)z & 0x3FF) << 20);
+}
+
+Vector3f VertexPacking::UnpackSnorm1010102(uint32_t packed)
+{
+	float components[3];
+	for(int i = 0; i < 3; i++)
+	{
+		int component = (int)((packed >> (i * 10)) & 0x3FF);
+		if(component >= 512)
+		{
+			component -= 1024;
+		}
+
+		//The way GL 4.2 and later unpack it, so -512 and -511 are both -1.
+		components[i] = std::max((float)component / 511.0f, -1.0f);
+	}
+
+	return Vector3f(components[0], components[1], components[2]);
+}
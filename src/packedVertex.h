@@ -0,0 +1,39 @@
+#ifndef PACKEDVERTEX_H
+#define PACKEDVERTEX_H
+
+#include "math3d.h"
+#include <stdint.h>
+#include <vector>
+class IndexedModel;
+
+//A vertex as the mesh pool stores it, interleaved, in 24 bytes rather than the 44 of four
+//separate float attributes:
+// - Position: three floats, since meshes can be big enough that anything smaller shows.
+// - Texture coordinates: two half floats.
+// - Normal and tangent: signed, normalized 10_10_10_2, with the 2 bit w left at 0.
+struct PackedVertex
+{
+	float    position[3];
+	uint16_t texCoord[2];
+	uint32_t normal;
+	uint32_t tangent;
+};
+
+namespace VertexPacking
+{
+	//Models with fewer vertices than this have their indices packed into 16 bits.
+	static const unsigned int MAX_SHORT_INDEX_VERTICES = 65536;
+
+	//Packs every vertex of model, which has to be valid, into vertices.
+	void PackVertices(const IndexedModel& model, std::vector<PackedVertex>& vertices);
+	void PackShortIndices(const std::vector<unsigned int>& indices, std::vector<uint16_t>& shortIndices);
+
+	//Rounded to the nearest half float. Values too big for one become infinity.
+	uint16_t FloatToHalf(float value);
+	float HalfToFloat(uint16_t half);
+	//Each component is clamped to [-1, 1].
+	uint32_t PackSnorm1010102(const Vector3f& vector);
+	Vector3f UnpackSnorm1010102(uint32_t packed);
+};
+
+#endif // PACKEDVERTEX_H
@@ -43,3 +43,41 @@ double ProfileTimer::DisplayAndReset(const std::string& message, double divisor,
 	std::cout << message << whiteSpace << time << " ms" << std::endl;
 	return time;
 }
+
+namespace RenderCounters
+{
+	unsigned int numProgramBinds = 0;
+	unsigned int numTextureBinds = 0;
+	unsigned int numVertexArrayBinds = 0;
+	unsigned int numDrawCalls = 0;
+	unsigned int numTriangles = 0;
+	unsigned int numStateChanges = 0;
+	unsigned int numRedundantStateChanges = 0;
+	double       uniformUpdateTime = 0.0;
+}
+
+void RenderCounters::DisplayAndReset(double dividend)
+{
+	std::cout << "Binds Per Frame:                        " 
+		<< numProgramBinds/dividend << " programs, " 
+		<< numTextureBinds/dividend << " textures, " 
+		<< numVertexArrayBinds/dividend << " vertex arrays, " 
+		<< numDrawCalls/dividend << " draws" << std::endl;
+	std::cout << "Triangles Per Frame:                    " 
+		<< numTriangles/dividend << std::endl;
+	std::cout << "State Changes Per Frame:                " 
+		<< numStateChanges/dividend << " issued, " 
+		<< numRedundantStateChanges/dividend << " redundant" << std::endl;
+	std::cout << "Uniform Update Time:                    " 
+		<< (1000.0 * uniformUpdateTime)/dividend << " ms, " 
+		<< (numDrawCalls == 0 ? 0.0 : (1000000.0 * uniformUpdateTime)/numDrawCalls) << " us per draw" << std::endl;
+	
+	numProgramBinds = 0;
+	numTextureBinds = 0;
+	numVertexArrayBinds = 0;
+	numDrawCalls = 0;
+	numTriangles = 0;
+	numStateChanges = 0;
+	numRedundantStateChanges = 0;
+	uniformUpdateTime = 0.0;
+}
@@ -7,6 +7,7 @@
 #define PROFILING_DISABLE_SHADING 0
 #define PROFILING_SET_1x1_VIEWPORT 0
 #define PROFILING_SET_2x2_TEXTURE 0
+#define PROFILING_RUN_BENCHMARKS 0
 
 class ProfileTimer
 {
@@ -28,4 +29,21 @@ private:
 	double m_startTime;
 };
 
+//Counts the GL state changes and draws the renderer issues, to see how well draws are batched.
+//The binds only count the ones that reached GL, see GLState.
+namespace RenderCounters
+{
+	extern unsigned int numProgramBinds;
+	extern unsigned int numTextureBinds;
+	extern unsigned int numVertexArrayBinds;
+	extern unsigned int numDrawCalls;
+	extern unsigned int numTriangles;
+	extern unsigned int numStateChanges;          //Issued to GL
+	extern unsigned int numRedundantStateChanges; //Filtered out, since GL already had that state
+	extern double       uniformUpdateTime;        //CPU time spent in Shader::Update*Uniforms, in seconds
+	
+	//Displays the counts per dividend frames, then resets them.
+	void DisplayAndReset(double dividend);
+};
+
 #endif // PROFILING_H_INCLUDED
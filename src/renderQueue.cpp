@@ -0,0 +1,86 @@
+#include "renderQueue.h"
+#include <cstring>
+
+uint64_t RenderQueue::MakeKey(unsigned int pass, unsigned int shaderId, unsigned int materialId, unsigned int meshId, unsigned int lod, float depth)
+{
+	//The bits of a positive float sort the same way as the float itself, so the top 16 of them
+	//are a depth with roughly constant relative precision. Anything behind the camera sorts first.
+	uint32_t depthBits = 0;
+	if(depth > 0.0f)
+	{
+		memcpy(&depthBits, &depth, sizeof(depthBits));
+	}
+
+	return ((uint64_t)(pass & 0xF) << 60)
+		| ((uint64_t)(shaderId & 0xFFF) << 48)
+		| ((uint64_t)(materialId & 0xFFFF) << 32)
+		| ((uint64_t)(meshId & 0x3FFF) << 18)
+		| ((uint64_t)(lod & 0x3) << 16)
+		| (uint64_t)(depthBits >> 16);
+}
+
+void RenderQueue::Sort()
+{
+	static const unsigned int RADIX_BITS = 8;
+	static const unsigned int RADIX_SIZE = 1 << RADIX_BITS;
+	static const unsigned int NUM_DIGITS = 64 / RADIX_BITS;
+
+	unsigned int count = (unsigned int)m_packets.size();
+	if(count < 2)
+	{
+		return;
+	}
+
+	m_sortBuffer.resize(count);
+
+	//All histograms are built in one pass over the keys.
+	unsigned int histograms[NUM_DIGITS][RADIX_SIZE];
+	memset(histograms, 0, sizeof(histograms));
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		uint64_t key = m_packets[i].key;
+		for(unsigned int digit = 0; digit < NUM_DIGITS; digit++)
+		{
+			histograms[digit][(key >> (digit * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+		}
+	}
+
+	DrawPacket* source = &m_packets[0];
+	DrawPacket* dest = &m_sortBuffer[0];
+
+	for(unsigned int digit = 0; digit < NUM_DIGITS; digit++)
+	{
+		unsigned int* histogram = histograms[digit];
+		unsigned int shift = digit * RADIX_BITS;
+
+		//Most digits are the same for every packet in a pass, like the pass and shader, and
+		//don't need a scatter.
+		if(histogram[(source[0].key >> shift) & (RADIX_SIZE - 1)] == count)
+		{
+			continue;
+		}
+
+		unsigned int offset = 0;
+		for(unsigned int i = 0; i < RADIX_SIZE; i++)
+		{
+			unsigned int bucketSize = histogram[i];
+			histogram[i] = offset;
+			offset += bucketSize;
+		}
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			dest[histogram[(source[i].key >> shift) & (RADIX_SIZE - 1)]++] = source[i];
+		}
+
+		DrawPacket* temp = source;
+		source = dest;
+		dest = temp;
+	}
+
+	if(source != &m_packets[0])
+	{
+		m_packets.swap(m_sortBuffer);
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <stdint.h>
+#include <vector>
+
+class MeshRenderer;
+
+//One draw, reduced to what's needed to order it. The key is built so that sorting by it groups
+//draws by everything that's expensive to change, most expensive first.
+struct DrawPacket
+{
+	uint64_t            key;
+	const MeshRenderer* meshRenderer;
+};
+
+//Collects the draws of a pass, and sorts them so they can be submitted with as few state
+//changes as possible.
+class RenderQueue
+{
+public:
+	//From the most significant bits down:
+	//  pass     4 bits
+	//  shader   12 bits
+	//  material 16 bits
+	//  mesh     14 bits
+	//  LOD      2 bits
+	//  depth    16 bits
+	//Ids wider than their field are truncated; draws with ids that collide are still drawn
+	//correctly, they just don't end up next to each other.
+	static uint64_t MakeKey(unsigned int pass, unsigned int shaderId, unsigned int materialId, unsigned int meshId, unsigned int lod, float depth);
+
+	RenderQueue() {}
+
+	inline void Clear() { m_packets.clear(); }
+	inline void Add(uint64_t key, const MeshRenderer* meshRenderer)
+	{
+		DrawPacket packet;
+		packet.key = key;
+		packet.meshRenderer = meshRenderer;
+		m_packets.push_back(packet);
+	}
+
+	//Radix sort on the keys. Draws with the same key keep the order they were added in.
+	void Sort();
+
+	inline unsigned int GetSize()                        const { return (unsigned int)m_packets.size(); }
+	inline const DrawPacket& GetPacket(unsigned int index) const { return m_packets[index]; }
+protected:
+private:
+	std::vector<DrawPacket> m_packets;
+	std::vector<DrawPacket> m_sortBuffer;
+
+	RenderQueue(const RenderQueue& other) {}
+	void operator=(const RenderQueue& other) {}
+};
+
+#endif // RENDERQUEUE_H
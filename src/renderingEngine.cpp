@@ -4,8 +4,21 @@
 #include "shader.h"
 #include <GL/glew.h>
 #include "mesh.h"
+#include "meshRenderer.h"
+#include "frustum.h"
+#include "jobSystem.h"
+#include "glState.h"
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 
+const float RenderingEngine::EVSM_EXPONENT = 5.54f;
+const float RenderingEngine::LOD_SCREEN_SIZE = 0.5f;
+const float RenderingEngine::LOD_HYSTERESIS = 0.15f;
 const Matrix4f RenderingEngine::BIAS_MATRIX = Matrix4f().InitScale(Vector3f(0.5, 0.5, 0.5)) * Matrix4f().InitTranslation(Vector3f(1.0, 1.0, 1.0));
 //Should construct a Matrix like this:
 //     x   y   z   w
@@ -19,23 +32,61 @@ const Matrix4f RenderingEngine::BIAS_MATRIX = Matrix4f().InitScale(Vector3f(0.5,
 //
 //This matrix will convert 3D coordinates from the range (-1, 1) to the range (0, 1).
 
-RenderingEngine::RenderingEngine(const Window& window) :
+RenderingEngine::RenderingEngine(const Window& window, RenderPath renderPath) :
 	m_plane(Mesh("plane.obj")),
+	m_sphereVolume("renderingEngine_sphereVolume", CreateSphereVolume(16, 8)),
+	m_coneVolume("renderingEngine_coneVolume", CreateConeVolume(16)),
 	m_window(&window),
 	m_tempTarget(window.GetWidth(), window.GetHeight(), 0, GL_TEXTURE_2D, GL_NEAREST, GL_RGBA, GL_RGBA, false, GL_COLOR_ATTACHMENT0),
 	m_planeMaterial("renderingEngine_filterPlane", m_tempTarget, 1, 8),
+	m_shadowAtlas(SHADOW_ATLAS_SIZE, MIN_SHADOW_MAP_SIZE),
+	m_numShadowViews(0),
+	m_exponentialShadows(true),
 	m_defaultShader("forward-ambient"),
 	m_shadowMapShader("shadowMapGenerator"),
 	m_nullFilter("filter-null"),
 	m_gausBlurFilter("filter-gausBlur7x1"),
 	m_fxaaFilter("filter-fxaa"),
+	m_renderPath(renderPath),
+	m_lightClusters(0),
 	m_altCameraTransform(Vector3f(0,0,0), Quaternion(Vector3f(0,1,0),ToRadians(180.0f))),
-	m_altCamera(Matrix4f().InitIdentity(), &m_altCameraTransform)
+	m_altCamera(Matrix4f().InitIdentity(), &m_altCameraTransform),
+	m_mainCamera(0),
+	m_activeLight(0),
+	m_jobSystem(0),
+	m_meshRenderersVersion(0),
+	m_numVisibleMeshRenderers(0),
+	m_numCulledMeshRenderers(0),
+	m_numDrawnLights(0),
+	m_numSkippedLights(0),
+	m_numLitMeshRenderers(0),
+	m_numClusteredLights(0),
+	m_numClusterLightIndices(0),
+	m_numShadowMapsRendered(0),
+	m_numShadowMapsCached(0),
+	m_numShadowCasters(0),
+	m_numCulledShadowCasters(0),
+	m_frameIndex(0),
+	m_shadowCastersVersion(0),
+	m_shadowCastersChanged(true),
+	m_sortDrawCalls(true),
+	m_instancing(false),
+	m_instancingSupported(false),
+	m_instanceBuffer(0),
+	m_multiDrawIndirectSupported(false),
+	m_drawIndirectBuffer(0)
 {
 	SetSamplerSlot("diffuse",   0);
 	SetSamplerSlot("normalMap", 1);
 	SetSamplerSlot("dispMap",   2);
 	SetSamplerSlot("shadowMap", 3);
+	SetSamplerSlot("gBufferAlbedo",   4);
+	SetSamplerSlot("gBufferNormal",   5);
+	SetSamplerSlot("gBufferSpecular", 6);
+	SetSamplerSlot("gBufferDepth",    7);
+	SetSamplerSlot("clusterLightData",    8);
+	SetSamplerSlot("clusters",            9);
+	SetSamplerSlot("clusterLightIndices", 10);
 	
 	SetSamplerSlot("filterTexture", 0);
 	
@@ -45,15 +96,44 @@ RenderingEngine::RenderingEngine(const Window& window) :
 	SetFloat("fxaaReduceMin", 1.0f/128.0f);
 	SetFloat("fxaaReduceMul", 1.0f/8.0f);
 	SetFloat("fxaaAspectDistortion", 150.0f);
+	SetFloat("lightVolumeWidth", 1.0f);
 
 	SetTexture("displayTexture", Texture(m_window->GetWidth(), m_window->GetHeight(), 0, GL_TEXTURE_2D, GL_LINEAR, GL_RGBA, GL_RGBA, true, GL_COLOR_ATTACHMENT0));
+	
+	if(m_renderPath == RENDER_PATH_DEFERRED)
+	{
+		//Normals need more precision than 8 bits, and specular powers can be larger than 1.
+		GLenum internalFormats[] = { GL_RGBA8, GL_RGBA16F, GL_RG16F, GL_DEPTH_COMPONENT24 };
+		GLenum formats[] = { GL_RGBA, GL_RGBA, GL_RG, GL_DEPTH_COMPONENT };
+		GLenum attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_DEPTH_ATTACHMENT };
+		
+		m_gBuffer = Texture(m_window->GetWidth(), m_window->GetHeight(), 4, internalFormats, formats, attachments);
+		SetTexture("gBufferAlbedo",   Texture(m_gBuffer, 0));
+		SetTexture("gBufferNormal",   Texture(m_gBuffer, 1));
+		SetTexture("gBufferSpecular", Texture(m_gBuffer, 2));
+		SetTexture("gBufferDepth",    Texture(m_gBuffer, 3));
+	}
+	
+	//Buffer textures are core in 3.1.
+	if(m_renderPath == RENDER_PATH_CLUSTERED && !GLEW_VERSION_3_1)
+	{
+		m_renderPath = RENDER_PATH_FORWARD;
+	}
+	
+	if(m_renderPath == RENDER_PATH_CLUSTERED)
+	{
+		m_lightClusters = new LightClusters();
+		SetTexture("clusterLightData",    m_lightClusters->GetLightDataTexture());
+		SetTexture("clusters",            m_lightClusters->GetClusterTexture());
+		SetTexture("clusterLightIndices", m_lightClusters->GetLightIndexTexture());
+	}
 
 	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
-	glFrontFace(GL_CW);
-	glCullFace(GL_BACK);
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_DEPTH_TEST);
+	GLState::FrontFace(GL_CW);
+	GLState::CullFace(GL_BACK);
+	GLState::Enable(GL_CULL_FACE);
+	GLState::Enable(GL_DEPTH_TEST);
 	//glEnable(GL_DEPTH_CLAMP);
 	//glEnable(GL_MULTISAMPLE);
 	//glEnable(GL_FRAMEBUFFER_SRGB);
@@ -63,161 +143,1532 @@ RenderingEngine::RenderingEngine(const Window& window) :
 	m_planeTransform.Rotate(Quaternion(Vector3f(1,0,0), ToRadians(90.0f)));
 	m_planeTransform.Rotate(Quaternion(Vector3f(0,0,1), ToRadians(180.0f)));
 	
-	for(int i = 0; i < NUM_SHADOW_MAPS; i++)
+	CreateShadowAtlas();
+	m_shadowAtlasRegion = Vector4f(0.0f, 0.0f, 1.0f, 1.0f);
+	SetFloat("shadowExponent", EVSM_EXPONENT);
+	
+	//Always a variance shadow map, cleared to the furthest depth, so nothing is in shadow.
+	m_emptyShadowMap = Texture(2, 2, 0, GL_TEXTURE_2D, GL_LINEAR, GL_RG32F, GL_RGBA, true, GL_COLOR_ATTACHMENT0);
+	m_emptyShadowMap.BindAsRenderTarget();
+	glClearColor(1.0f,1.0f,0.0f,0.0f);
+	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+	
+	m_lightMatrix = Matrix4f().InitScale(Vector3f(0,0,0));	
+	m_numCascades = 0;
+	
+	//Instance attributes need glVertexAttribDivisor, which is core in 3.3.
+	m_instancingSupported = GLEW_VERSION_3_3 != 0;
+	m_instancing = m_instancingSupported;
+	if(m_instancingSupported)
 	{
-		int shadowMapSize = 1 << (i + 1);
-		m_shadowMaps[i] = Texture(shadowMapSize, shadowMapSize, 0, GL_TEXTURE_2D, GL_LINEAR, GL_RG32F, GL_RGBA, true, GL_COLOR_ATTACHMENT0);
-		m_shadowMapTempTargets[i] = Texture(shadowMapSize, shadowMapSize, 0, GL_TEXTURE_2D, GL_LINEAR, GL_RG32F, GL_RGBA, true, GL_COLOR_ATTACHMENT0);
+		glGenBuffers(1, &m_instanceBuffer);
 	}
 	
-	m_lightMatrix = Matrix4f().InitScale(Vector3f(0,0,0));	
+	m_multiDrawIndirectSupported = m_instancingSupported && MeshPool::IsMultiDrawIndirectSupported();
+	if(m_multiDrawIndirectSupported)
+	{
+		glGenBuffers(1, &m_drawIndirectBuffer);
+	}
+	
+	//Each block stays bound to it's binding point; only the contents change.
+	static const GLsizeiptr UNIFORM_BLOCK_SIZES[NUM_UNIFORM_BLOCK_BINDINGS] = 
+		{ sizeof(FrameBlockData), sizeof(LightBlockData), sizeof(ObjectBlockData) };
+	
+	glGenBuffers(NUM_UNIFORM_BLOCK_BINDINGS, m_uniformBlockBuffers);
+	for(unsigned int i = 0; i < NUM_UNIFORM_BLOCK_BINDINGS; i++)
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBlockBuffers[i]);
+		glBufferData(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_SIZES[i], 0, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, i, m_uniformBlockBuffers[i]);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+RenderingEngine::~RenderingEngine()
+{
+	for(std::map<std::string, Shader*>::iterator it = m_shaderVariants.begin(); it != m_shaderVariants.end(); ++it)
+	{
+		delete it->second;
+	}
+	
+	if(m_instanceBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_instanceBuffer);
+	}
+	
+	if(m_drawIndirectBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_drawIndirectBuffer);
+	}
+	
+	if(m_lightClusters)
+	{
+		delete m_lightClusters;
+	}
+	
+	for(std::map<const BaseLight*, ShadowMapCache*>::iterator it = m_shadowMapCaches.begin(); it != m_shadowMapCaches.end(); ++it)
+	{
+		delete it->second;
+	}
+	
+	glDeleteBuffers(NUM_UNIFORM_BLOCK_BINDINGS, m_uniformBlockBuffers);
 }
 
-void RenderingEngine::BlurShadowMap(int shadowMapIndex, float blurAmount)
+void RenderingEngine::RemoveLight(const BaseLight& light)
 {
-	SetVector3f("blurScale", Vector3f(blurAmount/(m_shadowMaps[shadowMapIndex].GetWidth()), 0.0f, 0.0f));
-	ApplyFilter(m_gausBlurFilter, m_shadowMaps[shadowMapIndex], &m_shadowMapTempTargets[shadowMapIndex]);
+	std::map<const BaseLight*, ShadowMapCache*>::iterator cache = m_shadowMapCaches.find(&light);
+	if(cache != m_shadowMapCaches.end())
+	{
+		m_shadowAtlas.Free(cache->second->region);
+		delete cache->second;
+		m_shadowMapCaches.erase(cache);
+	}
 	
-	SetVector3f("blurScale", Vector3f(0.0f, blurAmount/(m_shadowMaps[shadowMapIndex].GetHeight()), 0.0f));
-	ApplyFilter(m_gausBlurFilter, m_shadowMapTempTargets[shadowMapIndex], &m_shadowMaps[shadowMapIndex]); 
+	for(unsigned int i = 0; i < m_lights.size(); i++)
+	{
+		if(m_lights[i] == &light)
+		{
+			m_lights.erase(m_lights.begin() + i);
+			return;
+		}
+	}
+}
 
-//	SetVector3f("inverseFilterTextureSize", Vector3f(blurAmount/m_shadowMaps[shadowMapIndex].GetWidth(), blurAmount/m_shadowMaps[shadowMapIndex].GetHeight(), 0.0f));
-//	ApplyFilter(m_fxaaFilter, m_shadowMaps[shadowMapIndex], &m_shadowMapTempTargets[shadowMapIndex]);
-//	
-//	ApplyFilter(m_nullFilter, m_shadowMapTempTargets[shadowMapIndex], &m_shadowMaps[shadowMapIndex]);
+void RenderingEngine::AddMeshRenderer(const MeshRenderer& meshRenderer)
+{
+	meshRenderer.m_renderingEngineIndex = (unsigned int)m_meshRenderers.size();
+	m_meshRenderers.push_back(&meshRenderer);
+	m_meshRenderersVersion++;
 }
 
-void RenderingEngine::ApplyFilter(const Shader& filter, const Texture& source, const Texture* dest)
+void RenderingEngine::RemoveMeshRenderer(const MeshRenderer& meshRenderer)
 {
-	assert(&source != dest);
-	if(dest == 0)
+	//Order doesn't matter, so the last one takes it's place. Scenes that are streamed in and
+	//out remove lots of mesh renderers at once.
+	unsigned int index = meshRenderer.m_renderingEngineIndex;
+	assert(index < m_meshRenderers.size() && m_meshRenderers[index] == &meshRenderer);
+	
+	m_meshRenderers[index] = m_meshRenderers.back();
+	m_meshRenderers[index]->m_renderingEngineIndex = index;
+	m_meshRenderers.pop_back();
+	m_meshRenderersVersion++;
+}
+
+void RenderingEngine::DisplayCullingStats(double dividend)
+{
+	double numVisible = (double)m_numVisibleMeshRenderers;
+	double numCulled = (double)m_numCulledMeshRenderers;
+	if(dividend != 0)
 	{
-		m_window->BindAsRenderTarget();
+		numVisible /= dividend;
+		numCulled /= dividend;
 	}
-	else
+	
+	
+	double numDrawnLights = (double)m_numDrawnLights;
+	double numSkippedLights = (double)m_numSkippedLights;
+	double numLitPerLight = m_numDrawnLights == 0 ? 0.0 : (double)m_numLitMeshRenderers / (double)m_numDrawnLights;
+	if(dividend != 0)
 	{
-		dest->BindAsRenderTarget();
+		numDrawnLights /= dividend;
+		numSkippedLights /= dividend;
 	}
 	
-	SetTexture("filterTexture", source);
+	printf("Visible Meshes:                         %f (%f culled)\n", numVisible, numCulled);
+	printf("Light Passes:                           %f (%f skipped, %f meshes each)\n", numDrawnLights, numSkippedLights, numLitPerLight);
 	
-	m_altCamera.SetProjection(Matrix4f().InitIdentity());
-	m_altCamera.GetTransform()->SetPos(Vector3f(0,0,0));
-	m_altCamera.GetTransform()->SetRot(Quaternion(Vector3f(0,1,0),ToRadians(180.0f)));
+	double numShadowMapsRendered = (double)m_numShadowMapsRendered;
+	double numShadowMapsCached = (double)m_numShadowMapsCached;
+	if(dividend != 0)
+	{
+		numShadowMapsRendered /= dividend;
+		numShadowMapsCached /= dividend;
+	}
 	
-//	const Camera* temp = m_mainCamera;
-//	m_mainCamera = m_altCamera;
+	double numCastersPerShadowMap = m_numShadowMapsRendered == 0 ? 0.0 : (double)m_numShadowCasters / (double)m_numShadowMapsRendered;
+	double numCulledPerShadowMap = m_numShadowMapsRendered == 0 ? 0.0 : (double)m_numCulledShadowCasters / (double)m_numShadowMapsRendered;
+	
+	printf("Shadow Maps Rendered:                   %f (%f cached)\n", numShadowMapsRendered, numShadowMapsCached);
+	printf("Shadow Casters:                         %f per shadow map (%f culled)\n", numCastersPerShadowMap, numCulledPerShadowMap);
+	if(m_lightClusters)
+	{
+		double numClusteredLights = (double)m_numClusteredLights;
+		double numClusterLightIndices = (double)m_numClusterLightIndices;
+		if(dividend != 0)
+		{
+			numClusteredLights /= dividend;
+			numClusterLightIndices /= dividend;
+		}
+		
+		printf("Clustered Lights:                       %f (%f cluster light indices)\n", numClusteredLights, numClusterLightIndices);
+		m_numClusteredLights = 0;
+		m_numClusterLightIndices = 0;
+	}
+	m_numVisibleMeshRenderers = 0;
+	m_numCulledMeshRenderers = 0;
+	m_numDrawnLights = 0;
+	m_numSkippedLights = 0;
+	m_numLitMeshRenderers = 0;
+	m_numShadowMapsRendered = 0;
+	m_numShadowMapsCached = 0;
+	m_numShadowCasters = 0;
+	m_numCulledShadowCasters = 0;
+}
 
-	glClear(GL_DEPTH_BUFFER_BIT);
-	filter.Bind();
-	filter.UpdateUniforms(m_planeTransform, m_planeMaterial, *this, m_altCamera);
-	m_plane.Draw();
+bool RenderingEngine::AssignLightClusters()
+{
+	if(!m_lightClusters->Begin(m_mainCamera->GetView(), m_mainCamera->GetProjection()))
+	{
+		return false;
+	}
 	
-//	m_mainCamera = temp;
-	SetTexture("filterTexture", 0);
+	for(unsigned int i = 0; i < m_lights.size(); i++)
+	{
+		const BaseLight& light = *m_lights[i];
+		Vector3f lightCenter;
+		float lightRadius;
+		
+		if(!IsClusteredLight(light))
+		{
+			continue;
+		}
+		
+		light.CalcBoundingSphere(lightCenter, lightRadius);
+		if(!m_mainCameraFrustum.IntersectsSphere(lightCenter, lightRadius))
+		{
+			continue;
+		}
+		
+		LightBlockData lightData;
+		light.WriteUniformBlock(lightData);
+		m_lightClusters->AddLight(lightCenter, lightRadius, lightData);
+	}
+	
+	m_lightClusters->Assign(m_jobSystem);
+	m_numClusteredLights += m_lightClusters->GetNumLights();
+	m_numClusterLightIndices += m_lightClusters->GetNumLightIndices();
+	return true;
 }
 
-void RenderingEngine::Render(const Entity& object)
+bool RenderingEngine::IsClusteredLight(const BaseLight& light) const
 {
-	m_renderProfileTimer.StartInvocation();
-	GetTexture("displayTexture").BindAsRenderTarget();
-	//m_window->BindAsRenderTarget();
-	//m_tempTarget->BindAsRenderTarget();
+	//Shadow maps are rendered one light at a time, so lights with them still need a pass of their
+	//own. So do lights without a range, like directional lights, which reach every cluster.
+	Vector3f lightCenter;
+	float lightRadius;
+	return light.GetShadowInfo().GetShadowMapSizeAsPowerOf2() == 0 && light.CalcBoundingSphere(lightCenter, lightRadius);
+}
 
-	glClearColor(0.0f,0.0f,0.0f,0.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	object.RenderAll(m_defaultShader, *this, *m_mainCamera);
+void RenderingEngine::UpdateFrameBlock(const Camera& camera)
+{
+	FrameBlockData block;
+	Matrix4f viewProjection = camera.GetViewProjection();
+	Matrix4f inverseViewProjection = viewProjection.Inverse();
+	Vector3f eyePos = camera.GetTransform().GetTransformedPos();
+	const Vector3f& ambient = GetVector3f("ambient");
+	const Texture& target = GetTexture("displayTexture");
 	
-	for(unsigned int i = 0; i < m_lights.size(); i++)
+	memcpy(block.viewProjection, &viewProjection[0][0], sizeof(block.viewProjection));
+	memcpy(block.inverseViewProjection, &inverseViewProjection[0][0], sizeof(block.inverseViewProjection));
+	for(unsigned int i = 0; i < 3; i++)
 	{
-		m_activeLight = m_lights[i];
-		ShadowInfo shadowInfo = m_activeLight->GetShadowInfo();
+		block.eyePos[i] = eyePos[i];
+		block.ambient[i] = ambient[i];
+	}
+	block.inverseScreenSize[0] = 1.0f / (float)target.GetWidth();
+	block.inverseScreenSize[1] = 1.0f / (float)target.GetHeight();
+	block.padding0 = 0.0f;
+	block.padding1 = 0.0f;
+	block.clusterDepthScaleBias[0] = m_lightClusters ? m_lightClusters->GetDepthSliceScale() : 0.0f;
+	block.clusterDepthScaleBias[1] = m_lightClusters ? m_lightClusters->GetDepthSliceBias() : 0.0f;
+	
+	glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBlockBuffers[FRAME_BLOCK_BINDING]);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+}
+
+void RenderingEngine::UpdateLightBlock(const BaseLight& light)
+{
+	LightBlockData block;
+	light.WriteUniformBlock(block);
+	
+	memcpy(block.lightMatrix, &m_lightMatrix[0][0], sizeof(block.lightMatrix));
+	block.shadowVarianceMin = GetFloat("shadowVarianceMin");
+	block.shadowLightBleedingReduction = GetFloat("shadowLightBleedingReduction");
+	block.shadowExponent = GetFloat("shadowMapExponent");
+	block.shadowMipBias = GetFloat("shadowMipBias");
+	block.padding = 0.0f;
+	
+	for(int i = 0; i < MAX_SHADOW_CASCADES; i++)
+	{
+		//Unused cascades start too far away to ever be picked.
+		memcpy(block.cascadeMatrices[i], &m_cascadeMatrices[i][0][0], sizeof(block.cascadeMatrices[i]));
+		block.cascadeSplits[i] = i < m_numCascades ? m_cascadeSplits[i] : FLT_MAX;
+	}
+	block.numCascades = (float)m_numCascades;
+	block.padding2[0] = block.padding2[1] = block.padding2[2] = 0.0f;
+	for(int i = 0; i < 4; i++)
+	{
+		block.shadowAtlasRegion[i] = m_shadowAtlasRegion[i];
+	}
+	
+	glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBlockBuffers[LIGHT_BLOCK_BINDING]);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+}
+
+void RenderingEngine::UpdateObjectBlock(const Matrix4f& worldMatrix, const Camera& camera) const
+{
+	ObjectBlockData block;
+	Matrix4f projectedMatrix = camera.GetViewProjection() * worldMatrix;
+	Matrix4f lightMatrix = m_lightMatrix * worldMatrix;
+	
+	memcpy(block.model, &worldMatrix[0][0], sizeof(block.model));
+	memcpy(block.MVP, &projectedMatrix[0][0], sizeof(block.MVP));
+	memcpy(block.lightMatrix, &lightMatrix[0][0], sizeof(block.lightMatrix));
+	
+	glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBlockBuffers[OBJECT_BLOCK_BINDING]);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+}
+
+void RenderingEngine::CullMeshRenderers(const Camera& camera)
+{
+	unsigned int count = (unsigned int)m_meshRenderers.size();
+	unsigned int paddedCount = (count + 3) & ~3u;
+	
+	m_boundsX.resize(paddedCount);
+	m_boundsY.resize(paddedCount);
+	m_boundsZ.resize(paddedCount);
+	m_boundsRadius.resize(paddedCount);
+	m_boundsVisible.resize(paddedCount);
+	
+	//Every LOD is picked here, once a frame, from the main camera, so every pass draws the same
+	//triangles. The lighting passes rely on matching the ambient pass's depth exactly.
+	Vector3f cameraPos = camera.GetTransform().GetTransformedPos();
+	float projectionScale = camera.GetProjection()[1][1];
+	
+	for(unsigned int i = 0; i < count; i++)
+	{
+		const BoundingSphere& bounds = m_meshRenderers[i]->GetMesh().GetBoundingSphere();
+		Matrix4f transformation = m_meshRenderers[i]->GetTransform().GetTransformation();
+		Vector3f center(transformation.Transform(bounds.GetCenter()));
 		
-		int shadowMapIndex = 0;
-		if(shadowInfo.GetShadowMapSizeAsPowerOf2() != 0)
-			shadowMapIndex = shadowInfo.GetShadowMapSizeAsPowerOf2() - 1;
+		//The radius grows with the largest scale on any axis.
+		float scaleSq = 0.0f;
+		for(unsigned int j = 0; j < 3; j++)
+		{
+			Vector3f axis(transformation[j][0], transformation[j][1], transformation[j][2]);
+			scaleSq = std::max(scaleSq, axis.LengthSq());
+		}
 		
-		assert(shadowMapIndex >= 0 && shadowMapIndex < NUM_SHADOW_MAPS);
+		m_boundsX[i] = center.GetX();
+		m_boundsY[i] = center.GetY();
+		m_boundsZ[i] = center.GetZ();
+		m_boundsRadius[i] = bounds.GetRadius() * sqrtf(scaleSq);
 		
-		SetTexture("shadowMap", m_shadowMaps[shadowMapIndex]);
-		m_shadowMaps[shadowMapIndex].BindAsRenderTarget();
-		glClearColor(1.0f,1.0f,0.0f,0.0f);
-		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+		float distance = (center - cameraPos).Length();
+		SelectLod(*m_meshRenderers[i], distance > m_boundsRadius[i] ? m_boundsRadius[i] * projectionScale / distance : 1.0f);
+	}
+	
+	//A sphere is culled once it's more than it's radius behind a plane, so a radius of -FLT_MAX
+	//puts the padding behind every plane, wherever the camera is.
+	for(unsigned int i = count; i < paddedCount; i++)
+	{
+		m_boundsX[i] = 0.0f;
+		m_boundsY[i] = 0.0f;
+		m_boundsZ[i] = 0.0f;
+		m_boundsRadius[i] = -FLT_MAX;
+	}
+	
+	m_mainCameraFrustum = Frustum(camera.GetViewProjection());
+	unsigned int numVisible = paddedCount == 0 ? 0 : m_mainCameraFrustum.CullSpheres(&m_boundsX[0], &m_boundsY[0], &m_boundsZ[0], 
+		&m_boundsRadius[0], paddedCount, &m_boundsVisible[0]);
+	
+	m_visibleMeshRenderers.clear();
+	m_visibleMeshRendererIndices.clear();
+	for(unsigned int i = 0; i < count; i++)
+	{
+		if(m_boundsVisible[i])
+		{
+			m_visibleMeshRenderers.push_back(m_meshRenderers[i]);
+			m_visibleMeshRendererIndices.push_back(i);
+		}
+	}
+	
+	assert(numVisible == m_visibleMeshRenderers.size());
+	m_numVisibleMeshRenderers += numVisible;
+	m_numCulledMeshRenderers += count - numVisible;
+}
+
+void RenderingEngine::SelectLod(const MeshRenderer& meshRenderer, float screenSize) const
+{
+	//Each LOD has about half the triangles of the one before, and takes over when the mesh is half
+	//the size on screen.
+	unsigned int numLods = meshRenderer.GetMesh().GetNumLods();
+	unsigned int lod = std::min(meshRenderer.m_lod, numLods - 1);
+	
+	while(lod + 1 < numLods && screenSize < LOD_SCREEN_SIZE / (float)(1 << lod) * (1.0f - LOD_HYSTERESIS))
+	{
+		lod++;
+	}
+	
+	while(lod > 0 && screenSize > LOD_SCREEN_SIZE / (float)(1 << (lod - 1)) * (1.0f + LOD_HYSTERESIS))
+	{
+		lod--;
+	}
+	
+	meshRenderer.m_lod = lod;
+}
+
+bool RenderingEngine::FindLitMeshRenderers(const BaseLight& light, const Camera& camera, int* scissorRect, bool& useScissor)
+{
+	useScissor = false;
+	
+	Vector3f lightCenter;
+	float lightRadius;
+	if(!light.CalcBoundingSphere(lightCenter, lightRadius))
+	{
+		//Nothing to cull against; the light reaches everything that's visible.
+		m_litMeshRenderers = m_visibleMeshRenderers;
+		return true;
+	}
+	
+	if(!m_mainCameraFrustum.IntersectsSphere(lightCenter, lightRadius))
+	{
+		return false;
+	}
+	
+	m_litMeshRenderers.clear();
+	for(unsigned int i = 0; i < m_visibleMeshRendererIndices.size(); i++)
+	{
+		unsigned int index = m_visibleMeshRendererIndices[i];
+		if(light.AffectsSphere(Vector3f(m_boundsX[index], m_boundsY[index], m_boundsZ[index]), m_boundsRadius[index]))
+		{
+			m_litMeshRenderers.push_back(m_meshRenderers[index]);
+		}
+	}
+	
+	if(m_litMeshRenderers.empty())
+	{
+		return false;
+	}
+	
+	//The light can only change pixels inside the screen space rectangle around it's sphere. The
+	//box around the sphere is projected, since that's simpler than projecting the sphere exactly,
+	//and just a little larger. If any of it is behind the camera, the rectangle would be wrong,
+	//so the whole screen is used.
+	Matrix4f viewProjection = camera.GetViewProjection();
+	float minX = 1.0f;
+	float minY = 1.0f;
+	float maxX = -1.0f;
+	float maxY = -1.0f;
+	
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		Vector4f corner(lightCenter.GetX() + ((i & 1) ? lightRadius : -lightRadius),
+		                lightCenter.GetY() + ((i & 2) ? lightRadius : -lightRadius),
+		                lightCenter.GetZ() + ((i & 4) ? lightRadius : -lightRadius), 1.0f);
+		Vector4f clip(viewProjection.Transform(corner));
 		
-		if(shadowInfo.GetShadowMapSizeAsPowerOf2() != 0)
+		if(clip.GetW() <= 0.0f)
 		{
-			m_altCamera.SetProjection(shadowInfo.GetProjection());
-			ShadowCameraTransform shadowCameraTransform = m_activeLight->CalcShadowCameraTransform(m_mainCamera->GetTransform().GetTransformedPos(), 
-				m_mainCamera->GetTransform().GetTransformedRot());
-			m_altCamera.GetTransform()->SetPos(shadowCameraTransform.GetPos());
-			m_altCamera.GetTransform()->SetRot(shadowCameraTransform.GetRot());
-			
-			m_lightMatrix = BIAS_MATRIX * m_altCamera.GetViewProjection();
-			
-			SetFloat("shadowVarianceMin", shadowInfo.GetMinVariance());
-			SetFloat("shadowLightBleedingReduction", shadowInfo.GetLightBleedReductionAmount());
-			bool flipFaces = shadowInfo.GetFlipFaces();
-			
-//			const Camera* temp = m_mainCamera;
-//			m_mainCamera = m_altCamera;
-			
-			if(flipFaces)
-			{
-				glCullFace(GL_FRONT);
-			}
-			
-			glEnable(GL_DEPTH_CLAMP);
-			object.RenderAll(m_shadowMapShader, *this, m_altCamera);
-			glDisable(GL_DEPTH_CLAMP);
-			
-			if(flipFaces) 
-			{
-				glCullFace(GL_BACK);
-			}
-			
-//			m_mainCamera = temp;
-			
-			float shadowSoftness = shadowInfo.GetShadowSoftness();
-			if(shadowSoftness != 0)
-			{
-				BlurShadowMap(shadowMapIndex, shadowSoftness);
-			}
+			return true;
 		}
-		else
+		
+		minX = std::min(minX, clip.GetX() / clip.GetW());
+		minY = std::min(minY, clip.GetY() / clip.GetW());
+		maxX = std::max(maxX, clip.GetX() / clip.GetW());
+		maxY = std::max(maxY, clip.GetY() / clip.GetW());
+	}
+	
+	minX = std::max(minX, -1.0f);
+	minY = std::max(minY, -1.0f);
+	maxX = std::min(maxX, 1.0f);
+	maxY = std::min(maxY, 1.0f);
+	
+	const Texture& target = GetTexture("displayTexture");
+	int left   = (int)floor((minX * 0.5f + 0.5f) * (float)target.GetWidth());
+	int bottom = (int)floor((minY * 0.5f + 0.5f) * (float)target.GetHeight());
+	int right  = (int)ceil((maxX * 0.5f + 0.5f) * (float)target.GetWidth());
+	int top    = (int)ceil((maxY * 0.5f + 0.5f) * (float)target.GetHeight());
+	
+	if(right <= left || top <= bottom)
+	{
+		return false;
+	}
+	
+	scissorRect[0] = left;
+	scissorRect[1] = bottom;
+	scissorRect[2] = right - left;
+	scissorRect[3] = top - bottom;
+	useScissor = true;
+	return true;
+}
+
+void RenderingEngine::DrawMeshRenderers(const std::vector<const MeshRenderer*>& meshRenderers, const Shader& shader, const Camera& camera, unsigned int pass)
+{
+	if(!m_sortDrawCalls)
+	{
+		for(unsigned int i = 0; i < meshRenderers.size(); i++)
 		{
-			m_lightMatrix = Matrix4f().InitScale(Vector3f(0,0,0));
-			SetFloat("shadowVarianceMin", 0.00002f);
-			SetFloat("shadowLightBleedingReduction", 0.0f);
+			meshRenderers[i]->Draw(shader, *this, camera);
 		}
+		return;
+	}
+	
+	Vector3f cameraPos = camera.GetTransform().GetTransformedPos();
+	Vector3f cameraForward = camera.GetTransform().GetTransformedRot().GetForward();
+	
+	m_renderQueue.Clear();
+	for(unsigned int i = 0; i < meshRenderers.size(); i++)
+	{
+		const MeshRenderer* meshRenderer = meshRenderers[i];
+		float depth = (meshRenderer->GetTransform().GetTransformedPos() - cameraPos).Dot(cameraForward);
+		
+		m_renderQueue.Add(RenderQueue::MakeKey(pass, shader.GetSortId(), meshRenderer->GetMaterial().GetSortId(), 
+			meshRenderer->GetMesh().GetSortId(), meshRenderer->GetLod(), depth), meshRenderer);
+	}
+	
+	m_renderQueue.Sort();
+	SubmitRenderQueue(shader, camera);
+}
+
+void RenderingEngine::SubmitRenderQueue(const Shader& shader, const Camera& camera)
+{
+	if(m_renderQueue.GetSize() == 0)
+	{
+		return;
+	}
+	
+	if(m_instancing)
+	{
+		SubmitRenderQueueInstanced(GetInstancedShader(shader), camera);
+		return;
+	}
+	
+	//Everything in a pass uses the same shader, so it's only bound once. The ids are compared
+	//rather than the keys, since the keys only hold part of them.
+	shader.Bind();
 	
-		GetTexture("displayTexture").BindAsRenderTarget();
-		//m_window->BindAsRenderTarget();
+	const Material* lastMaterial = 0;
+	const Mesh* lastMesh = 0;
+	
+	for(unsigned int i = 0; i < m_renderQueue.GetSize(); i++)
+	{
+		const MeshRenderer* meshRenderer = m_renderQueue.GetPacket(i).meshRenderer;
+		const Material& material = meshRenderer->GetMaterial();
+		const Mesh& mesh = meshRenderer->GetMesh();
+		
+		if(lastMaterial == 0 || lastMaterial->GetSortId() != material.GetSortId())
+		{
+			shader.UpdateMaterialUniforms(material, *this, camera);
+			lastMaterial = &material;
+		}
+		
+		shader.UpdateObjectUniforms(meshRenderer->GetTransform(), material, *this, camera);
 		
-//		glEnable(GL_SCISSOR_TEST);
-//		TODO: Make use of scissor test to limit light area
-//		glScissor(0, 0, 100, 100);
+		if(lastMesh == 0 || lastMesh->GetSortId() != mesh.GetSortId())
+		{
+			mesh.Bind();
+			lastMesh = &mesh;
+		}
 		
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_ONE, GL_ONE);
-		glDepthMask(GL_FALSE);
-		glDepthFunc(GL_EQUAL);
+		mesh.DrawElements(meshRenderer->GetLod());
+	}
+}
 
-		object.RenderAll(m_activeLight->GetShader(), *this, *m_mainCamera);
+void RenderingEngine::SubmitRenderQueueInstanced(const Shader& shader, const Camera& camera)
+{
+	//Every draw goes through the instanced shader, even if it's the only one of it's kind, so
+	//positions are always calculated the same way. The lighting passes depend on that, since
+	//they only draw where the depth is equal to what the ambient pass left.
+	shader.Bind();
+	
+	//One command per run of the same mesh, LOD and material. The queue is sorted, so everything that
+	//can be drawn together is next to each other.
+	m_instanceMatrices.clear();
+	m_drawCommands.clear();
+	m_drawCommandMaterials.clear();
+	m_drawCommandIndexTypes.clear();
+	
+	unsigned int i = 0;
+	while(i < m_renderQueue.GetSize())
+	{
+		const MeshRenderer* first = m_renderQueue.GetPacket(i).meshRenderer;
+		const Material& material = first->GetMaterial();
+		const Mesh& mesh = first->GetMesh();
+		unsigned int lod = first->GetLod();
+		const MeshPoolRange& range = mesh.GetPoolRange(lod);
+		
+		DrawElementsIndirectCommand command;
+		command.count = range.numIndices;
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = (GLint)range.baseVertex;
+		command.baseInstance = (GLuint)m_instanceMatrices.size();
 		
-		glDepthMask(GL_TRUE);
-		glDepthFunc(GL_LESS);
-		glDisable(GL_BLEND);
+		for(; i < m_renderQueue.GetSize(); i++)
+		{
+			const MeshRenderer* meshRenderer = m_renderQueue.GetPacket(i).meshRenderer;
+			if(meshRenderer->GetMaterial().GetSortId() != material.GetSortId() ||
+			   meshRenderer->GetMesh().GetSortId() != mesh.GetSortId() || meshRenderer->GetLod() != lod)
+			{
+				break;
+			}
+			
+			m_instanceMatrices.push_back(meshRenderer->GetTransform().GetTransformation());
+		}
 		
-//		glDisable(GL_SCISSOR_TEST);
+		command.instanceCount = (GLuint)m_instanceMatrices.size() - command.baseInstance;
+		m_drawCommands.push_back(command);
+		m_drawCommandMaterials.push_back(&material);
+		m_drawCommandIndexTypes.push_back(range.indexType);
 	}
 	
-	float displayTextureAspect = (float)GetTexture("displayTexture").GetWidth()/(float)GetTexture("displayTexture").GetHeight();
-	float displayTextureHeightAdditive = displayTextureAspect * GetFloat("fxaaAspectDistortion");
-	SetVector3f("inverseFilterTextureSize", Vector3f(1.0f/(float)GetTexture("displayTexture").GetWidth(), 
-	                                                 1.0f/((float)GetTexture("displayTexture").GetHeight() + displayTextureHeightAdditive), 0.0f));
-	m_renderProfileTimer.StopInvocation();
+	//The whole pass's matrices and commands are uploaded at once. Orphaned every time, so the
+	//driver doesn't have to wait for the last pass to finish with the old contents.
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_instanceMatrices.size() * sizeof(Matrix4f), &m_instanceMatrices[0], GL_STREAM_DRAW);
 	
-	m_windowSyncProfileTimer.StartInvocation();
-	ApplyFilter(m_fxaaFilter, GetTexture("displayTexture"), 0);
-	m_windowSyncProfileTimer.StopInvocation();
+	if(m_multiDrawIndirectSupported)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_drawIndirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, m_drawCommands.size() * sizeof(DrawElementsIndirectCommand), &m_drawCommands[0], GL_STREAM_DRAW);
+	}
+	
+	//Every mesh is in the same pool, so only changes of material, or of index size, split the
+	//pass up.
+	const MeshPool& meshPool = Mesh::GetPool();
+	const Material* lastMaterial = 0;
+	
+	unsigned int runStart = 0;
+	while(runStart < m_drawCommands.size())
+	{
+		const Material& material = *m_drawCommandMaterials[runStart];
+		GLenum indexType = m_drawCommandIndexTypes[runStart];
+		unsigned int runEnd = runStart + 1;
+		while(runEnd < m_drawCommands.size() && m_drawCommandMaterials[runEnd]->GetSortId() == material.GetSortId() &&
+		      m_drawCommandIndexTypes[runEnd] == indexType)
+		{
+			runEnd++;
+		}
+		
+		if(lastMaterial == 0 || lastMaterial->GetSortId() != material.GetSortId())
+		{
+			shader.UpdateMaterialUniforms(material, *this, camera);
+			lastMaterial = &material;
+		}
+		
+		meshPool.Bind(indexType);
+		if(m_multiDrawIndirectSupported)
+		{
+			meshPool.MultiDrawIndirect(indexType, m_instanceBuffer, runStart, (int)(runEnd - runStart));
+			
+			//The pool can't see what the commands draw.
+			for(unsigned int j = runStart; j < runEnd; j++)
+			{
+				RenderCounters::numTriangles += m_drawCommands[j].count / 3 * m_drawCommands[j].instanceCount;
+			}
+		}
+		else
+		{
+			//Base vertex draws, with the instance attributes moved to each command's matrices.
+			for(unsigned int j = runStart; j < runEnd; j++)
+			{
+				const DrawElementsIndirectCommand& command = m_drawCommands[j];
+				MeshPoolRange range;
+				range.baseVertex = (unsigned int)command.baseVertex;
+				range.firstIndex = command.firstIndex;
+				range.numIndices = command.count;
+				range.indexType = indexType;
+				meshPool.DrawInstanced(range, m_instanceBuffer, command.baseInstance, (int)command.instanceCount);
+			}
+		}
+		
+		runStart = runEnd;
+	}
+	
+	if(m_multiDrawIndirectSupported)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+const Shader& RenderingEngine::GetInstancedShader(const Shader& shader)
+{
+	return GetShaderVariant(shader.GetName() + "-instanced");
+}
+
+const Shader& RenderingEngine::GetDeferredLightShader(const BaseLight& light)
+{
+	//Every light's shader is named "forward-<type>", and has a "deferred-<type>" counterpart.
+	const std::string& forwardName = light.GetShader().GetName();
+	return GetShaderVariant("deferred" + forwardName.substr(forwardName.find('-')));
+}
+
+const Shader& RenderingEngine::GetShaderVariant(const std::string& fileName)
+{
+	std::map<std::string, Shader*>::const_iterator it = m_shaderVariants.find(fileName);
+	if(it != m_shaderVariants.end())
+	{
+		return *it->second;
+	}
+	
+	Shader* shader = new Shader(fileName);
+	m_shaderVariants[fileName] = shader;
+	return *shader;
+}
+
+void RenderingEngine::BlurShadowMap(const Texture& shadowMap, const Texture& tempTarget, float blurAmount, int x, int y, int width, int height)
+{
+	//Samples are clamped to the centers of the region's edge texels, so neither pass reads other
+	//lights' shadow maps, or what their blurs left in the temp target. Expects the scissor
+	//to be set to the same region.
+	float mapWidth = (float)shadowMap.GetWidth();
+	float mapHeight = (float)shadowMap.GetHeight();
+	SetVector3f("blurRegionMin", Vector3f(((float)x + 0.5f)/mapWidth, ((float)y + 0.5f)/mapHeight, 0.0f));
+	SetVector3f("blurRegionMax", Vector3f(((float)(x + width) - 0.5f)/mapWidth, ((float)(y + height) - 0.5f)/mapHeight, 0.0f));
+	
+	SetVector3f("blurScale", Vector3f(blurAmount/(shadowMap.GetWidth()), 0.0f, 0.0f));
+	ApplyFilter(m_gausBlurFilter, shadowMap, &tempTarget);
+	
+	SetVector3f("blurScale", Vector3f(0.0f, blurAmount/(shadowMap.GetHeight()), 0.0f));
+	ApplyFilter(m_gausBlurFilter, tempTarget, &shadowMap); 
+
+//	SetVector3f("inverseFilterTextureSize", Vector3f(blurAmount/shadowMap.GetWidth(), blurAmount/shadowMap.GetHeight(), 0.0f));
+//	ApplyFilter(m_fxaaFilter, shadowMap, &tempTarget);
+//	
+//	ApplyFilter(m_nullFilter, tempTarget, &shadowMap);
+}
+
+void RenderingEngine::ApplyFilter(const Shader& filter, const Texture& source, const Texture* dest)
+{
+	assert(&source != dest);
+	if(dest == 0)
+	{
+		m_window->BindAsRenderTarget();
+	}
+	else
+	{
+		dest->BindAsRenderTarget();
+	}
+	
+	SetTexture("filterTexture", source);
+	
+//	const Camera* temp = m_mainCamera;
+//	m_mainCamera = m_altCamera;
+
+	glClear(GL_DEPTH_BUFFER_BIT);
+	DrawFullScreenQuad(filter);
+	
+//	m_mainCamera = temp;
+	SetTexture("filterTexture", 0);
+}
+
+void RenderingEngine::DrawFullScreenQuad(const Shader& shader)
+{
+	m_altCamera.SetProjection(Matrix4f().InitIdentity());
+	m_altCamera.GetTransform()->SetPos(Vector3f(0,0,0));
+	m_altCamera.GetTransform()->SetRot(Quaternion(Vector3f(0,1,0),ToRadians(180.0f)));
+	
+	shader.Bind();
+	shader.UpdateUniforms(m_planeTransform, m_planeMaterial, *this, m_altCamera);
+	m_plane.Draw();
+}
+
+void RenderingEngine::DrawLightVolume(const BaseLight& light, const Vector3f& center, float radius)
+{
+	float coneLength;
+	float coneWidth;
+	const Mesh* volume = &m_sphereVolume;
+	
+	m_lightVolumeTransform.SetPos(center);
+	m_lightVolumeTransform.SetRot(Quaternion());
+	m_lightVolumeTransform.SetScale(radius);
+	SetFloat("lightVolumeWidth", 1.0f);
+	
+	//Transforms only have a uniform scale, so the cone is made wider or narrower by the shader.
+	if(light.CalcBoundingCone(coneLength, coneWidth))
+	{
+		volume = &m_coneVolume;
+		m_lightVolumeTransform.SetPos(light.GetTransform().GetTransformedPos());
+		m_lightVolumeTransform.SetRot(light.GetTransform().GetTransformedRot());
+		m_lightVolumeTransform.SetScale(coneLength);
+		SetFloat("lightVolumeWidth", coneWidth);
+	}
+	
+	//Only the back faces are drawn, where the scene's surface is in front of them, so pixels that
+	//are further away than the light reaches fail the depth test before they're lit. That works
+	//with the camera inside the volume too, where the front faces would be clipped. Depth clamping
+	//keeps back faces past the far plane from being clipped.
+	GLState::CullFace(GL_FRONT);
+	GLState::DepthFunc(GL_GEQUAL);
+	GLState::DepthMask(false);
+	GLState::Enable(GL_DEPTH_CLAMP);
+	
+	const Shader& shader = GetDeferredLightShader(light);
+	shader.Bind();
+	shader.UpdateUniforms(m_lightVolumeTransform, m_planeMaterial, *this, *m_mainCamera);
+	volume->Draw();
+	
+	GLState::Disable(GL_DEPTH_CLAMP);
+	GLState::DepthMask(true);
+	GLState::DepthFunc(GL_LESS);
+	GLState::CullFace(GL_BACK);
+}
+
+IndexedModel RenderingEngine::CreateSphereVolume(int numSlices, int numStacks)
+{
+	IndexedModel model;
+	
+	//Rings of vertices between the two poles, all on the unit sphere.
+	model.AddVertex(0.0f, 0.0f, 1.0f);
+	for(int i = 1; i < numStacks; i++)
+	{
+		float stackAngle = MATH_PI * (float)i / (float)numStacks;
+		for(int j = 0; j < numSlices; j++)
+		{
+			float sliceAngle = 2.0f * MATH_PI * (float)j / (float)numSlices;
+			model.AddVertex(sinf(stackAngle) * cosf(sliceAngle), sinf(stackAngle) * sinf(sliceAngle), cosf(stackAngle));
+		}
+	}
+	model.AddVertex(0.0f, 0.0f, -1.0f);
+	
+	int lastVertex = 1 + (numStacks - 1) * numSlices;
+	for(int j = 0; j < numSlices; j++)
+	{
+		int next = (j + 1) % numSlices;
+		model.AddFace(0, 1 + j, 1 + next);
+		
+		for(int i = 0; i < numStacks - 2; i++)
+		{
+			int ring = 1 + i * numSlices;
+			int nextRing = ring + numSlices;
+			model.AddFace(ring + j, nextRing + j, ring + next);
+			model.AddFace(ring + next, nextRing + j, nextRing + next);
+		}
+		
+		int lastRing = lastVertex - numSlices;
+		model.AddFace(lastVertex, lastRing + next, lastRing + j);
+	}
+	
+	//The triangles cut inside the sphere, the most where their planes are closest to the center,
+	//so the vertices are pushed out until none of them do.
+	const std::vector<Vector3f>& positions = model.GetPositions();
+	const std::vector<unsigned int>& indices = model.GetIndices();
+	float minDistance = 1.0f;
+	for(unsigned int i = 0; i < indices.size(); i += 3)
+	{
+		const Vector3f& a = positions[indices[i]];
+		Vector3f normal = (positions[indices[i + 1]] - a).Cross(positions[indices[i + 2]] - a).Normalized();
+		minDistance = std::min(minDistance, normal.Dot(a));
+	}
+	
+	IndexedModel result;
+	for(unsigned int i = 0; i < positions.size(); i++)
+	{
+		//The lighting shaders only read the positions.
+		result.AddVertex(positions[i] / minDistance);
+		result.AddTexCoord(0.0f, 0.0f);
+		result.AddNormal(positions[i]);
+		result.AddTangent(1.0f, 0.0f, 0.0f);
+	}
+	for(unsigned int i = 0; i < indices.size(); i += 3)
+	{
+		result.AddFace(indices[i], indices[i + 1], indices[i + 2]);
+	}
+	
+	return result;
+}
+
+IndexedModel RenderingEngine::CreateConeVolume(int numSlices)
+{
+	IndexedModel model;
+	
+	//The polygon around the base touches the circle at the middle of each side.
+	float baseRadius = 1.0f / cosf(MATH_PI / (float)numSlices);
+	
+	model.AddVertex(0.0f, 0.0f, 0.0f);
+	model.AddVertex(0.0f, 0.0f, 1.0f);
+	for(int i = 0; i < numSlices; i++)
+	{
+		float sliceAngle = 2.0f * MATH_PI * (float)i / (float)numSlices;
+		model.AddVertex(baseRadius * cosf(sliceAngle), baseRadius * sinf(sliceAngle), 1.0f);
+	}
+	
+	for(int i = 0; i < numSlices; i++)
+	{
+		int next = (i + 1) % numSlices;
+		model.AddFace(0, 2 + next, 2 + i);
+		model.AddFace(1, 2 + i, 2 + next);
+	}
+	
+	//The lighting shaders only read the positions.
+	for(int i = 0; i < numSlices + 2; i++)
+	{
+		model.AddTexCoord(0.0f, 0.0f);
+		model.AddNormal(0.0f, 0.0f, 1.0f);
+		model.AddTangent(1.0f, 0.0f, 0.0f);
+	}
+	
+	return model;
+}
+
+void RenderingEngine::Render(const Entity& object)
+{
+	//The camera's entity may have been destroyed, and everything below needs one to cull and
+	//draw with, so the window is just cleared until there's a new one.
+	if(m_mainCamera == 0)
+	{
+		m_window->BindAsRenderTarget();
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		return;
+	}
+	
+	m_renderProfileTimer.StartInvocation();
+	
+	//Everything that's drawn with the main camera only has to be culled once. Components other
+	//than mesh renderers still draw themselves through RenderAll.
+	CullMeshRenderers(*m_mainCamera);
+	FindChangedShadowCasters();
+	bool clusteredLights = m_renderPath == RENDER_PATH_CLUSTERED && AssignLightClusters();
+	RenderShadowMaps(object);
+	UpdateFrameBlock(*m_mainCamera);
+	
+	if(m_renderPath == RENDER_PATH_DEFERRED)
+	{
+		RenderDeferred(object);
+	}
+	else
+	{
+		RenderForward(object, clusteredLights);
+	}
+	
+	float displayTextureAspect = (float)GetTexture("displayTexture").GetWidth()/(float)GetTexture("displayTexture").GetHeight();
+	float displayTextureHeightAdditive = displayTextureAspect * GetFloat("fxaaAspectDistortion");
+	SetVector3f("inverseFilterTextureSize", Vector3f(1.0f/(float)GetTexture("displayTexture").GetWidth(), 
+	                                                 1.0f/((float)GetTexture("displayTexture").GetHeight() + displayTextureHeightAdditive), 0.0f));
+	m_renderProfileTimer.StopInvocation();
+	
+	m_windowSyncProfileTimer.StartInvocation();
+	ApplyFilter(m_fxaaFilter, GetTexture("displayTexture"), 0);
+	m_windowSyncProfileTimer.StopInvocation();
+	m_frameIndex++;
+}
+
+void RenderingEngine::RenderForward(const Entity& object, bool clusteredLights)
+{
+	GetTexture("displayTexture").BindAsRenderTarget();
+	//m_window->BindAsRenderTarget();
+	//m_tempTarget->BindAsRenderTarget();
+
+	glClearColor(0.0f,0.0f,0.0f,0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	
+	const Shader& ambientShader = clusteredLights ? GetShaderVariant("forward-clustered") : m_defaultShader;
+	DrawMeshRenderers(m_visibleMeshRenderers, ambientShader, *m_mainCamera, PASS_AMBIENT);
+	object.RenderAll(ambientShader, *this, *m_mainCamera);
+	
+	for(unsigned int i = 0; i < m_lights.size(); i++)
+	{
+		m_activeLight = m_lights[i];
+		
+		//Already applied by the ambient pass.
+		if(clusteredLights && IsClusteredLight(*m_activeLight))
+		{
+			continue;
+		}
+		
+		//Lights that can't reach anything on screen don't need a shadow map or a pass.
+		int scissorRect[4];
+		bool useScissor = false;
+		
+		if(!FindLitMeshRenderers(*m_activeLight, *m_mainCamera, scissorRect, useScissor))
+		{
+			m_numSkippedLights++;
+			continue;
+		}
+		
+		m_numDrawnLights++;
+		m_numLitMeshRenderers += (unsigned int)m_litMeshRenderers.size();
+		
+		SetShadowMap(*m_activeLight);
+		UpdateLightBlock(*m_activeLight);
+		
+		if(useScissor)
+		{
+			GLState::Enable(GL_SCISSOR_TEST);
+			GLState::Scissor(scissorRect[0], scissorRect[1], scissorRect[2], scissorRect[3]);
+		}
+		
+		GLState::Enable(GL_BLEND);
+		GLState::BlendFunc(GL_ONE, GL_ONE);
+		GLState::DepthMask(false);
+		GLState::DepthFunc(GL_EQUAL);
+
+		DrawMeshRenderers(m_litMeshRenderers, m_activeLight->GetShader(), *m_mainCamera, PASS_LIGHT);
+		object.RenderAll(m_activeLight->GetShader(), *this, *m_mainCamera);
+		
+		GLState::DepthMask(true);
+		GLState::DepthFunc(GL_LESS);
+		GLState::Disable(GL_BLEND);
+		
+		if(useScissor)
+		{
+			GLState::Disable(GL_SCISSOR_TEST);
+		}
+	}
+}
+
+void RenderingEngine::RenderDeferred(const Entity& object)
+{
+	//Only the closest surface of each pixel is written, so objects are drawn once, no matter how
+	//many lights reach them.
+	const Shader& geometryShader = GetShaderVariant("deferred-geometry");
+	
+	m_gBuffer.BindAsRenderTarget();
+	glClearColor(0.0f,0.0f,0.0f,0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	
+	DrawMeshRenderers(m_visibleMeshRenderers, geometryShader, *m_mainCamera, PASS_GEOMETRY);
+	object.RenderAll(geometryShader, *this, *m_mainCamera);
+	
+	//The light volumes are depth tested against the scene, so it's depth is copied over.
+	m_gBuffer.CopyDepthTo(GetTexture("displayTexture"));
+	GetTexture("displayTexture").BindAsRenderTarget();
+	glClear(GL_COLOR_BUFFER_BIT);
+	
+	//The screen space passes all cover the same pixels, so they'd fail the depth test.
+	GLState::Disable(GL_DEPTH_TEST);
+	DrawFullScreenQuad(GetShaderVariant("deferred-ambient"));
+	GLState::Enable(GL_DEPTH_TEST);
+	
+	for(unsigned int i = 0; i < m_lights.size(); i++)
+	{
+		m_activeLight = m_lights[i];
+		
+		//The lit mesh renderers aren't drawn again, but if there aren't any, the light has
+		//nothing to light, and the scissor rectangle is still what bounds the pass.
+		int scissorRect[4];
+		bool useScissor = false;
+		
+		if(!FindLitMeshRenderers(*m_activeLight, *m_mainCamera, scissorRect, useScissor))
+		{
+			m_numSkippedLights++;
+			continue;
+		}
+		
+		m_numDrawnLights++;
+		m_numLitMeshRenderers += (unsigned int)m_litMeshRenderers.size();
+		
+		SetShadowMap(*m_activeLight);
+		UpdateLightBlock(*m_activeLight);
+		
+		if(useScissor)
+		{
+			GLState::Enable(GL_SCISSOR_TEST);
+			GLState::Scissor(scissorRect[0], scissorRect[1], scissorRect[2], scissorRect[3]);
+		}
+		
+		GLState::Enable(GL_BLEND);
+		GLState::BlendFunc(GL_ONE, GL_ONE);
+		
+		//Lights without a range reach every pixel.
+		Vector3f lightCenter;
+		float lightRadius;
+		if(m_activeLight->CalcBoundingSphere(lightCenter, lightRadius))
+		{
+			DrawLightVolume(*m_activeLight, lightCenter, lightRadius);
+		}
+		else
+		{
+			GLState::Disable(GL_DEPTH_TEST);
+			DrawFullScreenQuad(GetDeferredLightShader(*m_activeLight));
+			GLState::Enable(GL_DEPTH_TEST);
+		}
+		
+		GLState::Disable(GL_BLEND);
+		
+		if(useScissor)
+		{
+			GLState::Disable(GL_SCISSOR_TEST);
+		}
+	}
+}
+
+void RenderingEngine::RenderShadowMaps(const Entity& object)
+{
+	m_shadowProfileTimer.StartInvocation();
+	
+	AllocateShadowMaps();
+	
+	//Every light has it's own part of the atlas, so they can all be rendered before any of them
+	//are used. Lights that can't be seen don't get updated until they can.
+	m_numShadowViews = 0;
+	for(unsigned int i = 0; i < m_lights.size(); i++)
+	{
+		const BaseLight& light = *m_lights[i];
+		std::map<const BaseLight*, ShadowMapCache*>::iterator it = m_shadowMapCaches.find(&light);
+		if(it == m_shadowMapCaches.end() || it->second->region.size == 0)
+		{
+			continue;
+		}
+		
+		Vector3f lightCenter;
+		float lightRadius;
+		if(light.CalcBoundingSphere(lightCenter, lightRadius) && !m_mainCameraFrustum.IntersectsSphere(lightCenter, lightRadius))
+		{
+			continue;
+		}
+		
+		m_activeLight = &light;
+		FindShadowViews(*it->second);
+	}
+	
+	//Each view only writes to it's own caster list, so they can all be culled at once.
+	if(m_jobSystem != 0)
+	{
+		m_jobSystem->ParallelFor(0, m_numShadowViews, 1, [this](unsigned int rangeBegin, unsigned int rangeEnd)
+		{
+			for(unsigned int i = rangeBegin; i < rangeEnd; i++)
+			{
+				CullShadowCasters(m_shadowViews[i]);
+			}
+		});
+	}
+	else
+	{
+		for(unsigned int i = 0; i < m_numShadowViews; i++)
+		{
+			CullShadowCasters(m_shadowViews[i]);
+		}
+	}
+	
+	for(unsigned int i = 0; i < m_numShadowViews; i++)
+	{
+		unsigned int numCasters = (unsigned int)m_shadowViews[i].casters.size();
+		m_numShadowCasters += numCasters;
+		m_numCulledShadowCasters += (unsigned int)m_meshRenderers.size() - numCasters;
+		
+		RenderShadowView(m_shadowViews[i], object);
+	}
+	
+	m_shadowProfileTimer.StopInvocation();
+}
+
+void RenderingEngine::AllocateShadowMaps()
+{
+	//Biggest first, so they pack tightly.
+	std::vector<std::pair<int, const BaseLight*> > requests;
+	for(unsigned int i = 0; i < m_lights.size(); i++)
+	{
+		if(m_lights[i]->GetShadowInfo().GetShadowMapSizeAsPowerOf2() != 0)
+		{
+			requests.push_back(std::make_pair(CalcShadowMapSize(*m_lights[i]), m_lights[i]));
+		}
+	}
+	std::sort(requests.begin(), requests.end(), std::greater<std::pair<int, const BaseLight*> >());
+	
+	//Regions that grew too small or too big are given back first, so their space can be reused.
+	//They're allowed to be up to twice as big as they need to be, so lights near a boundary
+	//don't keep swapping between two sizes.
+	for(unsigned int i = 0; i < requests.size(); i++)
+	{
+		ShadowMapCache& cache = GetShadowMapCache(*requests[i].second);
+		int size = requests[i].first;
+		if(cache.region.size != 0 && (cache.region.size < size || cache.region.size > size * 2))
+		{
+			m_shadowAtlas.Free(cache.region);
+			cache.region = ShadowAtlasRegion();
+		}
+	}
+	
+	//When the atlas is full, lights get less than they asked for, or no shadows at all.
+	for(unsigned int i = 0; i < requests.size(); i++)
+	{
+		ShadowMapCache& cache = GetShadowMapCache(*requests[i].second);
+		if(cache.region.size != 0)
+		{
+			continue;
+		}
+		
+		for(int size = requests[i].first; size >= MIN_SHADOW_MAP_SIZE && cache.region.size == 0; size /= 2)
+		{
+			cache.region = m_shadowAtlas.Allocate(size);
+		}
+		
+		for(int j = 0; j < MAX_SHADOW_CASCADES; j++)
+		{
+			cache.dirty[j] = true;
+			cache.rendered[j] = false;
+		}
+	}
+}
+
+int RenderingEngine::CalcShadowMapSize(const BaseLight& light) const
+{
+	int maxSize = 1 << light.GetShadowInfo().GetShadowMapSizeAsPowerOf2();
+	const Matrix4f& projection = m_mainCamera->GetProjection();
+	
+	//Lights that reach everything, and views without perspective, always get all of it.
+	Vector3f lightCenter;
+	float lightRadius;
+	if(!light.CalcBoundingSphere(lightCenter, lightRadius) || projection[2][3] == 0.0f)
+	{
+		return maxSize;
+	}
+	
+	float distance = (lightCenter - m_mainCamera->GetTransform().GetTransformedPos()).Length();
+	if(distance <= lightRadius)
+	{
+		return maxSize;
+	}
+	
+	//Roughly how much of the screen's height the light's sphere covers. See Matrix4f::InitPerspective.
+	float screenFraction = std::min(lightRadius * projection[1][1] / distance, 1.0f);
+	
+	int size = maxSize;
+	while(size > MIN_SHADOW_MAP_SIZE && (float)(size / 2) >= (float)maxSize * screenFraction)
+	{
+		size /= 2;
+	}
+	
+	return size;
+}
+
+void RenderingEngine::FindShadowViews(ShadowMapCache& cache)
+{
+	ShadowInfo shadowInfo = m_activeLight->GetShadowInfo();
+	int numCascades = shadowInfo.GetNumCascades();
+	
+	//A cascade is out of date if it's shadow camera moved, which also covers the light moving, or
+	//if something it can see did, see FindChangedShadowCasters. Cascades further away are
+	//allowed to lag behind, being updated every 2, 4 and 8 frames, once they have something in them.
+	for(int i = 0; i < numCascades; i++)
+	{
+		float splitDistance;
+		SetShadowCamera(shadowInfo, cache.region, i, splitDistance);
+		Matrix4f viewProjection = m_altCamera.GetViewProjection();
+		if(memcmp(&cache.viewProjections[i][0][0], &viewProjection[0][0], sizeof(Matrix4f)) != 0)
+		{
+			cache.dirty[i] = true;
+		}
+		
+		if(!cache.dirty[i] || (cache.rendered[i] && (m_frameIndex & ((1u << i) - 1)) != 0))
+		{
+			m_numShadowMapsCached++;
+			continue;
+		}
+		
+		cache.viewProjections[i] = viewProjection;
+		cache.cascadeSplits[i] = splitDistance;
+		cache.dirty[i] = false;
+		cache.rendered[i] = true;
+		m_numShadowMapsRendered++;
+		
+		if(m_numShadowViews == m_shadowViews.size())
+		{
+			m_shadowViews.push_back(ShadowView());
+		}
+		
+		ShadowView& view = m_shadowViews[m_numShadowViews++];
+		view.light = m_activeLight;
+		view.cache = &cache;
+		view.cascade = i;
+		view.frustum = Frustum(viewProjection);
+		view.frustum.IgnorePlane(Frustum::PLANE_NEAR);
+	}
+}
+
+void RenderingEngine::CullShadowCasters(ShadowView& view)
+{
+	unsigned int count = (unsigned int)m_meshRenderers.size();
+	unsigned int paddedCount = (unsigned int)m_boundsX.size();
+	
+	view.casters.clear();
+	view.castersVisible.resize(paddedCount);
+	if(paddedCount == 0)
+	{
+		return;
+	}
+	
+	view.frustum.CullSpheres(&m_boundsX[0], &m_boundsY[0], &m_boundsZ[0], &m_boundsRadius[0], paddedCount, &view.castersVisible[0]);
+	for(unsigned int i = 0; i < count; i++)
+	{
+		if(view.castersVisible[i])
+		{
+			view.casters.push_back(m_meshRenderers[i]);
+		}
+	}
+}
+
+void RenderingEngine::RenderShadowView(const ShadowView& view, const Entity& object)
+{
+	m_activeLight = view.light;
+	ShadowInfo shadowInfo = m_activeLight->GetShadowInfo();
+	const ShadowAtlasRegion& region = view.cache->region;
+	
+	//Cascades are laid out left to right, then bottom to top, in the light's region. Only the
+	//one being rendered is cleared and blurred, so the rest keep their contents.
+	int cascadeSize = shadowInfo.GetNumCascades() > 1 ? region.size / 2 : region.size;
+	int x = region.x + (view.cascade % 2) * cascadeSize;
+	int y = region.y + (view.cascade / 2) * cascadeSize;
+	
+	float splitDistance;
+	SetShadowCamera(shadowInfo, region, view.cascade, splitDistance);
+	
+	m_shadowAtlasTexture.BindAsRenderTarget();
+	GLState::Enable(GL_SCISSOR_TEST);
+	GLState::Viewport(x, y, cascadeSize, cascadeSize);
+	GLState::Scissor(x, y, cascadeSize, cascadeSize);
+	SetShadowMapClearColor();
+	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+	
+	bool flipFaces = shadowInfo.GetFlipFaces();
+	if(flipFaces)
+	{
+		GLState::CullFace(GL_FRONT);
+	}
+	
+	//Only mesh renderers are culled and tracked for changes, other components that draw
+	//themselves only show up when something else makes the cascade dirty.
+	const Shader& shadowMapShader = m_exponentialShadows ? GetShaderVariant("shadowMapGenerator-evsm") : m_shadowMapShader;
+	GLState::Enable(GL_DEPTH_CLAMP);
+	DrawMeshRenderers(view.casters, shadowMapShader, m_altCamera, PASS_SHADOW);
+	object.RenderAll(shadowMapShader, *this, m_altCamera);
+	GLState::Disable(GL_DEPTH_CLAMP);
+	
+	if(flipFaces) 
+	{
+		GLState::CullFace(GL_BACK);
+	}
+	
+	float shadowSoftness = shadowInfo.GetShadowSoftness();
+	if(shadowSoftness != 0 && !m_exponentialShadows)
+	{
+		BlurShadowMap(m_shadowAtlasTexture, m_shadowAtlasTempTarget, shadowSoftness, x, y, cascadeSize, cascadeSize);
+	}
+	GLState::Disable(GL_SCISSOR_TEST);
+	
+	//Exponential shadow maps are softened by their mipmaps instead of a blur. Only this cascade's
+	//are rebuilt; regions are aligned to their size, so down to a single texel, none of it's
+	//levels' texels are shared with other shadow maps.
+	if(m_exponentialShadows)
+	{
+		m_shadowAtlasTexture.GenerateMipmaps(x, y, cascadeSize, cascadeSize);
+	}
+}
+
+void RenderingEngine::SetExponentialShadows(bool exponentialShadows)
+{
+	if(m_exponentialShadows != exponentialShadows)
+	{
+		m_exponentialShadows = exponentialShadows;
+		CreateShadowAtlas();
+	}
+}
+
+void RenderingEngine::CreateShadowAtlas()
+{
+	if(m_exponentialShadows)
+	{
+		m_shadowAtlasTexture = Texture(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 0, GL_TEXTURE_2D, GL_LINEAR_MIPMAP_LINEAR, GL_RGBA16F, GL_RGBA, true, GL_COLOR_ATTACHMENT0);
+		m_shadowAtlasTempTarget = Texture();
+	}
+	else
+	{
+		m_shadowAtlasTexture = Texture(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 0, GL_TEXTURE_2D, GL_LINEAR, GL_RG32F, GL_RGBA, true, GL_COLOR_ATTACHMENT0);
+		m_shadowAtlasTempTarget = Texture(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 0, GL_TEXTURE_2D, GL_LINEAR, GL_RG32F, GL_RGBA, true, GL_COLOR_ATTACHMENT0);
+	}
+	
+	m_shadowAtlasTexture.BindAsRenderTarget();
+	SetShadowMapClearColor();
+	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+	
+	for(std::map<const BaseLight*, ShadowMapCache*>::iterator it = m_shadowMapCaches.begin(); it != m_shadowMapCaches.end(); ++it)
+	{
+		for(int i = 0; i < MAX_SHADOW_CASCADES; i++)
+		{
+			it->second->dirty[i] = true;
+			it->second->rendered[i] = false;
+		}
+	}
+}
+
+void RenderingEngine::SetShadowMapClearColor() const
+{
+	if(m_exponentialShadows)
+	{
+		float positive = expf(EVSM_EXPONENT);
+		float negative = -expf(-EVSM_EXPONENT);
+		glClearColor(positive, positive * positive, negative, negative * negative);
+	}
+	else
+	{
+		glClearColor(1.0f,1.0f,0.0f,0.0f);
+	}
+}
+
+void RenderingEngine::SetShadowMap(const BaseLight& light)
+{
+	ShadowInfo shadowInfo = light.GetShadowInfo();
+	m_numCascades = 0;
+	
+	std::map<const BaseLight*, ShadowMapCache*>::const_iterator it = m_shadowMapCaches.find(&light);
+	if(shadowInfo.GetShadowMapSizeAsPowerOf2() == 0 || it == m_shadowMapCaches.end() || !it->second->rendered[0])
+	{
+		SetTexture("shadowMap", m_emptyShadowMap);
+		m_lightMatrix = Matrix4f().InitScale(Vector3f(0,0,0));
+		m_shadowAtlasRegion = Vector4f(0.0f, 0.0f, 1.0f, 1.0f);
+		SetFloat("shadowVarianceMin", 0.00002f);
+		SetFloat("shadowLightBleedingReduction", 0.0f);
+		SetFloat("shadowMapExponent", 0.0f);
+		SetFloat("shadowMipBias", 0.0f);
+		return;
+	}
+	
+	const ShadowMapCache& cache = *it->second;
+	SetTexture("shadowMap", m_shadowAtlasTexture);
+	SetFloat("shadowVarianceMin", shadowInfo.GetMinVariance());
+	SetFloat("shadowLightBleedingReduction", shadowInfo.GetLightBleedReductionAmount());
+	
+	//The blur spreads each texel over about 4 * softness texels, which is what the mip level
+	//log2 of that averages over.
+	float shadowSoftness = shadowInfo.GetShadowSoftness();
+	SetFloat("shadowMapExponent", m_exponentialShadows ? EVSM_EXPONENT : 0.0f);
+	SetFloat("shadowMipBias", shadowSoftness > 0.0f ? log2f(shadowSoftness * 4.0f) : 0.0f);
+	
+	//From the shadow map's texture coordinates to the atlas's.
+	float atlasSize = (float)m_shadowAtlas.GetSize();
+	float regionScale = (float)cache.region.size / atlasSize;
+	Vector3f regionOffset((float)cache.region.x / atlasSize, (float)cache.region.y / atlasSize, 0.0f);
+	Matrix4f region = Matrix4f().InitTranslation(regionOffset) * Matrix4f().InitScale(Vector3f(regionScale, regionScale, 1.0f));
+	m_shadowAtlasRegion = Vector4f(regionOffset.GetX(), regionOffset.GetY(), regionOffset.GetX() + regionScale, regionOffset.GetY() + regionScale);
+	
+	int numCascades = shadowInfo.GetNumCascades();
+	if(numCascades > 1)
+	{
+		for(int i = 0; i < numCascades; i++)
+		{
+			Matrix4f cascadeRegion = Matrix4f().InitTranslation(Vector3f((i % 2) * 0.5f, (i / 2) * 0.5f, 0.0f)) * Matrix4f().InitScale(Vector3f(0.5f, 0.5f, 1.0f));
+			m_cascadeMatrices[i] = region * cascadeRegion * BIAS_MATRIX * cache.viewProjections[i];
+			m_cascadeSplits[i] = cache.cascadeSplits[i];
+		}
+		
+		m_lightMatrix = m_cascadeMatrices[0];
+		m_numCascades = numCascades;
+	}
+	else
+	{
+		m_lightMatrix = region * BIAS_MATRIX * cache.viewProjections[0];
+	}
+}
+
+void RenderingEngine::SetShadowCamera(const ShadowInfo& shadowInfo, const ShadowAtlasRegion& region, int cascade, float& splitDistance)
+{
+	//Shadow cameras snap to the texels they're rendered into, so it's the size of the region that
+	//was allocated that matters, not the one that was asked for.
+	if(shadowInfo.GetNumCascades() > 1)
+	{
+		Matrix4f projection;
+		ShadowCameraTransform shadowCameraTransform = m_activeLight->CalcShadowCascade(*m_mainCamera, cascade, region.size / 2, projection, splitDistance);
+		m_altCamera.SetProjection(projection);
+		m_altCamera.GetTransform()->SetPos(shadowCameraTransform.GetPos());
+		m_altCamera.GetTransform()->SetRot(shadowCameraTransform.GetRot());
+	}
+	else
+	{
+		ShadowCameraTransform shadowCameraTransform = m_activeLight->CalcShadowCameraTransform(m_mainCamera->GetTransform().GetTransformedPos(), 
+			m_mainCamera->GetTransform().GetTransformedRot(), region.size);
+		m_altCamera.SetProjection(shadowInfo.GetProjection());
+		m_altCamera.GetTransform()->SetPos(shadowCameraTransform.GetPos());
+		m_altCamera.GetTransform()->SetRot(shadowCameraTransform.GetRot());
+		splitDistance = 0.0f;
+	}
+}
+
+RenderingEngine::ShadowMapCache& RenderingEngine::GetShadowMapCache(const BaseLight& light)
+{
+	std::map<const BaseLight*, ShadowMapCache*>::iterator it = m_shadowMapCaches.find(&light);
+	if(it != m_shadowMapCaches.end())
+	{
+		return *it->second;
+	}
+	
+	//Gets it's region from AllocateShadowMaps.
+	ShadowMapCache* cache = new ShadowMapCache();
+	for(int i = 0; i < MAX_SHADOW_CASCADES; i++)
+	{
+		cache->viewProjections[i] = Matrix4f().InitScale(Vector3f(0,0,0));
+		cache->cascadeSplits[i] = 0.0f;
+		cache->dirty[i] = true;
+		cache->rendered[i] = false;
+	}
+	
+	m_shadowMapCaches[&light] = cache;
+	return *cache;
+}
+
+void RenderingEngine::FindChangedShadowCasters()
+{
+	unsigned int count = (unsigned int)m_meshRenderers.size();
+	m_changedShadowCasterBounds.clear();
+	m_shadowCastersChanged = m_shadowCastersVersion != m_meshRenderersVersion;
+	
+	if(!m_shadowCastersChanged)
+	{
+		for(unsigned int i = 0; i < count; i++)
+		{
+			const float* oldBounds = &m_shadowCasterBounds[i * 4];
+			if(oldBounds[0] != m_boundsX[i] || oldBounds[1] != m_boundsY[i] || oldBounds[2] != m_boundsZ[i] || oldBounds[3] != m_boundsRadius[i])
+			{
+				const float newBounds[4] = { m_boundsX[i], m_boundsY[i], m_boundsZ[i], m_boundsRadius[i] };
+				m_changedShadowCasterBounds.insert(m_changedShadowCasterBounds.end(), oldBounds, oldBounds + 4);
+				m_changedShadowCasterBounds.insert(m_changedShadowCasterBounds.end(), newBounds, newBounds + 4);
+			}
+		}
+	}
+	
+	m_shadowCastersVersion = m_meshRenderersVersion;
+	m_shadowCasterBounds.resize(count * 4);
+	for(unsigned int i = 0; i < count; i++)
+	{
+		m_shadowCasterBounds[i * 4 + 0] = m_boundsX[i];
+		m_shadowCasterBounds[i * 4 + 1] = m_boundsY[i];
+		m_shadowCasterBounds[i * 4 + 2] = m_boundsZ[i];
+		m_shadowCasterBounds[i * 4 + 3] = m_boundsRadius[i];
+	}
+	
+	//Lights that aren't drawn this frame still have to notice the change when they next are.
+	for(std::map<const BaseLight*, ShadowMapCache*>::iterator it = m_shadowMapCaches.begin(); it != m_shadowMapCaches.end(); ++it)
+	{
+		ShadowMapCache& cache = *it->second;
+		for(int i = 0; i < MAX_SHADOW_CASCADES; i++)
+		{
+			if(cache.rendered[i] && !cache.dirty[i] && (m_shadowCastersChanged || ShadowCastersChanged(cache.viewProjections[i])))
+			{
+				cache.dirty[i] = true;
+			}
+		}
+	}
+}
+
+bool RenderingEngine::ShadowCastersChanged(const Matrix4f& viewProjection) const
+{
+	if(m_changedShadowCasterBounds.empty())
+	{
+		return false;
+	}
+	
+	Frustum frustum(viewProjection);
+	frustum.IgnorePlane(Frustum::PLANE_NEAR);
+	
+	for(unsigned int i = 0; i < m_changedShadowCasterBounds.size(); i += 4)
+	{
+		const float* bounds = &m_changedShadowCasterBounds[i];
+		if(frustum.IntersectsSphere(Vector3f(bounds[0], bounds[1], bounds[2]), bounds[3]))
+		{
+			return true;
+		}
+	}
+	
+	return false;
 }
@@ -9,20 +9,63 @@
 #include "mesh.h"
 #include "window.h"
 #include "profiling.h"
+#include "frustum.h"
+#include "renderQueue.h"
+#include "lightClusters.h"
+#include "shadowAtlas.h"
 #include <vector>
 #include <map>
 class Entity;
+class JobSystem;
+class MeshRenderer;
 
 class RenderingEngine : public MappedValues
 {
 public:
-	RenderingEngine(const Window& window);
-	virtual ~RenderingEngine() {}
+	//How lights are applied. Forward draws every object again for each light that reaches it.
+	//Deferred draws every object once, into a G-buffer, and then each light is drawn over the
+	//part of the screen it can reach, so it's cost depends on the number of pixels it covers.
+	//Clustered is forward, but point and spot lights without shadows are assigned to clusters of
+	//the view, and all of them are applied in the ambient pass, which only loops over the ones
+	//in each pixel's cluster.
+	enum RenderPath
+	{
+		RENDER_PATH_FORWARD,
+		RENDER_PATH_DEFERRED,
+		RENDER_PATH_CLUSTERED
+	};
+	
+	RenderingEngine(const Window& window, RenderPath renderPath = RENDER_PATH_FORWARD);
+	virtual ~RenderingEngine();
 	
 	void Render(const Entity& object);
 	
 	inline void AddLight(const BaseLight& light) { m_lights.push_back(&light); }
+	void RemoveLight(const BaseLight& light);
+	void AddMeshRenderer(const MeshRenderer& meshRenderer);
+	void RemoveMeshRenderer(const MeshRenderer& meshRenderer);
 	inline void SetMainCamera(const Camera& camera) { m_mainCamera = &camera; }
+	//Nothing is rendered without a main camera; the window is only cleared.
+	inline void RemoveMainCamera(const Camera& camera) { if(m_mainCamera == &camera) m_mainCamera = 0; }
+	inline void SetJobSystem(JobSystem* jobSystem)  { m_jobSystem = jobSystem; }
+	//When enabled, which is the default, each pass is sorted by state before it's submitted,
+	//so shaders, materials and meshes are only bound when they change. When disabled, every
+	//object binds everything again, as it's found, which is useful for comparison.
+	inline void SetSortDrawCalls(bool sortDrawCalls) { m_sortDrawCalls = sortDrawCalls; }
+	//When enabled, and supported, consecutive sorted draws of the same mesh and material are
+	//drawn with one instanced draw call, using the "-instanced" variant of the pass's shader.
+	//Where multi draw indirect is supported, all the meshes drawn with the same material are
+	//submitted with one multi draw.
+	inline void SetInstancing(bool instancing) { m_instancing = instancing && m_instancingSupported; }
+	inline bool IsInstancingEnabled() const    { return m_instancing; }
+	//When enabled, which is the default, shadow maps are exponential variance shadow maps in 16 bit
+	//floats, softened by sampling smaller mipmaps. When disabled, they're variance shadow maps in
+	//32 bit floats, blurred every time they're rendered. Every shadow map is rendered again.
+	void SetExponentialShadows(bool exponentialShadows);
+	
+	//Sets the object uniform block for an object drawn with camera. The frame and light blocks are
+	//set by Render, since they're the same for every object.
+	void UpdateObjectBlock(const Matrix4f& worldMatrix, const Camera& camera) const;
 	
 	virtual void UpdateUniformStruct(const Transform& transform, const Material& material, const Shader& shader, 
 		const std::string& uniformName, const std::string& uniformType) const
@@ -32,26 +75,78 @@ public:
 	
 	inline double DisplayRenderTime(double dividend) { return m_renderProfileTimer.DisplayAndReset("Render Time: ", dividend); }
 	inline double DisplayWindowSyncTime(double dividend) { return m_windowSyncProfileTimer.DisplayAndReset("Window Sync Time: ", dividend); }
+	//Part of the render time.
+	inline double DisplayShadowTime(double dividend) { return m_shadowProfileTimer.DisplayAndReset("    Shadow Map Time: ", dividend); }
+	void DisplayCullingStats(double dividend);
 	
 	inline const BaseLight& GetActiveLight()                           const { return *m_activeLight; }
 	inline unsigned int GetSamplerSlot(const std::string& samplerName) const { return m_samplerMap.find(samplerName)->second; }
 	inline const Matrix4f& GetLightMatrix()                            const { return m_lightMatrix; }
+	inline JobSystem* GetJobSystem()                                   const { return m_jobSystem; }
+	inline const Camera* GetMainCamera()                               const { return m_mainCamera; }
 protected:
 	inline void SetSamplerSlot(const std::string& name, unsigned int value) { m_samplerMap[name] = value; }
 private:
-	static const int NUM_SHADOW_MAPS = 10;
+	static const int SHADOW_ATLAS_SIZE = 2048;
+	static const int MIN_SHADOW_MAP_SIZE = 64;
 	static const Matrix4f BIAS_MATRIX;
+	static const float EVSM_EXPONENT; //The largest that keeps the squared warped depths in a 16 bit float
+	static const float LOD_SCREEN_SIZE; //The fraction of the screen's height below which meshes switch to LOD 1
+	static const float LOD_HYSTERESIS;  //How far past a threshold a mesh has to get to switch LODs
+	
+	enum
+	{
+		PASS_AMBIENT,
+		PASS_SHADOW,
+		PASS_LIGHT,
+		PASS_GEOMETRY
+	};
+	
+	//A light's shadow map, which is a region of the shadow atlas, kept between frames so it's
+	//only rendered again when something that can change it does. Each cascade is tracked
+	//separately.
+	struct ShadowMapCache
+	{
+		ShadowAtlasRegion region; //Empty if there wasn't any room
+		Matrix4f viewProjections[MAX_SHADOW_CASCADES]; //The shadow cameras the cascades were last rendered with
+		float    cascadeSplits[MAX_SHADOW_CASCADES];
+		bool     dirty[MAX_SHADOW_CASCADES];
+		bool     rendered[MAX_SHADOW_CASCADES]; //Whether the cascade has anything in it yet
+	};
+	
+	//A shadow map, or one cascade of one, that's rendered this frame, and the mesh renderers
+	//that can cast shadows into it.
+	struct ShadowView
+	{
+		const BaseLight*                 light;
+		ShadowMapCache*                  cache;
+		int                              cascade;
+		Frustum                          frustum;
+		std::vector<const MeshRenderer*> casters;
+		std::vector<unsigned char>       castersVisible;
+	};
 
 	ProfileTimer                        m_renderProfileTimer;
 	ProfileTimer                        m_windowSyncProfileTimer;
+	ProfileTimer                        m_shadowProfileTimer;
 	Transform                           m_planeTransform;
 	Mesh                                m_plane;
+	Transform                           m_lightVolumeTransform;
+	Mesh                                m_sphereVolume; //Around point lights, and spot lights too wide for a cone
+	Mesh                                m_coneVolume;   //Around spot lights, widened to their cone by the shader
 	
 	const Window*                       m_window;
 	Texture                             m_tempTarget;
 	Material                            m_planeMaterial;
-	Texture                             m_shadowMaps[NUM_SHADOW_MAPS];
-	Texture                             m_shadowMapTempTargets[NUM_SHADOW_MAPS];
+	Texture                             m_emptyShadowMap; //Bound for lights without shadows
+	Texture                             m_shadowAtlasTexture;
+	Texture                             m_shadowAtlasTempTarget;
+	ShadowAtlas                         m_shadowAtlas;
+	Vector4f                            m_shadowAtlasRegion; //The active light's region, in texture coordinates
+	std::map<const BaseLight*, ShadowMapCache*> m_shadowMapCaches;
+	std::vector<ShadowView>             m_shadowViews; //Only the first m_numShadowViews are used, the rest keep their memory
+	unsigned int                        m_numShadowViews;
+	bool                                m_exponentialShadows;
 	
 	Shader                              m_defaultShader;
 	Shader                              m_shadowMapShader;
@@ -59,6 +154,13 @@ private:
 	Shader                              m_gausBlurFilter;
 	Shader                              m_fxaaFilter;
 	Matrix4f                            m_lightMatrix;
+	Matrix4f                            m_cascadeMatrices[MAX_SHADOW_CASCADES];
+	float                               m_cascadeSplits[MAX_SHADOW_CASCADES];
+	int                                 m_numCascades; //0 if the active light's shadow map isn't split into cascades
+	
+	RenderPath                          m_renderPath;
+	Texture                             m_gBuffer; //Albedo, normal, specular and depth; only used by the deferred path
+	LightClusters*                      m_lightClusters; //Only used by the clustered path
 	
 	Transform                           m_altCameraTransform;
 	Camera                              m_altCamera;
@@ -66,11 +168,116 @@ private:
 	const BaseLight*                    m_activeLight;
 	std::vector<const BaseLight*>       m_lights;
 	std::map<std::string, unsigned int> m_samplerMap;
+	JobSystem*                          m_jobSystem;
+	
+	std::vector<const MeshRenderer*>    m_meshRenderers;
+	unsigned int                        m_meshRenderersVersion; //Goes up whenever m_meshRenderers is added to or removed from
+	std::vector<const MeshRenderer*>    m_visibleMeshRenderers; //The ones that passed culling this frame
+	std::vector<unsigned int>           m_visibleMeshRendererIndices;
+	std::vector<const MeshRenderer*>    m_litMeshRenderers;     //The visible ones the active light reaches
+	Frustum                             m_mainCameraFrustum;
+	
+	//World space bounding spheres of m_meshRenderers, one array per component so they can be
+	//tested four at a time. Padded to a multiple of 4 with spheres that are never visible.
+	std::vector<float>                  m_boundsX;
+	std::vector<float>                  m_boundsY;
+	std::vector<float>                  m_boundsZ;
+	std::vector<float>                  m_boundsRadius;
+	std::vector<unsigned char>          m_boundsVisible;
+	unsigned int                        m_numVisibleMeshRenderers; //Since the last DisplayCullingStats
+	unsigned int                        m_numCulledMeshRenderers;
+	unsigned int                        m_numDrawnLights;
+	unsigned int                        m_numSkippedLights;
+	unsigned int                        m_numLitMeshRenderers;
+	unsigned int                        m_numClusteredLights;
+	unsigned int                        m_numClusterLightIndices;
+	unsigned int                        m_numShadowMapsRendered; //Counting each cascade
+	unsigned int                        m_numShadowMapsCached;
+	unsigned int                        m_numShadowCasters;        //Drawn into the rendered shadow maps
+	unsigned int                        m_numCulledShadowCasters;
+	unsigned int                        m_frameIndex;
+	
+	//The version of m_meshRenderers and their bounding spheres, four floats each, as they were
+	//last frame, and the old and new spheres of the ones that moved since. Shadow maps these touch
+	//are dirty. Renderers are compared by version rather than by address, since the pools reuse
+	//the memory of removed ones.
+	unsigned int                        m_shadowCastersVersion;
+	std::vector<float>                  m_shadowCasterBounds;
+	std::vector<float>                  m_changedShadowCasterBounds;
+	bool                                m_shadowCastersChanged; //Set when renderers were added or removed
+	RenderQueue                         m_renderQueue;
+	bool                                m_sortDrawCalls;
+	bool                                m_instancing;
+	bool                                m_instancingSupported;
+	GLuint                              m_instanceBuffer;
+	std::vector<Matrix4f>               m_instanceMatrices;
+	bool                                m_multiDrawIndirectSupported;
+	GLuint                              m_drawIndirectBuffer;
+	std::vector<DrawElementsIndirectCommand> m_drawCommands;
+	std::vector<const Material*>        m_drawCommandMaterials;  //The material of each draw command
+	std::vector<GLenum>                 m_drawCommandIndexTypes; //And the index type of it's mesh
+	std::map<std::string, Shader*>      m_shaderVariants; //Loaded when they're first needed, by file name
+	GLuint                              m_uniformBlockBuffers[NUM_UNIFORM_BLOCK_BINDINGS];
 	
-	void BlurShadowMap(int shadowMapIndex, float blurAmount);
+	void RenderForward(const Entity& object, bool clusteredLights);
+	void RenderDeferred(const Entity& object);
+	//Gives every light with shadows a region of the atlas, and renders the parts of them that are
+	//out of date, before any lighting passes.
+	void RenderShadowMaps(const Entity& object);
+	void AllocateShadowMaps();
+	//How big light's shadow map should be, going by how much of the screen it covers.
+	int CalcShadowMapSize(const BaseLight& light) const;
+	//Adds a view for each of the active light's cascades that has to be rendered.
+	void FindShadowViews(ShadowMapCache& cache);
+	void CullShadowCasters(ShadowView& view);
+	void RenderShadowView(const ShadowView& view, const Entity& object);
+	//Creates the shadow atlas in the format m_exponentialShadows asks for, and clears it.
+	void CreateShadowAtlas();
+	//Sets the color a shadow map is cleared to, which is the furthest depth, so nothing is in shadow.
+	void SetShadowMapClearColor() const;
+	//Binds light's shadow map, and sets the light matrix, or the cascade matrices and splits.
+	void SetShadowMap(const BaseLight& light);
+	//Points m_altCamera at one of the active light's cascades, or it's whole shadow map if it
+	//doesn't have any. region is the part of the shadow atlas the light was given.
+	void SetShadowCamera(const ShadowInfo& shadowInfo, const ShadowAtlasRegion& region, int cascade, float& splitDistance);
+	ShadowMapCache& GetShadowMapCache(const BaseLight& light);
+	//Compares the mesh renderers' bounds with last frame's, after they've been culled.
+	void FindChangedShadowCasters();
+	//Whether any of the mesh renderers that moved can be seen from a shadow camera.
+	bool ShadowCastersChanged(const Matrix4f& viewProjection) const;
+	//Assigns the lights that can be clustered to clusters of the main camera's view. Returns
+	//false if that's not possible, in which case they're drawn in passes of their own.
+	bool AssignLightClusters();
+	bool IsClusteredLight(const BaseLight& light) const;
+	void UpdateFrameBlock(const Camera& camera);
+	void UpdateLightBlock(const BaseLight& light);
+	void CullMeshRenderers(const Camera& camera);
+	//Picks meshRenderer's LOD from it's bounding sphere's height on screen, as a fraction of the
+	//screen's.
+	void SelectLod(const MeshRenderer& meshRenderer, float screenSize) const;
+	//Collects the visible mesh renderers light reaches, and the part of the screen it can
+	//change, if that's less than all of it. Returns false if the light doesn't affect anything.
+	bool FindLitMeshRenderers(const BaseLight& light, const Camera& camera, int* scissorRect, bool& useScissor);
+	void DrawMeshRenderers(const std::vector<const MeshRenderer*>& meshRenderers, const Shader& shader, const Camera& camera, unsigned int pass);
+	void SubmitRenderQueue(const Shader& shader, const Camera& camera);
+	void SubmitRenderQueueInstanced(const Shader& shader, const Camera& camera);
+	const Shader& GetInstancedShader(const Shader& shader);
+	const Shader& GetDeferredLightShader(const BaseLight& light);
+	const Shader& GetShaderVariant(const std::string& fileName);
+	void BlurShadowMap(const Texture& shadowMap, const Texture& tempTarget, float blurAmount, int x, int y, int width, int height);
 	void ApplyFilter(const Shader& filter, const Texture& source, const Texture* dest);
+	void DrawFullScreenQuad(const Shader& shader);
+	//Draws the active light's deferred pass over the pixels whose surfaces are inside the volume
+	//around it's range. center and radius are it's bounding sphere.
+	void DrawLightVolume(const BaseLight& light, const Vector3f& center, float radius);
+	//A sphere of triangles that encloses the sphere of radius 1 around the origin.
+	static IndexedModel CreateSphereVolume(int numSlices, int numStacks);
+	//A cone of triangles, from the origin along +Z, that encloses the cone of length and base
+	//radius 1.
+	static IndexedModel CreateConeVolume(int numSlices);
 	
 	RenderingEngine(const RenderingEngine& other) :
+		m_shadowAtlas(1, 1),
 		m_altCamera(Matrix4f(),0){}
 	void operator=(const RenderingEngine& other) {}
 };
@@ -0,0 +1,492 @@
+#include "sceneFile.h"
+#include "camera.h"
+#include "entity.h"
+#include "entityComponent.h"
+#include "freeLook.h"
+#include "freeMove.h"
+#include "lighting.h"
+#include "mappedFile.h"
+#include "meshRenderer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+//--------------------------------------------------------------------------------
+// Forward declarations
+//--------------------------------------------------------------------------------
+static std::map<std::string, SceneComponentLoader>& GetComponentLoaders();
+static void WriteEntity(Entity* entity, unsigned int parent, std::vector<SceneFileEntity>& entities,
+	std::vector<SceneFileComponent>& components, std::vector<std::string>& typeNames, std::vector<unsigned char>& componentData);
+static void WriteTables(const std::vector<SceneFileEntity>& entities, std::vector<SceneFileComponent>& components,
+	const std::vector<std::string>& typeNames, std::vector<unsigned char>& componentData, std::vector<unsigned char>& result);
+static bool WriteFile(const std::vector<unsigned char>& data, const std::string& fileName);
+static unsigned int AppendBytes(std::vector<unsigned char>& data, const void* bytes, size_t size);
+
+static void LoadMeshRenderer(Entity* entity, SceneComponentReader& reader);
+static void LoadCameraComponent(Entity* entity, SceneComponentReader& reader);
+static void LoadFreeLook(Entity* entity, SceneComponentReader& reader);
+static void LoadFreeMove(Entity* entity, SceneComponentReader& reader);
+static void LoadDirectionalLight(Entity* entity, SceneComponentReader& reader);
+static void LoadPointLight(Entity* entity, SceneComponentReader& reader);
+static void LoadSpotLight(Entity* entity, SceneComponentReader& reader);
+
+//--------------------------------------------------------------------------------
+// SceneFile Implementation
+//--------------------------------------------------------------------------------
+bool SceneFile::Save(Entity& root, const std::string& fileName)
+{
+	std::vector<unsigned char> data;
+	Write(root, data);
+	return WriteFile(data, fileName);
+}
+
+bool SceneFile::Save(Entity* const* roots, unsigned int numRoots, const std::string& fileName)
+{
+	std::vector<unsigned char> data;
+	Write(roots, numRoots, data);
+	return WriteFile(data, fileName);
+}
+
+void SceneFile::Write(Entity& root, std::vector<unsigned char>& result)
+{
+	std::vector<SceneFileEntity> entities;
+	std::vector<SceneFileComponent> components;
+	std::vector<std::string> typeNames;
+	std::vector<unsigned char> componentData;
+
+	WriteEntity(&root, NO_PARENT, entities, components, typeNames, componentData);
+	WriteTables(entities, components, typeNames, componentData, result);
+}
+
+void SceneFile::Write(Entity* const* roots, unsigned int numRoots, std::vector<unsigned char>& result)
+{
+	std::vector<SceneFileEntity> entities;
+	std::vector<SceneFileComponent> components;
+	std::vector<std::string> typeNames;
+	std::vector<unsigned char> componentData;
+
+	//The entities are written as the children of an empty root with an identity transform, so
+	//they end up where they were when the root is attached to an untransformed entity.
+	SceneFileEntity fileRoot;
+	memset(&fileRoot, 0, sizeof(fileRoot));
+	fileRoot.rot[3] = 1.0f;
+	fileRoot.scale = 1.0f;
+	fileRoot.parent = NO_PARENT;
+	entities.push_back(fileRoot);
+
+	for(unsigned int i = 0; i < numRoots; i++)
+	{
+		WriteEntity(roots[i], 0, entities, components, typeNames, componentData);
+	}
+
+	WriteTables(entities, components, typeNames, componentData, result);
+}
+
+Entity* SceneFile::Load(const std::string& fileName, MemoryArena* arena)
+{
+	MappedFile file;
+	if(!file.Open(fileName))
+	{
+		return 0;
+	}
+
+	Entity* result = Instantiate(file.GetData(), file.GetSize(), arena);
+	if(result == 0)
+	{
+		std::cerr << "Error: " << fileName << " is not a valid scene file" << std::endl;
+	}
+
+	return result;
+}
+
+Entity* SceneFile::Instantiate(const void* data, size_t size, MemoryArena* arena)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	const SceneFileHeader* header = (const SceneFileHeader*)bytes;
+
+	if(size < sizeof(SceneFileHeader) || memcmp(header->magic, MAGIC, sizeof(header->magic)) != 0)
+	{
+		return 0;
+	}
+
+	if(header->version != VERSION)
+	{
+		std::cerr << "Error: Scene file version " << header->version << " is not supported" << std::endl;
+		return 0;
+	}
+
+	if(header->fileSize > size || header->numEntities == 0 ||
+	   header->entitiesOffset + (size_t)header->numEntities * sizeof(SceneFileEntity) > size ||
+	   header->componentsOffset + (size_t)header->numComponents * sizeof(SceneFileComponent) > size ||
+	   header->typesOffset + (size_t)header->numTypes * sizeof(SceneFileType) > size)
+	{
+		return 0;
+	}
+
+	const SceneFileEntity* entities = (const SceneFileEntity*)(bytes + header->entitiesOffset);
+	const SceneFileComponent* components = (const SceneFileComponent*)(bytes + header->componentsOffset);
+	const SceneFileType* types = (const SceneFileType*)(bytes + header->typesOffset);
+
+	//Type names are only looked up once per file, not once per component.
+	std::map<std::string, SceneComponentLoader>& registeredLoaders = GetComponentLoaders();
+	std::vector<SceneComponentLoader> loaders(header->numTypes);
+	for(unsigned int i = 0; i < header->numTypes; i++)
+	{
+		loaders[i] = 0;
+		if(types[i].nameOffset + (size_t)types[i].nameLength > size)
+		{
+			continue;
+		}
+
+		std::string typeName((const char*)(bytes + types[i].nameOffset), types[i].nameLength);
+		std::map<std::string, SceneComponentLoader>::const_iterator it = registeredLoaders.find(typeName);
+		if(it == registeredLoaders.end())
+		{
+			std::cerr << "Error: Scene component type " << typeName << " has not been registered" << std::endl;
+			continue;
+		}
+
+		loaders[i] = it->second;
+	}
+
+	std::vector<Entity*> createdEntities(header->numEntities);
+	for(unsigned int i = 0; i < header->numEntities; i++)
+	{
+		const SceneFileEntity& fileEntity = entities[i];
+
+		//Parents are always stored before their children, so a valid parent has been created already.
+		if((i == 0) != (fileEntity.parent == NO_PARENT) || (i != 0 && fileEntity.parent >= i))
+		{
+			std::cerr << "Error: Entity " << i << " in scene file has an invalid parent" << std::endl;
+			delete createdEntities[0];
+			return 0;
+		}
+
+		Entity* entity = Entity::Create(arena, Vector3f(fileEntity.pos[0], fileEntity.pos[1], fileEntity.pos[2]),
+			Quaternion(fileEntity.rot[0], fileEntity.rot[1], fileEntity.rot[2], fileEntity.rot[3]), fileEntity.scale);
+		createdEntities[i] = entity;
+
+		if(i != 0)
+		{
+			createdEntities[fileEntity.parent]->AddChild(entity);
+		}
+
+		for(unsigned int j = 0; j < fileEntity.numComponents; j++)
+		{
+			unsigned int componentIndex = fileEntity.firstComponent + j;
+			if(componentIndex >= header->numComponents)
+			{
+				break;
+			}
+
+			const SceneFileComponent& component = components[componentIndex];
+			if(component.type >= header->numTypes || loaders[component.type] == 0 ||
+			   component.dataOffset + (size_t)component.dataSize > size)
+			{
+				continue;
+			}
+
+			SceneComponentReader reader(bytes + component.dataOffset, component.dataSize);
+			loaders[component.type](entity, reader);
+
+			if(reader.HasFailed())
+			{
+				std::cerr << "Error: Component " << componentIndex << " in scene file is truncated or invalid" << std::endl;
+				delete createdEntities[0];
+				return 0;
+			}
+		}
+	}
+
+	return createdEntities[0];
+}
+
+void SceneFile::RegisterComponentType(const std::string& typeName, SceneComponentLoader loader)
+{
+	GetComponentLoaders()[typeName] = loader;
+}
+
+//--------------------------------------------------------------------------------
+// SceneComponentWriter/Reader Implementation
+//--------------------------------------------------------------------------------
+void SceneComponentWriter::WriteBytes(const void* bytes, size_t size)
+{
+	AppendBytes(m_data, bytes, size);
+}
+
+bool SceneComponentReader::ReadBytes(void* result, size_t size)
+{
+	if(m_failed || m_position + size > m_size)
+	{
+		memset(result, 0, size);
+		m_failed = true;
+		return false;
+	}
+
+	memcpy(result, m_data + m_position, size);
+	m_position += size;
+	return true;
+}
+
+Matrix4f SceneComponentReader::ReadMatrix4f()
+{
+	Matrix4f result;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		for(unsigned int j = 0; j < 4; j++)
+		{
+			result[i][j] = ReadFloat();
+		}
+	}
+
+	return result;
+}
+
+std::string SceneComponentReader::ReadString()
+{
+	int length = ReadInt();
+	if(length < 0 || m_position + length > m_size)
+	{
+		m_failed = true;
+		return "";
+	}
+
+	std::string result((const char*)(m_data + m_position), length);
+	m_position += length;
+	return result;
+}
+
+//--------------------------------------------------------------------------------
+// Static Function Implementations
+//--------------------------------------------------------------------------------
+static std::map<std::string, SceneComponentLoader>& GetComponentLoaders()
+{
+	//Created on first use, so games can register their own types during static initialization.
+	static std::map<std::string, SceneComponentLoader> loaders;
+	static bool registeredEngineTypes = false;
+
+	if(!registeredEngineTypes)
+	{
+		registeredEngineTypes = true;
+		loaders["MeshRenderer"] = &LoadMeshRenderer;
+		loaders["CameraComponent"] = &LoadCameraComponent;
+		loaders["FreeLook"] = &LoadFreeLook;
+		loaders["FreeMove"] = &LoadFreeMove;
+		loaders["DirectionalLight"] = &LoadDirectionalLight;
+		loaders["PointLight"] = &LoadPointLight;
+		loaders["SpotLight"] = &LoadSpotLight;
+	}
+
+	return loaders;
+}
+
+static void WriteEntity(Entity* entity, unsigned int parent, std::vector<SceneFileEntity>& entities,
+	std::vector<SceneFileComponent>& components, std::vector<std::string>& typeNames, std::vector<unsigned char>& componentData)
+{
+	const Transform& transform = *entity->GetTransform();
+	unsigned int index = (unsigned int)entities.size();
+
+	SceneFileEntity fileEntity;
+	fileEntity.pos[0] = transform.GetPos().GetX();
+	fileEntity.pos[1] = transform.GetPos().GetY();
+	fileEntity.pos[2] = transform.GetPos().GetZ();
+	fileEntity.rot[0] = transform.GetRot().GetX();
+	fileEntity.rot[1] = transform.GetRot().GetY();
+	fileEntity.rot[2] = transform.GetRot().GetZ();
+	fileEntity.rot[3] = transform.GetRot().GetW();
+	fileEntity.scale = transform.GetScale();
+	fileEntity.parent = parent;
+	fileEntity.firstComponent = (unsigned int)components.size();
+	fileEntity.numComponents = 0;
+
+	for(unsigned int i = 0; i < entity->GetNumComponents(); i++)
+	{
+		const EntityComponent* component = entity->GetComponent(i);
+		const char* typeName = component->GetSceneTypeName();
+		if(typeName == 0)
+		{
+			continue;
+		}
+
+		SceneFileComponent fileComponent;
+		fileComponent.type = 0;
+		while(fileComponent.type < typeNames.size() && typeNames[fileComponent.type] != typeName)
+		{
+			fileComponent.type++;
+		}
+
+		if(fileComponent.type == typeNames.size())
+		{
+			typeNames.push_back(typeName);
+		}
+
+		//Every component's data starts on a 4 byte boundary, so it can be read in place.
+		while(componentData.size() % 4 != 0)
+		{
+			componentData.push_back(0);
+		}
+
+		fileComponent.dataOffset = (unsigned int)componentData.size();
+		SceneComponentWriter writer(componentData);
+		component->WriteToScene(writer);
+		fileComponent.dataSize = (unsigned int)componentData.size() - fileComponent.dataOffset;
+
+		components.push_back(fileComponent);
+		fileEntity.numComponents++;
+	}
+
+	entities.push_back(fileEntity);
+
+	for(unsigned int i = 0; i < entity->GetNumChildren(); i++)
+	{
+		WriteEntity(entity->GetChild(i), index, entities, components, typeNames, componentData);
+	}
+}
+
+static void WriteTables(const std::vector<SceneFileEntity>& entities, std::vector<SceneFileComponent>& components,
+	const std::vector<std::string>& typeNames, std::vector<unsigned char>& componentData, std::vector<unsigned char>& result)
+{
+	//Component data and type names are written as one blob after all the tables, so their
+	//offsets still have to be moved to where the blob ends up.
+	SceneFileHeader header;
+	memcpy(header.magic, SceneFile::MAGIC, sizeof(header.magic));
+	header.version = SceneFile::VERSION;
+	header.numEntities = (unsigned int)entities.size();
+	header.entitiesOffset = sizeof(SceneFileHeader);
+	header.numComponents = (unsigned int)components.size();
+	header.componentsOffset = header.entitiesOffset + header.numEntities * sizeof(SceneFileEntity);
+	header.numTypes = (unsigned int)typeNames.size();
+	header.typesOffset = header.componentsOffset + header.numComponents * sizeof(SceneFileComponent);
+
+	unsigned int blobOffset = header.typesOffset + header.numTypes * sizeof(SceneFileType);
+
+	for(unsigned int i = 0; i < components.size(); i++)
+	{
+		components[i].dataOffset += blobOffset;
+	}
+
+	std::vector<SceneFileType> types(typeNames.size());
+	for(unsigned int i = 0; i < typeNames.size(); i++)
+	{
+		types[i].nameLength = (unsigned int)typeNames[i].length();
+		types[i].nameOffset = blobOffset + AppendBytes(componentData, typeNames[i].c_str(), typeNames[i].length());
+	}
+
+	header.fileSize = blobOffset + (unsigned int)componentData.size();
+
+	result.clear();
+	result.reserve(header.fileSize);
+	AppendBytes(result, &header, sizeof(header));
+	AppendBytes(result, entities.empty() ? 0 : &entities[0], entities.size() * sizeof(SceneFileEntity));
+	AppendBytes(result, components.empty() ? 0 : &components[0], components.size() * sizeof(SceneFileComponent));
+	AppendBytes(result, types.empty() ? 0 : &types[0], types.size() * sizeof(SceneFileType));
+	AppendBytes(result, componentData.empty() ? 0 : &componentData[0], componentData.size());
+}
+
+static bool WriteFile(const std::vector<unsigned char>& data, const std::string& fileName)
+{
+	FILE* file = fopen(fileName.c_str(), "wb");
+	if(file == 0)
+	{
+		std::cerr << "Error: Unable to write scene file " << fileName << std::endl;
+		return false;
+	}
+
+	bool succeeded = fwrite(&data[0], 1, data.size(), file) == data.size();
+	succeeded = fclose(file) == 0 && succeeded;
+
+	if(!succeeded)
+	{
+		std::cerr << "Error: Unable to write scene file " << fileName << std::endl;
+	}
+
+	return succeeded;
+}
+
+static unsigned int AppendBytes(std::vector<unsigned char>& data, const void* bytes, size_t size)
+{
+	unsigned int offset = (unsigned int)data.size();
+	if(size > 0)
+	{
+		data.insert(data.end(), (const unsigned char*)bytes, (const unsigned char*)bytes + size);
+	}
+
+	return offset;
+}
+
+static void LoadMeshRenderer(Entity* entity, SceneComponentReader& reader)
+{
+	std::string meshName = reader.ReadString();
+	std::string materialName = reader.ReadString();
+
+	//Meshes are loaded from disk when they're first used, but an empty name isn't a file.
+	if(reader.HasFailed() || meshName.empty() || !Material::Exists(materialName))
+	{
+		reader.Fail();
+		return;
+	}
+
+	entity->CreateComponent<MeshRenderer>(Mesh(meshName), Material(materialName));
+}
+
+static void LoadCameraComponent(Entity* entity, SceneComponentReader& reader)
+{
+	entity->CreateComponent<CameraComponent>(reader.ReadMatrix4f());
+}
+
+static void LoadFreeLook(Entity* entity, SceneComponentReader& reader)
+{
+	Vector2f windowCenter = reader.ReadVector2f();
+	float sensitivity = reader.ReadFloat();
+	int unlockMouseKey = reader.ReadInt();
+	entity->CreateComponent<FreeLook>(windowCenter, sensitivity, unlockMouseKey);
+}
+
+static void LoadFreeMove(Entity* entity, SceneComponentReader& reader)
+{
+	float speed = reader.ReadFloat();
+	int forwardKey = reader.ReadInt();
+	int backKey = reader.ReadInt();
+	int leftKey = reader.ReadInt();
+	int rightKey = reader.ReadInt();
+	entity->CreateComponent<FreeMove>(speed, forwardKey, backKey, leftKey, rightKey);
+}
+
+static void LoadDirectionalLight(Entity* entity, SceneComponentReader& reader)
+{
+	Vector3f color = reader.ReadVector3f();
+	float intensity = reader.ReadFloat();
+	int shadowMapSizeAsPowerOf2 = reader.ReadInt();
+	float shadowArea = reader.ReadFloat();
+	float shadowSoftness = reader.ReadFloat();
+	float lightBleedReductionAmount = reader.ReadFloat();
+	float minVariance = reader.ReadFloat();
+	int numCascades = reader.ReadInt();
+	entity->CreateComponent<DirectionalLight>(color, intensity, shadowMapSizeAsPowerOf2, shadowArea, shadowSoftness,
+		lightBleedReductionAmount, minVariance, numCascades);
+}
+
+static void LoadPointLight(Entity* entity, SceneComponentReader& reader)
+{
+	Vector3f color = reader.ReadVector3f();
+	float intensity = reader.ReadFloat();
+	Vector3f attenuation = reader.ReadVector3f();
+	entity->CreateComponent<PointLight>(color, intensity, Attenuation(attenuation.GetX(), attenuation.GetY(), attenuation.GetZ()));
+}
+
+static void LoadSpotLight(Entity* entity, SceneComponentReader& reader)
+{
+	Vector3f color = reader.ReadVector3f();
+	float intensity = reader.ReadFloat();
+	Vector3f attenuation = reader.ReadVector3f();
+	float viewAngle = reader.ReadFloat();
+	int shadowMapSizeAsPowerOf2 = reader.ReadInt();
+	float shadowSoftness = reader.ReadFloat();
+	float lightBleedReductionAmount = reader.ReadFloat();
+	float minVariance = reader.ReadFloat();
+	entity->CreateComponent<SpotLight>(color, intensity, Attenuation(attenuation.GetX(), attenuation.GetY(), attenuation.GetZ()),
+		viewAngle, shadowMapSizeAsPowerOf2, shadowSoftness, lightBleedReductionAmount, minVariance);
+}
@@ -0,0 +1,147 @@
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+#include "math3d.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Entity;
+class MemoryArena;
+class SceneComponentReader;
+
+//Binary scene files store an entity hierarchy, with transforms and component data, laid out so
+//that a memory mapped file can be instantiated directly, without parsing. All offsets are in
+//bytes from the start of the file, so the data doesn't depend on where it is mapped. Values are
+//stored in the native byte order, which is little endian on every platform the engine runs on.
+//
+//  SceneFileHeader
+//  SceneFileEntity    entities[numEntities]     (parents always come before their children)
+//  SceneFileComponent components[numComponents] (grouped by entity)
+//  SceneFileType      types[numTypes]
+//  Component data and type names
+struct SceneFileHeader
+{
+	char         magic[4];
+	unsigned int version;
+	unsigned int fileSize;
+	unsigned int numEntities;
+	unsigned int entitiesOffset;
+	unsigned int numComponents;
+	unsigned int componentsOffset;
+	unsigned int numTypes;
+	unsigned int typesOffset;
+};
+
+struct SceneFileEntity
+{
+	float        pos[3];
+	float        rot[4];
+	float        scale;
+	unsigned int parent;         //Index of the parent entity, or SceneFile::NO_PARENT for the scene's root
+	unsigned int firstComponent;
+	unsigned int numComponents;
+};
+
+struct SceneFileComponent
+{
+	unsigned int type;       //Index into the type table
+	unsigned int dataOffset;
+	unsigned int dataSize;
+};
+
+struct SceneFileType
+{
+	unsigned int nameOffset;
+	unsigned int nameLength;
+};
+
+//Creates a component from the data written by it's WriteToScene, and adds it to the entity. Data
+//that can't be used should be reported with SceneComponentReader::Fail, rather than creating
+//the component anyway.
+typedef void (*SceneComponentLoader)(Entity* entity, SceneComponentReader& reader);
+
+namespace SceneFile
+{
+	static const char MAGIC[4] = { 'S', 'C', 'N', 'E' };
+	static const unsigned int VERSION = 2;
+	static const unsigned int NO_PARENT = 0xFFFFFFFF;
+
+	//Writes root and everything attached to it. Components that don't have a scene type name
+	//are left out.
+	bool Save(Entity& root, const std::string& fileName);
+	void Write(Entity& root, std::vector<unsigned char>& result);
+
+	//Writes several entities, and everything attached to them, as the children of a new root with
+	//an identity transform. Used to split a scene into several files.
+	bool Save(Entity* const* roots, unsigned int numRoots, const std::string& fileName);
+	void Write(Entity* const* roots, unsigned int numRoots, std::vector<unsigned char>& result);
+
+	//Creates a copy of the scene that was saved; the returned entity is the root that was passed
+	//to Save. If an arena is given, every entity and component is allocated from it. Meshes and
+	//materials used by the scene have to be loaded or created beforehand. Truncated or corrupt
+	//files, and files naming materials that don't exist, return 0 and create nothing.
+	Entity* Load(const std::string& fileName, MemoryArena* arena = 0);
+	Entity* Instantiate(const void* data, size_t size, MemoryArena* arena = 0);
+
+	//Components written with type name typeName are created by loader. The engine's own
+	//components are registered automatically.
+	void RegisterComponentType(const std::string& typeName, SceneComponentLoader loader);
+};
+
+//Used by components to write themselves into a scene file.
+class SceneComponentWriter
+{
+public:
+	SceneComponentWriter(std::vector<unsigned char>& data) :
+		m_data(data) {}
+
+	void WriteBytes(const void* bytes, size_t size);
+
+	inline void WriteInt(int value)                   { WriteBytes(&value, sizeof(value)); }
+	inline void WriteFloat(float value)               { WriteBytes(&value, sizeof(value)); }
+	inline void WriteVector2f(const Vector2f& value)  { WriteFloat(value.GetX()); WriteFloat(value.GetY()); }
+	inline void WriteVector3f(const Vector3f& value)  { WriteFloat(value.GetX()); WriteFloat(value.GetY()); WriteFloat(value.GetZ()); }
+	inline void WriteMatrix4f(const Matrix4f& value)  { for(unsigned int i = 0; i < 4; i++) for(unsigned int j = 0; j < 4; j++) WriteFloat(value[i][j]); }
+	inline void WriteString(const std::string& value) { WriteInt((int)value.length()); WriteBytes(value.c_str(), value.length()); }
+protected:
+private:
+	std::vector<unsigned char>& m_data;
+
+	void operator=(const SceneComponentWriter& other) {}
+};
+
+//Used by component loaders to read back what the component wrote. Reads go straight to the
+//mapped file. Reading past the end of a component's data returns zeroes and marks the reader
+//as failed, so broken files can't crash the loader.
+class SceneComponentReader
+{
+public:
+	SceneComponentReader(const unsigned char* data, size_t size) :
+		m_data(data),
+		m_size(size),
+		m_position(0),
+		m_failed(false) {}
+
+	bool ReadBytes(void* result, size_t size);
+
+	inline int ReadInt()             { int result = 0; ReadBytes(&result, sizeof(result)); return result; }
+	inline float ReadFloat()         { float result = 0; ReadBytes(&result, sizeof(result)); return result; }
+	inline Vector2f ReadVector2f()   { float x = ReadFloat(); float y = ReadFloat(); return Vector2f(x, y); }
+	inline Vector3f ReadVector3f()   { float x = ReadFloat(); float y = ReadFloat(); float z = ReadFloat(); return Vector3f(x, y, z); }
+	Matrix4f ReadMatrix4f();
+	std::string ReadString();
+
+	//Loaders call Fail when what they read can't be used, such as the name of a material that
+	//doesn't exist. SceneFile::Instantiate rejects the whole file if any reader has failed.
+	inline void Fail()            { m_failed = true; }
+	inline bool HasFailed() const { return m_failed; }
+protected:
+private:
+	const unsigned char* m_data;
+	size_t               m_size;
+	size_t               m_position;
+	bool                 m_failed;
+};
+
+#endif // SCENEFILE_H
@@ -1,8 +1,10 @@
 #include "shader.h"
 #include "profiling.h"
+#include "glState.h"
 #include "lighting.h"
 #include "util.h"
 #include "renderingEngine.h"
+#include "timing.h"
 
 #include <cassert>
 #include <fstream>
@@ -11,6 +13,8 @@
 #include <cstdlib>
 #include <cstring>
 #include <sstream>
+#include <algorithm>
+#include <cctype>
 
 //--------------------------------------------------------------------------------
 // Variable Initializations
@@ -18,6 +22,7 @@
 std::map<std::string, ShaderData*> Shader::s_resourceMap;
 int ShaderData::s_supportedOpenGLLevel = 0;
 std::string ShaderData::s_glslVersion = "";
+unsigned int ShaderData::s_numShaders = 0;
 
 //--------------------------------------------------------------------------------
 // Forward declarations
@@ -27,11 +32,14 @@ static std::vector<UniformStruct> FindUniformStructs(const std::string& shaderTe
 static std::string FindUniformStructName(const std::string& structStartToOpeningBrace);
 static std::vector<TypedData> FindUniformStructComponents(const std::string& openingBraceToClosingBrace);
 static std::string LoadShader(const std::string& fileName);
+static int ResolveSamplerSlot(const UniformBinder& binder, const RenderingEngine& renderingEngine);
 
 //--------------------------------------------------------------------------------
 // Constructors/Destructors
 //--------------------------------------------------------------------------------
-ShaderData::ShaderData(const std::string& fileName)
+ShaderData::ShaderData(const std::string& fileName) :
+	m_sortId(s_numShaders++),
+	m_usesObjectBlock(false)
 {
 	std::string actualFileName = fileName;
 	#if PROFILING_DISABLE_SHADING != 0
@@ -100,10 +108,12 @@ ShaderData::ShaderData(const std::string& fileName)
 	
 	std::string attributeKeyword = "attribute";
 	AddAllAttributes(vertexShaderText, attributeKeyword);
+	AddFragOutputs();
 	
 	CompileShader();
 	
 	AddShaderUniforms(shaderText);
+	AddUniformBinders();
 }
 
 ShaderData::~ShaderData()
@@ -113,7 +123,7 @@ ShaderData::~ShaderData()
 		glDetachShader(m_program,*it);
 		glDeleteShader(*it);
 	}
-	glDeleteProgram(m_program);
+	GLState::DeleteProgram(m_program);
 }
 
 Shader::Shader(const std::string& fileName)
@@ -156,76 +166,137 @@ Shader::~Shader()
 //--------------------------------------------------------------------------------
 void Shader::Bind() const
 {
-	glUseProgram(m_shaderData->GetProgram());
+	GLState::UseProgram(m_shaderData->GetProgram());
 }
 
 void Shader::UpdateUniforms(const Transform& transform, const Material& material, const RenderingEngine& renderingEngine, const Camera& camera) const
 {
-	Matrix4f worldMatrix = transform.GetTransformation();
-	Matrix4f projectedMatrix = camera.GetViewProjection() * worldMatrix;
+	UpdateMaterialUniforms(material, renderingEngine, camera);
+	UpdateObjectUniforms(transform, material, renderingEngine, camera);
+}
+
+void Shader::UpdateMaterialUniforms(const Material& material, const RenderingEngine& renderingEngine, const Camera& camera) const
+{
+	const std::vector<UniformBinder>& binders = m_shaderData->GetMaterialBinders();
+	double startTime = Time::GetTime();
 	
-	for(unsigned int i = 0; i < m_shaderData->GetUniformNames().size(); i++)
+	for(unsigned int i = 0; i < binders.size(); i++)
 	{
-		std::string uniformName = m_shaderData->GetUniformNames()[i];
-		std::string uniformType = m_shaderData->GetUniformTypes()[i];
+		const UniformBinder& binder = binders[i];
+		int location = binder.GetLocation();
 		
-		if(uniformName.substr(0, 2) == "R_")
+		switch(binder.GetSource())
 		{
-			std::string unprefixedName = uniformName.substr(2, uniformName.length());
-			
-			if(unprefixedName == "lightMatrix")
-				SetUniformMatrix4f(uniformName, renderingEngine.GetLightMatrix() * worldMatrix);
-			else if(uniformType == "sampler2D")
-			{
-				int samplerSlot = renderingEngine.GetSamplerSlot(unprefixedName);
-				renderingEngine.GetTexture(unprefixedName).Bind(samplerSlot);
-				SetUniformi(uniformName, samplerSlot);
-			}
-			else if(uniformType == "vec3")
-				SetUniformVector3f(uniformName, renderingEngine.GetVector3f(unprefixedName));
-			else if(uniformType == "float")
-				SetUniformf(uniformName, renderingEngine.GetFloat(unprefixedName));
-			else if(uniformType == "DirectionalLight")
-				SetUniformDirectionalLight(uniformName, *(const DirectionalLight*)&renderingEngine.GetActiveLight());
-			else if(uniformType == "PointLight")
-				SetUniformPointLight(uniformName, *(const PointLight*)&renderingEngine.GetActiveLight());
-			else if(uniformType == "SpotLight")
-				SetUniformSpotLight(uniformName, *(const SpotLight*)&renderingEngine.GetActiveLight());
-			else
-				renderingEngine.UpdateUniformStruct(transform, material, *this, uniformName, uniformType);
-		}
-		else if(uniformType == "sampler2D")
+		case UniformBinder::SOURCE_WORLD_LIGHT_MATRIX:
+			glUniformMatrix4fv(location, 1, GL_FALSE, &(renderingEngine.GetLightMatrix()[0][0]));
+			break;
+		case UniformBinder::SOURCE_CAMERA_EYE_POS:
+			SetUniformVector3f(location, camera.GetTransform().GetTransformedPos());
+			break;
+		case UniformBinder::SOURCE_CAMERA_VIEW_PROJECTION:
 		{
-			int samplerSlot = renderingEngine.GetSamplerSlot(uniformName);
-			material.GetTexture(uniformName).Bind(samplerSlot);
-			SetUniformi(uniformName, samplerSlot);
+			Matrix4f viewProjection = camera.GetViewProjection();
+			glUniformMatrix4fv(location, 1, GL_FALSE, &(viewProjection[0][0]));
+			break;
 		}
-		else if(uniformName.substr(0, 2) == "T_")
-		{
-			if(uniformName == "T_MVP")
-				SetUniformMatrix4f(uniformName, projectedMatrix);
-			else if(uniformName == "T_model")
-				SetUniformMatrix4f(uniformName, worldMatrix);
-			else
-				throw "Invalid Transform Uniform: " + uniformName;
+		case UniformBinder::SOURCE_ENGINE_SAMPLER:
+			renderingEngine.GetTexture(binder.GetValueId()).Bind(ResolveSamplerSlot(binder, renderingEngine));
+			break;
+		case UniformBinder::SOURCE_ENGINE_VECTOR3F:
+			SetUniformVector3f(location, renderingEngine.GetVector3f(binder.GetValueId()));
+			break;
+		case UniformBinder::SOURCE_ENGINE_FLOAT:
+			glUniform1f(location, renderingEngine.GetFloat(binder.GetValueId()));
+			break;
+		case UniformBinder::SOURCE_MATERIAL_SAMPLER:
+			material.GetTexture(binder.GetValueId()).Bind(ResolveSamplerSlot(binder, renderingEngine));
+			break;
+		case UniformBinder::SOURCE_MATERIAL_VECTOR3F:
+			SetUniformVector3f(location, material.GetVector3f(binder.GetValueId()));
+			break;
+		case UniformBinder::SOURCE_MATERIAL_FLOAT:
+			glUniform1f(location, material.GetFloat(binder.GetValueId()));
+			break;
+		case UniformBinder::SOURCE_LIGHT_COLOR:
+			SetUniformVector3f(location, renderingEngine.GetActiveLight().GetColor());
+			break;
+		case UniformBinder::SOURCE_LIGHT_INTENSITY:
+			glUniform1f(location, renderingEngine.GetActiveLight().GetIntensity());
+			break;
+		case UniformBinder::SOURCE_LIGHT_DIRECTION:
+			SetUniformVector3f(location, renderingEngine.GetActiveLight().GetTransform().GetTransformedRot().GetForward());
+			break;
+		case UniformBinder::SOURCE_LIGHT_POSITION:
+			SetUniformVector3f(location, renderingEngine.GetActiveLight().GetTransform().GetTransformedPos());
+			break;
+		case UniformBinder::SOURCE_LIGHT_ATTEN_CONSTANT:
+			glUniform1f(location, ((const PointLight*)&renderingEngine.GetActiveLight())->GetAttenuation().GetConstant());
+			break;
+		case UniformBinder::SOURCE_LIGHT_ATTEN_LINEAR:
+			glUniform1f(location, ((const PointLight*)&renderingEngine.GetActiveLight())->GetAttenuation().GetLinear());
+			break;
+		case UniformBinder::SOURCE_LIGHT_ATTEN_EXPONENT:
+			glUniform1f(location, ((const PointLight*)&renderingEngine.GetActiveLight())->GetAttenuation().GetExponent());
+			break;
+		case UniformBinder::SOURCE_LIGHT_RANGE:
+			glUniform1f(location, ((const PointLight*)&renderingEngine.GetActiveLight())->GetRange());
+			break;
+		case UniformBinder::SOURCE_LIGHT_CUTOFF:
+			glUniform1f(location, ((const SpotLight*)&renderingEngine.GetActiveLight())->GetCutoff());
+			break;
+		default:
+			assert(0 != 0);
 		}
-		else if(uniformName.substr(0, 2) == "C_")
+	}
+	
+	RenderCounters::uniformUpdateTime += Time::GetTime() - startTime;
+}
+
+void Shader::UpdateObjectUniforms(const Transform& transform, const Material& material, const RenderingEngine& renderingEngine, const Camera& camera) const
+{
+	const std::vector<UniformBinder>& binders = m_shaderData->GetObjectBinders();
+	if(binders.empty())
+	{
+		return;
+	}
+	
+	double startTime = Time::GetTime();
+	Matrix4f worldMatrix = transform.GetTransformation();
+	
+	for(unsigned int i = 0; i < binders.size(); i++)
+	{
+		const UniformBinder& binder = binders[i];
+		int location = binder.GetLocation();
+		
+		switch(binder.GetSource())
 		{
-			if(uniformName == "C_eyePos")
-				SetUniformVector3f(uniformName, camera.GetTransform().GetTransformedPos());
-			else
-				throw "Invalid Camera Uniform: " + uniformName;
+		case UniformBinder::SOURCE_TRANSFORM_MVP:
+		{
+			Matrix4f projectedMatrix = camera.GetViewProjection() * worldMatrix;
+			glUniformMatrix4fv(location, 1, GL_FALSE, &(projectedMatrix[0][0]));
+			break;
 		}
-		else
+		case UniformBinder::SOURCE_TRANSFORM_MODEL:
+			glUniformMatrix4fv(location, 1, GL_FALSE, &(worldMatrix[0][0]));
+			break;
+		case UniformBinder::SOURCE_LIGHT_MATRIX:
 		{
-			if(uniformType == "vec3")
-				SetUniformVector3f(uniformName, material.GetVector3f(uniformName));
-			else if(uniformType == "float")
-				SetUniformf(uniformName, material.GetFloat(uniformName));
-			else
-				throw uniformType + " is not supported by the Material class";
+			Matrix4f lightMatrix = renderingEngine.GetLightMatrix() * worldMatrix;
+			glUniformMatrix4fv(location, 1, GL_FALSE, &(lightMatrix[0][0]));
+			break;
+		}
+		case UniformBinder::SOURCE_ENGINE_STRUCT:
+			renderingEngine.UpdateUniformStruct(transform, material, *this, binder.GetValueName(), binder.GetType());
+			break;
+		case UniformBinder::SOURCE_OBJECT_BLOCK:
+			renderingEngine.UpdateObjectBlock(worldMatrix, camera);
+			break;
+		default:
+			assert(0 != 0);
 		}
 	}
+	
+	RenderCounters::uniformUpdateTime += Time::GetTime() - startTime;
 }
 
 void Shader::SetUniformi(const std::string& uniformName, int value) const
@@ -240,43 +311,17 @@ void Shader::SetUniformf(const std::string& uniformName, float value) const
 
 void Shader::SetUniformVector3f(const std::string& uniformName, const Vector3f& value) const
 {
-	glUniform3f(m_shaderData->GetUniformMap().at(uniformName), value.GetX(), value.GetY(), value.GetZ());
-}
-
-void Shader::SetUniformMatrix4f(const std::string& uniformName, const Matrix4f& value) const
-{
-	glUniformMatrix4fv(m_shaderData->GetUniformMap().at(uniformName), 1, GL_FALSE, &(value[0][0]));
+	SetUniformVector3f(m_shaderData->GetUniformMap().at(uniformName), value);
 }
 
-void Shader::SetUniformDirectionalLight(const std::string& uniformName, const DirectionalLight& directionalLight) const
+void Shader::SetUniformVector3f(int location, const Vector3f& value)
 {
-	SetUniformVector3f(uniformName + ".direction", directionalLight.GetTransform().GetTransformedRot().GetForward());
-	SetUniformVector3f(uniformName + ".base.color", directionalLight.GetColor());
-	SetUniformf(uniformName + ".base.intensity", directionalLight.GetIntensity());
+	glUniform3f(location, value.GetX(), value.GetY(), value.GetZ());
 }
 
-void Shader::SetUniformPointLight(const std::string& uniformName, const PointLight& pointLight) const
-{
-	SetUniformVector3f(uniformName + ".base.color", pointLight.GetColor());
-	SetUniformf(uniformName + ".base.intensity", pointLight.GetIntensity());
-	SetUniformf(uniformName + ".atten.constant", pointLight.GetAttenuation().GetConstant());
-	SetUniformf(uniformName + ".atten.linear", pointLight.GetAttenuation().GetLinear());
-	SetUniformf(uniformName + ".atten.exponent", pointLight.GetAttenuation().GetExponent());
-	SetUniformVector3f(uniformName + ".position", pointLight.GetTransform().GetTransformedPos());
-	SetUniformf(uniformName + ".range", pointLight.GetRange());
-}
-
-void Shader::SetUniformSpotLight(const std::string& uniformName, const SpotLight& spotLight) const
+void Shader::SetUniformMatrix4f(const std::string& uniformName, const Matrix4f& value) const
 {
-	SetUniformVector3f(uniformName + ".pointLight.base.color", spotLight.GetColor());
-	SetUniformf(uniformName + ".pointLight.base.intensity", spotLight.GetIntensity());
-	SetUniformf(uniformName + ".pointLight.atten.constant", spotLight.GetAttenuation().GetConstant());
-	SetUniformf(uniformName + ".pointLight.atten.linear", spotLight.GetAttenuation().GetLinear());
-	SetUniformf(uniformName + ".pointLight.atten.exponent", spotLight.GetAttenuation().GetExponent());
-	SetUniformVector3f(uniformName + ".pointLight.position", spotLight.GetTransform().GetTransformedPos());
-	SetUniformf(uniformName + ".pointLight.range", spotLight.GetRange());
-	SetUniformVector3f(uniformName + ".direction", spotLight.GetTransform().GetTransformedRot().GetForward());
-	SetUniformf(uniformName + ".cutoff", spotLight.GetCutoff());
+	glUniformMatrix4fv(m_shaderData->GetUniformMap().at(uniformName), 1, GL_FALSE, &(value[0][0]));
 }
 
 void ShaderData::AddVertexShader(const std::string& text)
@@ -362,6 +407,24 @@ void ShaderData::AddAllAttributes(const std::string& vertexShaderText, const std
 	}
 }
 
+void ShaderData::AddFragOutputs()
+{
+	//Below GLSL 1.50, outputs are written to gl_FragData, which is already indexed. Otherwise,
+	//DeclareFragOutput in common.glh names them outputLocation0, outputLocation1 and so on,
+	//which have to be given the matching locations, so they go to the right draw buffers.
+	if(s_supportedOpenGLLevel < 320)
+	{
+		return;
+	}
+	
+	for(unsigned int i = 0; i < MAX_FRAG_OUTPUTS; i++)
+	{
+		std::ostringstream outputName;
+		outputName << "outputLocation" << i;
+		glBindFragDataLocation(m_program, i, outputName.str().c_str());
+	}
+}
+
 void ShaderData::AddShaderUniforms(const std::string& shaderText)
 {
 	static const std::string UNIFORM_KEY = "uniform";
@@ -384,6 +447,18 @@ void ShaderData::AddShaderUniforms(const std::string& shaderText)
 		{
 			size_t begin = uniformLocation + UNIFORM_KEY.length();
 			size_t end = shaderText.find(";", begin);
+			size_t blockBegin = shaderText.find("{", begin);
+			
+			//Uniform blocks are bound as a whole, rather than member by member.
+			if(blockBegin < end)
+			{
+				std::string blockName = shaderText.substr(begin, blockBegin - begin);
+				blockName.erase(std::remove_if(blockName.begin(), blockName.end(), ::isspace), blockName.end());
+				AddUniformBlock(blockName);
+				
+				uniformLocation = shaderText.find(UNIFORM_KEY, shaderText.find("}", blockBegin));
+				continue;
+			}
 			
 			std::string uniformLine = shaderText.substr(begin + 1, end-begin - 1);
 			
@@ -425,6 +500,147 @@ void ShaderData::AddUniform(const std::string& uniformName, const std::string& u
 	m_uniformMap.insert(std::pair<std::string, unsigned int>(uniformName, location));
 }
 
+void ShaderData::AddUniformBlock(const std::string& blockName)
+{
+	static const char* BLOCK_NAMES[NUM_UNIFORM_BLOCK_BINDINGS] = { "FrameBlock", "LightBlock", "ObjectBlock" };
+	
+	int binding = -1;
+	for(int i = 0; i < NUM_UNIFORM_BLOCK_BINDINGS; i++)
+	{
+		if(blockName == BLOCK_NAMES[i])
+		{
+			binding = i;
+		}
+	}
+	
+	if(binding == -1)
+	{
+		std::cerr << "Error: " << blockName << " is not a uniform block the rendering engine knows about" << std::endl;
+		assert(0 != 0);
+		return;
+	}
+	
+	//Blocks the shader doesn't use are optimized out.
+	GLuint blockIndex = glGetUniformBlockIndex(m_program, blockName.c_str());
+	if(blockIndex == GL_INVALID_INDEX)
+	{
+		return;
+	}
+	
+	glUniformBlockBinding(m_program, blockIndex, binding);
+	
+	if(binding == OBJECT_BLOCK_BINDING)
+	{
+		m_usesObjectBlock = true;
+	}
+}
+
+void ShaderData::AddUniformBinders()
+{
+	if(m_usesObjectBlock)
+	{
+		m_objectBinders.push_back(UniformBinder(-1, UniformBinder::SOURCE_OBJECT_BLOCK));
+	}
+	
+	for(unsigned int i = 0; i < m_uniformNames.size(); i++)
+	{
+		const std::string& uniformName = m_uniformNames[i];
+		const std::string& uniformType = m_uniformTypes[i];
+		
+		if(uniformName.compare(0, 2, "R_") == 0)
+		{
+			std::string unprefixedName = uniformName.substr(2);
+			
+			if(unprefixedName == "lightMatrix")
+				AddBinder(m_objectBinders, uniformName, UniformBinder::SOURCE_LIGHT_MATRIX);
+			else if(unprefixedName == "worldLightMatrix") //For instanced shaders, which apply the model matrix themselves
+				AddBinder(m_materialBinders, uniformName, UniformBinder::SOURCE_WORLD_LIGHT_MATRIX);
+			else if(uniformType == "sampler2D" || uniformType == "samplerBuffer" || uniformType == "usamplerBuffer")
+				AddBinder(m_materialBinders, uniformName, UniformBinder::SOURCE_ENGINE_SAMPLER, unprefixedName);
+			else if(uniformType == "vec3")
+				AddBinder(m_materialBinders, uniformName, UniformBinder::SOURCE_ENGINE_VECTOR3F, unprefixedName);
+			else if(uniformType == "float")
+				AddBinder(m_materialBinders, uniformName, UniformBinder::SOURCE_ENGINE_FLOAT, unprefixedName);
+			else if(uniformType == "DirectionalLight" || uniformType == "PointLight" || uniformType == "SpotLight")
+				AddLightBinders(uniformName, uniformType);
+			else
+				m_objectBinders.push_back(UniformBinder(-1, UniformBinder::SOURCE_ENGINE_STRUCT, uniformName, uniformType));
+		}
+		else if(uniformType == "sampler2D")
+			AddBinder(m_materialBinders, uniformName, UniformBinder::SOURCE_MATERIAL_SAMPLER, uniformName);
+		else if(uniformName.compare(0, 2, "T_") == 0)
+		{
+			if(uniformName == "T_MVP")
+				AddBinder(m_objectBinders, uniformName, UniformBinder::SOURCE_TRANSFORM_MVP);
+			else if(uniformName == "T_model")
+				AddBinder(m_objectBinders, uniformName, UniformBinder::SOURCE_TRANSFORM_MODEL);
+			else
+				throw "Invalid Transform Uniform: " + uniformName;
+		}
+		else if(uniformName.compare(0, 2, "C_") == 0)
+		{
+			if(uniformName == "C_eyePos")
+				AddBinder(m_materialBinders, uniformName, UniformBinder::SOURCE_CAMERA_EYE_POS);
+			else if(uniformName == "C_viewProjection")
+				AddBinder(m_materialBinders, uniformName, UniformBinder::SOURCE_CAMERA_VIEW_PROJECTION);
+			else
+				throw "Invalid Camera Uniform: " + uniformName;
+		}
+		else
+		{
+			if(uniformType == "vec3")
+				AddBinder(m_materialBinders, uniformName, UniformBinder::SOURCE_MATERIAL_VECTOR3F, uniformName);
+			else if(uniformType == "float")
+				AddBinder(m_materialBinders, uniformName, UniformBinder::SOURCE_MATERIAL_FLOAT, uniformName);
+			else
+				throw uniformType + " is not supported by the Material class";
+		}
+	}
+}
+
+void ShaderData::AddLightBinders(const std::string& uniformName, const std::string& uniformType)
+{
+	//The members are named as they are in lighting.glh.
+	std::string pointLightName = uniformName;
+	
+	if(uniformType == "DirectionalLight")
+	{
+		AddBinder(m_materialBinders, uniformName + ".base.color", UniformBinder::SOURCE_LIGHT_COLOR);
+		AddBinder(m_materialBinders, uniformName + ".base.intensity", UniformBinder::SOURCE_LIGHT_INTENSITY);
+		AddBinder(m_materialBinders, uniformName + ".direction", UniformBinder::SOURCE_LIGHT_DIRECTION);
+		return;
+	}
+	
+	if(uniformType == "SpotLight")
+	{
+		pointLightName = uniformName + ".pointLight";
+		AddBinder(m_materialBinders, uniformName + ".direction", UniformBinder::SOURCE_LIGHT_DIRECTION);
+		AddBinder(m_materialBinders, uniformName + ".cutoff", UniformBinder::SOURCE_LIGHT_CUTOFF);
+	}
+	
+	AddBinder(m_materialBinders, pointLightName + ".base.color", UniformBinder::SOURCE_LIGHT_COLOR);
+	AddBinder(m_materialBinders, pointLightName + ".base.intensity", UniformBinder::SOURCE_LIGHT_INTENSITY);
+	AddBinder(m_materialBinders, pointLightName + ".atten.constant", UniformBinder::SOURCE_LIGHT_ATTEN_CONSTANT);
+	AddBinder(m_materialBinders, pointLightName + ".atten.linear", UniformBinder::SOURCE_LIGHT_ATTEN_LINEAR);
+	AddBinder(m_materialBinders, pointLightName + ".atten.exponent", UniformBinder::SOURCE_LIGHT_ATTEN_EXPONENT);
+	AddBinder(m_materialBinders, pointLightName + ".position", UniformBinder::SOURCE_LIGHT_POSITION);
+	AddBinder(m_materialBinders, pointLightName + ".range", UniformBinder::SOURCE_LIGHT_RANGE);
+}
+
+void ShaderData::AddBinder(std::vector<UniformBinder>& binders, const std::string& uniformName, UniformBinder::Source source,
+	const std::string& valueName, const std::string& type)
+{
+	std::map<std::string, unsigned int>::const_iterator it = m_uniformMap.find(uniformName);
+	if(it == m_uniformMap.end())
+	{
+		std::cerr << "Error: Uniform " << uniformName << " was not found in the shader" << std::endl;
+		assert(0 != 0);
+		return;
+	}
+	
+	binders.push_back(UniformBinder((int)it->second, source, valueName, type));
+}
+
 void ShaderData::CompileShader() const
 {
     glLinkProgram(m_program);
@@ -458,6 +674,22 @@ static void CheckShaderError(int shader, int flag, bool isProgram, const std::st
 	}
 }
 
+//Sampler uniforms are part of the program's state, so they only need setting once, when the slot
+//is first found. Expects the shader to be bound.
+static int ResolveSamplerSlot(const UniformBinder& binder, const RenderingEngine& renderingEngine)
+{
+	int samplerSlot = binder.GetSamplerSlot();
+	
+	if(samplerSlot < 0)
+	{
+		samplerSlot = renderingEngine.GetSamplerSlot(binder.GetValueName());
+		binder.SetSamplerSlot(samplerSlot);
+		glUniform1i(binder.GetLocation(), samplerSlot);
+	}
+	
+	return samplerSlot;
+}
+
 static std::string LoadShader(const std::string& fileName)
 {
 	std::ifstream file;
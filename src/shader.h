@@ -10,6 +10,7 @@
 #include "material.h"
 #include "transform.h"
 #include "camera.h"
+#include "uniformBlocks.h"
 
 class RenderingEngine;
 class DirectionalLight;
@@ -44,6 +45,68 @@ private:
 	std::vector<TypedData> m_memberNames;
 };
 
+//Everything needed to set one uniform, worked out from it's name and type when the shader is
+//loaded, so setting uniforms doesn't have to look at any strings.
+class UniformBinder
+{
+public:
+	enum Source
+	{
+		SOURCE_TRANSFORM_MVP,
+		SOURCE_TRANSFORM_MODEL,
+		SOURCE_LIGHT_MATRIX,        //The rendering engine's light matrix times the model matrix
+		SOURCE_WORLD_LIGHT_MATRIX,
+		SOURCE_ENGINE_STRUCT,       //Set by RenderingEngine::UpdateUniformStruct
+		SOURCE_OBJECT_BLOCK,        //The whole object uniform block, set by RenderingEngine::UpdateObjectBlock
+		
+		SOURCE_CAMERA_EYE_POS,
+		SOURCE_CAMERA_VIEW_PROJECTION,
+		SOURCE_ENGINE_SAMPLER,
+		SOURCE_ENGINE_VECTOR3F,
+		SOURCE_ENGINE_FLOAT,
+		SOURCE_MATERIAL_SAMPLER,
+		SOURCE_MATERIAL_VECTOR3F,
+		SOURCE_MATERIAL_FLOAT,
+		
+		//Members of the active light.
+		SOURCE_LIGHT_COLOR,
+		SOURCE_LIGHT_INTENSITY,
+		SOURCE_LIGHT_DIRECTION,
+		SOURCE_LIGHT_POSITION,
+		SOURCE_LIGHT_ATTEN_CONSTANT,
+		SOURCE_LIGHT_ATTEN_LINEAR,
+		SOURCE_LIGHT_ATTEN_EXPONENT,
+		SOURCE_LIGHT_RANGE,
+		SOURCE_LIGHT_CUTOFF
+	};
+
+	UniformBinder(int location, Source source, const std::string& valueName = "", const std::string& type = "") :
+		m_location(location),
+		m_source(source),
+		m_valueName(valueName),
+		m_valueId(MappedValues::GetValueId(valueName)),
+		m_type(type),
+		m_samplerSlot(-1) {}
+	
+	inline int GetLocation()                 const { return m_location; }
+	inline Source GetSource()                const { return m_source; }
+	inline const std::string& GetValueName() const { return m_valueName; }
+	inline unsigned int GetValueId()         const { return m_valueId; }
+	inline const std::string& GetType()      const { return m_type; }
+	
+	//Sampler slots belong to the rendering engine, which loads some of it's shaders before it sets
+	//them, so they're found the first time the shader is used. Returns -1 until then.
+	inline int GetSamplerSlot()              const { return m_samplerSlot; }
+	inline void SetSamplerSlot(int slot)     const { m_samplerSlot = slot; }
+private:
+	int          m_location;
+	Source       m_source;
+	std::string  m_valueName; //The name the value is stored under in the material or rendering engine
+	unsigned int m_valueId;   //See MappedValues::GetValueId
+	std::string  m_type;
+	mutable int  m_samplerSlot;
+};
+
 class ShaderData : public ReferenceCounter
 {
 public:
@@ -55,6 +118,12 @@ public:
 	inline const std::vector<std::string>& GetUniformNames()          const { return m_uniformNames; }
 	inline const std::vector<std::string>& GetUniformTypes()          const { return m_uniformTypes; }
 	inline const std::map<std::string, unsigned int>& GetUniformMap() const { return m_uniformMap; }
+	inline unsigned int GetSortId()                                   const { return m_sortId; }
+	
+	//The uniforms that stay the same for every object drawn with the same material in the same
+	//pass, and the ones that depend on the object's transform.
+	inline const std::vector<UniformBinder>& GetMaterialBinders()     const { return m_materialBinders; }
+	inline const std::vector<UniformBinder>& GetObjectBinders()       const { return m_objectBinders; }
 private:
 	void AddVertexShader(const std::string& text);
 	void AddGeometryShader(const std::string& text);
@@ -62,17 +131,30 @@ private:
 	void AddProgram(const std::string& text, int type);
 	
 	void AddAllAttributes(const std::string& vertexShaderText, const std::string& attributeKeyword);
+	void AddFragOutputs();
 	void AddShaderUniforms(const std::string& shaderText);
 	void AddUniform(const std::string& uniformName, const std::string& uniformType, const std::vector<UniformStruct>& structs);
+	void AddUniformBlock(const std::string& blockName);
+	void AddUniformBinders();
+	void AddLightBinders(const std::string& uniformName, const std::string& uniformType);
+	void AddBinder(std::vector<UniformBinder>& binders, const std::string& uniformName, UniformBinder::Source source,
+		const std::string& valueName = "", const std::string& type = "");
 	void CompileShader() const;
 
+	static const unsigned int MAX_FRAG_OUTPUTS = 8;
+	
 	static int s_supportedOpenGLLevel;
 	static std::string s_glslVersion;
+	static unsigned int s_numShaders;
 	int m_program;
+	unsigned int m_sortId;
+	bool m_usesObjectBlock;
 	std::vector<int>                    m_shaders;
 	std::vector<std::string>            m_uniformNames;
 	std::vector<std::string>            m_uniformTypes;
 	std::map<std::string, unsigned int> m_uniformMap;
+	std::vector<UniformBinder>          m_materialBinders;
+	std::vector<UniformBinder>          m_objectBinders;
 };
 
 class Shader
@@ -84,6 +166,15 @@ public:
 
 	void Bind() const;
 	virtual void UpdateUniforms(const Transform& transform, const Material& material, const RenderingEngine& renderingEngine, const Camera& camera) const;
+	
+	//The two halves of UpdateUniforms. The material half covers everything that's the same for
+	//every object drawn with the same material in the same pass, so it only has to be set when
+	//the material changes. The object half covers the transform dependent uniforms.
+	void UpdateMaterialUniforms(const Material& material, const RenderingEngine& renderingEngine, const Camera& camera) const;
+	void UpdateObjectUniforms(const Transform& transform, const Material& material, const RenderingEngine& renderingEngine, const Camera& camera) const;
+	
+	inline unsigned int GetSortId()      const { return m_shaderData->GetSortId(); }
+	inline const std::string& GetName()  const { return m_fileName; }
 
 	void SetUniformi(const std::string& uniformName, int value) const;
 	void SetUniformf(const std::string& uniformName, float value) const;
@@ -96,9 +187,7 @@ private:
 	ShaderData* m_shaderData;
 	std::string m_fileName;
 	
-	void SetUniformDirectionalLight(const std::string& uniformName, const DirectionalLight& value) const;
-	void SetUniformPointLight(const std::string& uniformName, const PointLight& value) const;
-	void SetUniformSpotLight(const std::string& uniformName, const SpotLight& value) const;
+	static void SetUniformVector3f(int location, const Vector3f& value);
 	
 	void operator=(const Shader& other) {}
 };
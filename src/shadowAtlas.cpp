@@ -0,0 +1,130 @@
+#include "shadowAtlas.h"
+#include <cassert>
+
+ShadowAtlas::ShadowAtlas(int size, int minRegionSize) :
+	m_size(size),
+	m_minRegionSize(minRegionSize),
+	m_numLevels(1)
+{
+	assert(size > 0 && (size & (size - 1)) == 0);
+	assert(minRegionSize > 0 && minRegionSize <= size && (minRegionSize & (minRegionSize - 1)) == 0);
+
+	while((m_size >> m_numLevels) >= m_minRegionSize && m_numLevels < MAX_LEVELS)
+	{
+		m_numLevels++;
+	}
+
+	m_freeRegions[0].push_back(ShadowAtlasRegion(0, 0, m_size));
+}
+
+ShadowAtlasRegion ShadowAtlas::Allocate(int size)
+{
+	int level = GetLevel(size);
+
+	//The smallest free region that's at least as big.
+	int freeLevel = level;
+	while(freeLevel >= 0 && m_freeRegions[freeLevel].empty())
+	{
+		freeLevel--;
+	}
+
+	if(freeLevel < 0)
+	{
+		return ShadowAtlasRegion();
+	}
+
+	ShadowAtlasRegion region = m_freeRegions[freeLevel].back();
+	m_freeRegions[freeLevel].pop_back();
+
+	//Keeps the bottom left quarter, and frees the other three.
+	while(freeLevel < level)
+	{
+		freeLevel++;
+		int childSize = region.size / 2;
+		m_freeRegions[freeLevel].push_back(ShadowAtlasRegion(region.x + childSize, region.y + childSize, childSize));
+		m_freeRegions[freeLevel].push_back(ShadowAtlasRegion(region.x,             region.y + childSize, childSize));
+		m_freeRegions[freeLevel].push_back(ShadowAtlasRegion(region.x + childSize, region.y,             childSize));
+		region.size = childSize;
+	}
+
+	return region;
+}
+
+void ShadowAtlas::Free(const ShadowAtlasRegion& region)
+{
+	if(region.size == 0)
+	{
+		return;
+	}
+
+	int level = GetLevel(region.size);
+	assert((m_size >> level) == region.size);
+
+	if(level > 0)
+	{
+		int parentSize = region.size * 2;
+		int parentX = region.x & ~(parentSize - 1);
+		int parentY = region.y & ~(parentSize - 1);
+
+		//Merges with it's siblings, if they're all free.
+		int numFreeSiblings = 0;
+		for(int i = 0; i < 4; i++)
+		{
+			int x = parentX + (i % 2) * region.size;
+			int y = parentY + (i / 2) * region.size;
+			if(x == region.x && y == region.y)
+			{
+				continue;
+			}
+
+			for(unsigned int j = 0; j < m_freeRegions[level].size(); j++)
+			{
+				if(m_freeRegions[level][j].x == x && m_freeRegions[level][j].y == y)
+				{
+					numFreeSiblings++;
+					break;
+				}
+			}
+		}
+
+		if(numFreeSiblings == 3)
+		{
+			for(int i = 0; i < 4; i++)
+			{
+				RemoveFreeRegion(level, parentX + (i % 2) * region.size, parentY + (i / 2) * region.size);
+			}
+
+			Free(ShadowAtlasRegion(parentX, parentY, parentSize));
+			return;
+		}
+	}
+
+	m_freeRegions[level].push_back(region);
+}
+
+int ShadowAtlas::GetLevel(int size) const
+{
+	int level = 0;
+	while(level < m_numLevels - 1 && (m_size >> (level + 1)) >= size)
+	{
+		level++;
+	}
+
+	return level;
+}
+
+bool ShadowAtlas::RemoveFreeRegion(int level, int x, int y)
+{
+	std::vector<ShadowAtlasRegion>& freeRegions = m_freeRegions[level];
+	for(unsigned int i = 0; i < freeRegions.size(); i++)
+	{
+		if(freeRegions[i].x == x && freeRegions[i].y == y)
+		{
+			freeRegions[i] = freeRegions.back();
+			freeRegions.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,52 @@
+#ifndef SHADOWATLAS_H
+#define SHADOWATLAS_H
+
+#include <vector>
+
+//A square part of the shadow atlas, in texels. Regions with a size of 0 are empty.
+struct ShadowAtlasRegion
+{
+	ShadowAtlasRegion(int xIn = 0, int yIn = 0, int sizeIn = 0) :
+		x(xIn),
+		y(yIn),
+		size(sizeIn) {}
+
+	int x;
+	int y;
+	int size;
+};
+
+//Hands out square, power of two sized regions of a square atlas, so every light can have a
+//shadow map of it's own in one texture. Regions are nodes of a quadtree: allocating splits the
+//smallest free node that's big enough into four until it's the right size, and freeing merges
+//a node's children back together once all four of them are free.
+class ShadowAtlas
+{
+public:
+	static const int MAX_LEVELS = 16;
+
+	//size and minRegionSize have to be powers of two.
+	ShadowAtlas(int size, int minRegionSize);
+
+	//Rounds size up to a power of two, and clamps it to the sizes the atlas can hand out.
+	//Returns an empty region if there's no room for it.
+	ShadowAtlasRegion Allocate(int size);
+	void Free(const ShadowAtlasRegion& region);
+
+	inline int GetSize()          const { return m_size; }
+	inline int GetMinRegionSize() const { return m_minRegionSize; }
+protected:
+private:
+	int                            m_size;
+	int                            m_minRegionSize;
+	int                            m_numLevels;
+	std::vector<ShadowAtlasRegion> m_freeRegions[MAX_LEVELS]; //Level i holds regions of size m_size >> i
+
+	int GetLevel(int size) const;
+	bool RemoveFreeRegion(int level, int x, int y);
+
+	ShadowAtlas(const ShadowAtlas& other) {}
+	void operator=(const ShadowAtlas& other) {}
+};
+
+#endif // SHADOWATLAS_H
@@ -89,7 +89,7 @@ public:
 	//Bit 2/3: Which element goes to slot 2
 	//Bit 4/5: Which element goes to slot 3
 	//Bit 6/7: Which element goes to slot 4
-	inline SIMD4i Shuffle(int8_t shuffleByte)
+	inline SIMD4i Shuffle(int8_t shuffleByte) const
 	{
 		int index0 = (shuffleByte)      & 3;
 		int index1 = (shuffleByte >> 2) & 3;
@@ -400,7 +400,7 @@ public:
 	//Bit 2/3: Which element goes to slot 2
 	//Bit 4/5: Which element goes to slot 3
 	//Bit 6/7: Which element goes to slot 4
-	inline SIMD4f Shuffle(int8_t shuffleByte)
+	inline SIMD4f Shuffle(int8_t shuffleByte) const
 	{
 		int index0 = (shuffleByte)      & 3;
 		int index1 = (shuffleByte >> 2) & 3;
@@ -420,6 +420,21 @@ public:
 		return result;
 	}
 	
+	//Bit i of the result is the sign bit of element i. Comparison results are all ones or all
+	//zeros, so this is a quick way to find out which elements passed.
+	inline int GetSignMask() const
+	{
+		int result = 0;
+		for(int i = 0; i < 4; i++)
+		{
+			if(m_data[i] < 0.0f)
+			{
+				result |= 1 << i;
+			}
+		}
+		return result;
+	}
+	
 	inline SIMD4i RoundToInt() const
 	{
 		int32_t result[4];
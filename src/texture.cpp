@@ -2,10 +2,12 @@
 #include "stb_image.h"
 #include "math3d.h"
 #include "profiling.h"
+#include "glState.h"
 
 #include <iostream>
 #include <cassert>
 #include <cstring>
+#include <vector>
 
 std::map<std::string, TextureData*> Texture::s_resourceMap;
 
@@ -24,16 +26,40 @@ TextureData::TextureData(GLenum textureTarget, int width, int height, int numTex
 	#endif
 	m_frameBuffer = 0;
 	m_renderBuffer = 0;
+	m_mipFrameBuffers[0] = 0;
+	m_mipFrameBuffers[1] = 0;
 	
 	InitTextures(data, filters, internalFormat, format, clamp);
 	InitRenderTargets(attachments);
 }
 
+TextureData::TextureData(GLuint buffer, GLenum internalFormat)
+{
+	m_textureID = new GLuint[1];
+	m_textureTarget = GL_TEXTURE_BUFFER;
+	m_numTextures = 1;
+	m_width = 0;
+	m_height = 0;
+	m_frameBuffer = 0;
+	m_renderBuffer = 0;
+	m_mipFrameBuffers[0] = 0;
+	m_mipFrameBuffers[1] = 0;
+	
+	glGenTextures(1, m_textureID);
+	GLState::BindTexture(0, GL_TEXTURE_BUFFER, m_textureID[0]);
+	glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer);
+}
+
 TextureData::~TextureData()
 {
-	if(*m_textureID) glDeleteTextures(m_numTextures, m_textureID);
-	if(m_frameBuffer) glDeleteFramebuffers(1, &m_frameBuffer);
+	if(*m_textureID) GLState::DeleteTextures(m_numTextures, m_textureID);
+	if(m_frameBuffer) GLState::DeleteFramebuffer(m_frameBuffer);
 	if(m_renderBuffer) glDeleteRenderbuffers(1, &m_renderBuffer);
+	if(m_mipFrameBuffers[0])
+	{
+		GLState::DeleteFramebuffer(m_mipFrameBuffers[0]);
+		GLState::DeleteFramebuffer(m_mipFrameBuffers[1]);
+	}
 	if(m_textureID) delete[] m_textureID;
 }
 
@@ -42,7 +68,7 @@ void TextureData::InitTextures(unsigned char** data, GLfloat* filters, GLenum* i
 	glGenTextures(m_numTextures, m_textureID);
 	for(int i = 0; i < m_numTextures; i++)
 	{
-		glBindTexture(m_textureTarget, m_textureID[i]);
+		GLState::BindTexture(0, m_textureTarget, m_textureID[i]);
 			
 		glTexParameterf(m_textureTarget, GL_TEXTURE_MIN_FILTER, filters[i]);
 		glTexParameterf(m_textureTarget, GL_TEXTURE_MAG_FILTER, filters[i]);
@@ -98,7 +124,7 @@ void TextureData::InitRenderTargets(GLenum* attachments)
 		if(m_frameBuffer == 0)
 		{
 			glGenFramebuffers(1, &m_frameBuffer);
-			glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
+			GLState::BindFramebuffer(m_frameBuffer);
 		}
 		
 		glFramebufferTexture2D(GL_FRAMEBUFFER, attachments[i], m_textureTarget, m_textureID[i], 0);
@@ -111,7 +137,8 @@ void TextureData::InitRenderTargets(GLenum* attachments)
 	{
 		glGenRenderbuffers(1, &m_renderBuffer);
 		glBindRenderbuffer(GL_RENDERBUFFER, m_renderBuffer);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, m_width, m_height);
+		//Sized like the depth textures render targets are given, so depth can be copied between them.
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
 		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_renderBuffer);
 	}
 	
@@ -126,29 +153,72 @@ void TextureData::InitRenderTargets(GLenum* attachments)
 		assert(false);
 	}
 	
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::BindFramebuffer(0);
 }
 
-void TextureData::Bind(int textureNum) const
+void TextureData::Bind(unsigned int unit, int textureNum) const
 {
-	glBindTexture(m_textureTarget, m_textureID[textureNum]);
+	GLState::BindTexture(unit, m_textureTarget, m_textureID[textureNum]);
 }
 
 void TextureData::BindAsRenderTarget() const
 {
-	glBindTexture(GL_TEXTURE_2D,0);
-	glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
+	GLState::BindFramebuffer(m_frameBuffer);
 	
 	#if PROFILING_SET_1x1_VIEWPORT == 0
-		glViewport(0, 0, m_width, m_height);
+		GLState::Viewport(0, 0, m_width, m_height);
 	#else
-		glViewport(0, 0, 1, 1);
+		GLState::Viewport(0, 0, 1, 1);
 	#endif
 }
 
+void TextureData::GenerateMipmaps() const
+{
+	for(int i = 0; i < m_numTextures; i++)
+	{
+		GLState::BindTexture(0, m_textureTarget, m_textureID[i]);
+		glGenerateMipmap(m_textureTarget);
+	}
+}
+
+void TextureData::GenerateMipmaps(int x, int y, int width, int height) const
+{
+	if(m_mipFrameBuffers[0] == 0)
+	{
+		glGenFramebuffers(2, m_mipFrameBuffers);
+	}
+	
+	//Each level is a linear blit of the one before at half the size, which averages every 2x2
+	//block of texels, like glGenerateMipmap does. Blits read from the read framebuffer, which
+	//GLState doesn't track, so it's pointed back at the draw framebuffer afterwards.
+	GLState::BindFramebuffer(m_mipFrameBuffers[1]);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_mipFrameBuffers[0]);
+	for(int level = 1; (width >> level) > 0 && (height >> level) > 0; level++)
+	{
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_textureTarget, m_textureID[0], level - 1);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_textureTarget, m_textureID[0], level);
+		glBlitFramebuffer(x >> (level - 1), y >> (level - 1), (x + width) >> (level - 1), (y + height) >> (level - 1),
+		                  x >> level, y >> level, (x + width) >> level, (y + height) >> level, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_mipFrameBuffers[1]);
+}
+
+void TextureData::CopyDepthTo(const TextureData& target) const
+{
+	assert(m_width == target.m_width && m_height == target.m_height);
+	
+	//Blits read from the read framebuffer, which GLState doesn't track, so it's pointed back at
+	//target afterwards.
+	target.BindAsRenderTarget();
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_frameBuffer);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, target.m_frameBuffer);
+}
+
 Texture::Texture(const std::string& fileName, GLenum textureTarget, GLfloat filter, GLenum internalFormat, GLenum format, bool clamp, GLenum attachment)
 {
  	m_fileName = fileName;
+	m_textureNum = 0;
 
 	std::map<std::string, TextureData*>::const_iterator it = s_resourceMap.find(fileName);
 	if(it != s_resourceMap.end())
@@ -176,12 +246,40 @@ Texture::Texture(const std::string& fileName, GLenum textureTarget, GLfloat filt
 Texture::Texture(int width, int height, unsigned char* data, GLenum textureTarget, GLfloat filter, GLenum internalFormat, GLenum format, bool clamp, GLenum attachment)
 {
 	m_fileName = "";
+	m_textureNum = 0;
 	m_textureData = new TextureData(textureTarget, width, height, 1, &data, &filter, &internalFormat, &format, clamp, &attachment);
 }
 
+Texture::Texture(int width, int height, int numTextures, GLenum* internalFormats, GLenum* formats, GLenum* attachments, GLfloat filter)
+{
+	m_fileName = "";
+	m_textureNum = 0;
+	
+	std::vector<unsigned char*> data(numTextures, (unsigned char*)0);
+	std::vector<GLfloat> filters(numTextures, filter);
+	m_textureData = new TextureData(GL_TEXTURE_2D, width, height, numTextures, &data[0], &filters[0], internalFormats, formats, true, attachments);
+}
+
+Texture::Texture(const Texture& renderTargets, int textureNum) :
+	m_textureData(renderTargets.m_textureData),
+	m_fileName(renderTargets.m_fileName),
+	m_textureNum(textureNum)
+{
+	m_textureData->AddReference();
+}
+
+Texture::Texture(GLenum textureTarget, GLuint buffer, GLenum internalFormat)
+{
+	assert(textureTarget == GL_TEXTURE_BUFFER);
+	m_fileName = "";
+	m_textureNum = 0;
+	m_textureData = new TextureData(buffer, internalFormat);
+}
+
 Texture::Texture(const Texture& texture) :
 	m_textureData(texture.m_textureData),
-	m_fileName(texture.m_fileName)
+	m_fileName(texture.m_fileName),
+	m_textureNum(texture.m_textureNum)
 {
 	m_textureData->AddReference();
 }
@@ -207,12 +305,25 @@ Texture::~Texture()
 
 void Texture::Bind(unsigned int unit) const
 {
-	assert(unit >= 0 && unit <= 31);
-	glActiveTexture(GL_TEXTURE0 + unit);
-	m_textureData->Bind(0);
+	m_textureData->Bind(unit, m_textureNum);
 }
 
 void Texture::BindAsRenderTarget() const
 {
 	m_textureData->BindAsRenderTarget();
 }
+
+void Texture::GenerateMipmaps() const
+{
+	m_textureData->GenerateMipmaps();
+}
+
+void Texture::GenerateMipmaps(int x, int y, int width, int height) const
+{
+	m_textureData->GenerateMipmaps(x, y, width, height);
+}
+
+void Texture::CopyDepthTo(const Texture& target) const
+{
+	m_textureData->CopyDepthTo(*target.m_textureData);
+}
@@ -10,9 +10,13 @@ class TextureData : public ReferenceCounter
 {
 public:
 	TextureData(GLenum textureTarget, int width, int height, int numTextures, unsigned char** data, GLfloat* filters, GLenum* internalFormat, GLenum* format, bool clamp, GLenum* attachments);
+	TextureData(GLuint buffer, GLenum internalFormat);
 	
-	void Bind(int textureNum) const;
+	void Bind(unsigned int unit, int textureNum) const;
 	void BindAsRenderTarget() const;
+	void GenerateMipmaps() const;
+	void GenerateMipmaps(int x, int y, int width, int height) const;
+	void CopyDepthTo(const TextureData& target) const;
 	
 	inline int GetWidth()  const { return m_width; }
 	inline int GetHeight() const { return m_height; }
@@ -30,6 +34,7 @@ private:
 	GLenum m_textureTarget;
 	GLuint m_frameBuffer;
 	GLuint m_renderBuffer;
+	mutable GLuint m_mipFrameBuffers[2]; //Read and draw, for generating the mipmaps of part of the texture
 	int m_numTextures;
 	int m_width;
 	int m_height;
@@ -40,17 +45,35 @@ class Texture
 public:
 	Texture(const std::string& fileName, GLenum textureTarget = GL_TEXTURE_2D, GLfloat filter = GL_LINEAR_MIPMAP_LINEAR, GLenum internalFormat = GL_RGBA, GLenum format = GL_RGBA, bool clamp = false, GLenum attachment = GL_NONE);
 	Texture(int width = 0, int height = 0, unsigned char* data = 0, GLenum textureTarget = GL_TEXTURE_2D, GLfloat filter = GL_LINEAR_MIPMAP_LINEAR, GLenum internalFormat = GL_RGBA, GLenum format = GL_RGBA, bool clamp = false, GLenum attachment = GL_NONE);
+	//Several textures that are rendered to at once, such as a G-buffer. Each texture is attached
+	//to the corresponding attachment, and none of them have mipmaps.
+	Texture(int width, int height, int numTextures, GLenum* internalFormats, GLenum* formats, GLenum* attachments, GLfloat filter = GL_NEAREST);
+	//Refers to one of the textures of renderTargets, so it can be sampled on it's own.
+	Texture(const Texture& renderTargets, int textureNum);
+	//A GL_TEXTURE_BUFFER, which reads it's texels from buffer. The buffer's contents can be
+	//changed at any time, but it has to outlive the texture.
+	Texture(GLenum textureTarget, GLuint buffer, GLenum internalFormat);
 	Texture(const Texture& texture);
 	void operator=(Texture texture);
 	virtual ~Texture();
 
 	void Bind(unsigned int unit = 0) const;	
 	void BindAsRenderTarget() const;
+	//Rebuilds the mipmaps from the first level, after it's been rendered to. Only for textures
+	//created with a mipmapping filter.
+	void GenerateMipmaps() const;
+	//Only rebuilds the mipmaps of one rectangle of the first texture. It's position and size have
+	//to be multiples of the size of a texel of the smallest level that's rebuilt, which is where
+	//it's a single texel, so the rectangle's levels don't share texels with anything around it.
+	void GenerateMipmaps(int x, int y, int width, int height) const;
+	//Copies the depth of this render target into target's, which has to be the same size. Leaves
+	//target bound as the render target.
+	void CopyDepthTo(const Texture& target) const;
 	
 	inline int GetWidth()  const { return m_textureData->GetWidth(); }
 	inline int GetHeight() const { return m_textureData->GetHeight(); }
 	
-	bool operator==(const Texture& texture) const { return m_textureData == texture.m_textureData; }
+	bool operator==(const Texture& texture) const { return m_textureData == texture.m_textureData && m_textureNum == texture.m_textureNum; }
 	bool operator!=(const Texture& texture) const { return !operator==(texture); }
 protected:
 private:
@@ -58,6 +81,7 @@ private:
 
 	TextureData* m_textureData;
 	std::string m_fileName;
+	int m_textureNum;
 };
 
 #endif
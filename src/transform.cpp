@@ -70,9 +70,28 @@ Matrix4f Transform::GetTransformation() const
 	return GetParentMatrix() * result;
 }
 
+void Transform::FreezeParentMatrices()
+{
+	//Refreshing the first one refreshes every one above it, and anything already frozen is up
+	//to date, along with everything above it.
+	for(Transform* transform = this; transform != 0 && !transform->m_parentMatrixFrozen; transform = transform->m_parent)
+	{
+		transform->GetParentMatrix();
+		transform->m_parentMatrixFrozen = true;
+	}
+}
+
+void Transform::UnfreezeParentMatrices()
+{
+	for(Transform* transform = this; transform != 0 && transform->m_parentMatrixFrozen; transform = transform->m_parent)
+	{
+		transform->m_parentMatrixFrozen = false;
+	}
+}
+
 const Matrix4f& Transform::GetParentMatrix() const
 {
-	if(m_parent != 0 && m_parent->HasChanged())
+	if(!m_parentMatrixFrozen && m_parent != 0 && m_parent->HasChanged())
 	{
 		m_parentMatrix = m_parent->GetTransformation();
 	}
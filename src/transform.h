@@ -12,6 +12,7 @@ public:
 		m_scale(scale),
 		m_parent(0),
 		m_parentMatrix(Matrix4f().InitIdentity()),
+		m_parentMatrixFrozen(false),
 		m_initializedOldStuff(false) {}
 
 	Matrix4f GetTransformation() const;
@@ -21,6 +22,13 @@ public:
 	void Rotate(const Quaternion& rotation);
 	void LookAt(const Vector3f& point, const Vector3f& up);
 	
+	//Brings the cached parent matrices of this transform and all of it's ancestors up to date,
+	//then stops them from being written until they're unfrozen. Reading a transform's world
+	//matrix refreshes those caches, so they have to be frozen before transforms that several
+	//threads may read at once are shared between them.
+	void FreezeParentMatrices();
+	void UnfreezeParentMatrices();
+	
 	Quaternion GetLookAtRotation(const Vector3f& point, const Vector3f& up) 
 	{ 
 		return Quaternion(Matrix4f().InitRotationFromDirection((point - m_pos).Normalized(), up)); 
@@ -48,6 +56,7 @@ private:
 	
 	Transform* m_parent;
 	mutable Matrix4f m_parentMatrix;
+	bool m_parentMatrixFrozen;
 	
 	mutable Vector3f m_oldPos;
 	mutable Quaternion m_oldRot;
@@ -0,0 +1,64 @@
+#ifndef UNIFORMBLOCKS_H
+#define UNIFORMBLOCKS_H
+
+//The data in the uniform blocks declared in res/shaders/blocks.glh, laid out by the std140
+//rules: vec3s start on 16 byte boundaries, and a float can fill the space after one.
+//Matrices are column major, like Matrix4f.
+
+//Directional lights can split their shadow map into this many cascades at most.
+enum
+{
+	MAX_SHADOW_CASCADES = 4
+};
+
+enum UniformBlockBinding
+{
+	FRAME_BLOCK_BINDING,
+	LIGHT_BLOCK_BINDING,
+	OBJECT_BLOCK_BINDING,
+
+	NUM_UNIFORM_BLOCK_BINDINGS
+};
+
+struct FrameBlockData
+{
+	float viewProjection[16];
+	float eyePos[3];
+	float padding0;
+	float ambient[3];
+	float padding1;
+	float inverseViewProjection[16];
+	float inverseScreenSize[2];
+	float clusterDepthScaleBias[2];
+};
+
+struct LightBlockData
+{
+	float lightMatrix[16];
+	float color[3];
+	float intensity;
+	float position[3];
+	float range;
+	float direction[3];
+	float cutoff;
+	float attenuation[3];
+	float shadowVarianceMin;
+	float shadowLightBleedingReduction;
+	float shadowExponent;
+	float shadowMipBias;
+	float padding;
+	float cascadeMatrices[MAX_SHADOW_CASCADES][16];
+	float cascadeSplits[MAX_SHADOW_CASCADES];
+	float numCascades;
+	float padding2[3];
+	float shadowAtlasRegion[4];
+};
+
+struct ObjectBlockData
+{
+	float model[16];
+	float MVP[16];
+	float lightMatrix[16];
+};
+
+#endif // UNIFORMBLOCKS_H
@@ -1,5 +1,6 @@
 #include "window.h"
 #include "profiling.h"
+#include "glState.h"
 #include <SDL2/SDL.h>
 #include <GL/glew.h>
 
@@ -41,6 +42,8 @@ Window::Window(int width, int height, const std::string& title) :
 	{
 		fprintf(stderr, "Error: '%s'\n", glewGetErrorString(res));
 	}
+	
+	GLState::Invalidate();
 }
 
 Window::~Window()
@@ -116,13 +119,12 @@ void Window::SwapBuffers()
 
 void Window::BindAsRenderTarget() const
 {
-	glBindTexture(GL_TEXTURE_2D,0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::BindFramebuffer(0);
 	
 	#if PROFILING_SET_1x1_VIEWPORT == 0
-		glViewport(0, 0, GetWidth(), GetHeight());
+		GLState::Viewport(0, 0, GetWidth(), GetHeight());
 	#else
-		glViewport(0, 0, 1, 1);
+		GLState::Viewport(0, 0, 1, 1);
 	#endif
 }
 
@@ -0,0 +1,396 @@
+#include "worldPartition.h"
+#include "sceneFile.h"
+#include "timing.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+WorldPartition::WorldPartition(const std::string& filePrefix, float cellSize, float loadRadius, float unloadRadius,
+	double attachBudgetInMilliseconds, unsigned int numIOThreads) :
+	m_filePrefix(filePrefix),
+	m_cellSize(cellSize),
+	m_loadRadius(loadRadius),
+	m_unloadRadius(unloadRadius > loadRadius ? unloadRadius : loadRadius),
+	m_attachBudget(attachBudgetInMilliseconds / 1000.0),
+	m_numPendingCells(0),
+	m_numAttachedCells(0),
+	m_ioStopRequested(false),
+	m_bytesRead(0),
+	m_statsStartTime(Time::GetTime()),
+	m_totalAttachTime(0.0),
+	m_maxAttachTime(0.0),
+	m_numCellsAttached(0),
+	m_numBudgetOverruns(0)
+{
+	assert(cellSize > 0.0f);
+
+	//Cells are read on dedicated threads rather than on the job system. Reading blocks on the
+	//disk, and the job system only runs jobs while the main thread waits for them when there
+	//is a single core, so loads would never overlap with the frame.
+	if(numIOThreads == 0)
+	{
+		numIOThreads = 1;
+	}
+
+	for(unsigned int i = 0; i < numIOThreads; i++)
+	{
+		m_ioThreads.push_back(std::thread(&WorldPartition::IOThreadMain, this));
+	}
+}
+
+WorldPartition::~WorldPartition()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_ioMutex);
+		m_ioStopRequested = true;
+	}
+
+	m_ioCondition.notify_all();
+	for(unsigned int i = 0; i < m_ioThreads.size(); i++)
+	{
+		m_ioThreads[i].join();
+	}
+
+	//Attached cells belong to the scene now, and are deleted with it.
+}
+
+void WorldPartition::Update(const Vector3f& viewerPos, Entity& root)
+{
+	ReleaseCells(viewerPos);
+	RequestCells(viewerPos);
+	CollectLoadedCells(viewerPos);
+	AttachCells(root);
+
+	m_numPendingCells = (unsigned int)m_cells.size() - m_numAttachedCells;
+}
+
+bool WorldPartition::WriteCells(Entity& root, const std::string& filePrefix, float cellSize)
+{
+	std::map<CellCoord, std::vector<Entity*> > cells;
+
+	for(unsigned int i = 0; i < root.GetNumChildren(); i++)
+	{
+		Entity* child = root.GetChild(i);
+		const Vector3f& pos = *child->GetTransform()->GetPos();
+
+		CellCoord coord;
+		coord.x = (int)floor(pos.GetX() / cellSize);
+		coord.z = (int)floor(pos.GetZ() / cellSize);
+		cells[coord].push_back(child);
+	}
+
+	bool succeeded = true;
+
+	for(std::map<CellCoord, std::vector<Entity*> >::iterator it = cells.begin(); it != cells.end(); ++it)
+	{
+		if(!SceneFile::Save(&it->second[0], (unsigned int)it->second.size(), GetCellFileName(filePrefix, it->first.x, it->first.z)))
+		{
+			succeeded = false;
+		}
+	}
+
+	return succeeded;
+}
+
+void WorldPartition::DisplayAndResetStats(double dividend)
+{
+	double currentTime = Time::GetTime();
+	double elapsedTime = currentTime - m_statsStartTime;
+
+	size_t bytesRead;
+	{
+		std::lock_guard<std::mutex> lock(m_ioMutex);
+		bytesRead = m_bytesRead;
+		m_bytesRead = 0;
+	}
+
+	double bandwidth = elapsedTime > 0.0 ? ((double)bytesRead / (1024.0 * 1024.0)) / elapsedTime : 0.0;
+	double attachTime = dividend > 0.0 ? (1000.0 * m_totalAttachTime) / dividend : 1000.0 * m_totalAttachTime;
+
+	printf("Streaming:                              %f MB/s, %u cells pending, %u attached\n",
+		bandwidth, m_numPendingCells, m_numAttachedCells);
+	printf("Cell Attach Time:                       %f ms (max %f ms, %u cells, %u frames over budget)\n",
+		attachTime, 1000.0 * m_maxAttachTime, m_numCellsAttached, m_numBudgetOverruns);
+
+	m_statsStartTime = currentTime;
+	m_totalAttachTime = 0.0;
+	m_maxAttachTime = 0.0;
+	m_numCellsAttached = 0;
+	m_numBudgetOverruns = 0;
+}
+
+void WorldPartition::RequestCells(const Vector3f& viewerPos)
+{
+	std::vector<CellRequest> requests;
+
+	int minX = (int)floor((viewerPos.GetX() - m_loadRadius) / m_cellSize);
+	int maxX = (int)floor((viewerPos.GetX() + m_loadRadius) / m_cellSize);
+	int minZ = (int)floor((viewerPos.GetZ() - m_loadRadius) / m_cellSize);
+	int maxZ = (int)floor((viewerPos.GetZ() + m_loadRadius) / m_cellSize);
+
+	for(int z = minZ; z <= maxZ; z++)
+	{
+		for(int x = minX; x <= maxX; x++)
+		{
+			CellRequest request;
+			request.coord.x = x;
+			request.coord.z = z;
+			request.distance = GetCellDistance(request.coord, viewerPos);
+
+			if(request.distance > m_loadRadius)
+			{
+				continue;
+			}
+
+			std::map<CellCoord, Cell>::iterator it = m_cells.find(request.coord);
+			if(it != m_cells.end())
+			{
+				//The viewer came back before the cell finished loading.
+				it->second.cancelled = false;
+				continue;
+			}
+
+			requests.push_back(request);
+		}
+	}
+
+	if(requests.empty())
+	{
+		return;
+	}
+
+	//Closest cells are read first, since they're the ones most likely to be seen.
+	std::sort(requests.begin(), requests.end());
+
+	{
+		std::lock_guard<std::mutex> lock(m_ioMutex);
+		for(unsigned int i = 0; i < requests.size(); i++)
+		{
+			Cell& cell = m_cells[requests[i].coord];
+			cell.state = CELL_LOADING;
+			cell.cancelled = false;
+			m_ioRequests.push_back(requests[i].coord);
+		}
+	}
+
+	m_ioCondition.notify_all();
+}
+
+void WorldPartition::ReleaseCells(const Vector3f& viewerPos)
+{
+	std::map<CellCoord, Cell>::iterator it = m_cells.begin();
+	while(it != m_cells.end())
+	{
+		Cell& cell = it->second;
+		if(cell.cancelled || GetCellDistance(it->first, viewerPos) <= m_unloadRadius)
+		{
+			++it;
+			continue;
+		}
+
+		if(cell.state == CELL_ATTACHED)
+		{
+			//Destroyed at the end of the update, like any other entity.
+			Entity* cellRoot = Entity::Resolve(cell.root);
+			if(cellRoot)
+			{
+				cellRoot->Destroy();
+			}
+
+			m_numAttachedCells--;
+		}
+		else if(cell.state == CELL_LOADED)
+		{
+			m_cellsToAttach.erase(std::find(m_cellsToAttach.begin(), m_cellsToAttach.end(), it->first));
+		}
+		else
+		{
+			//Requests that haven't been picked up yet can simply be dropped. Otherwise the cell
+			//has to stay around until it's IO thread reports back.
+			std::lock_guard<std::mutex> lock(m_ioMutex);
+			std::deque<CellCoord>::iterator request = std::find(m_ioRequests.begin(), m_ioRequests.end(), it->first);
+			if(request == m_ioRequests.end())
+			{
+				cell.cancelled = true;
+				++it;
+				continue;
+			}
+
+			m_ioRequests.erase(request);
+		}
+
+		m_cells.erase(it++);
+	}
+}
+
+void WorldPartition::CollectLoadedCells(const Vector3f& viewerPos)
+{
+	std::vector<std::pair<CellCoord, std::vector<unsigned char> > > results;
+	{
+		std::lock_guard<std::mutex> lock(m_ioMutex);
+		results.swap(m_ioResults);
+	}
+
+	for(unsigned int i = 0; i < results.size(); i++)
+	{
+		std::map<CellCoord, Cell>::iterator it = m_cells.find(results[i].first);
+		assert(it != m_cells.end() && it->second.state == CELL_LOADING);
+
+		if(it->second.cancelled)
+		{
+			m_cells.erase(it);
+			continue;
+		}
+
+		it->second.state = CELL_LOADED;
+		it->second.data.swap(results[i].second);
+		m_cellsToAttach.push_back(it->first);
+	}
+
+	if(results.empty())
+	{
+		return;
+	}
+
+	//Closest cells are attached first.
+	std::vector<CellRequest> order(m_cellsToAttach.size());
+	for(unsigned int i = 0; i < m_cellsToAttach.size(); i++)
+	{
+		order[i].coord = m_cellsToAttach[i];
+		order[i].distance = GetCellDistance(m_cellsToAttach[i], viewerPos);
+	}
+
+	std::sort(order.begin(), order.end());
+
+	for(unsigned int i = 0; i < order.size(); i++)
+	{
+		m_cellsToAttach[i] = order[i].coord;
+	}
+}
+
+void WorldPartition::AttachCells(Entity& root)
+{
+	if(m_cellsToAttach.empty())
+	{
+		return;
+	}
+
+	double startTime = Time::GetTime();
+	double elapsedTime = 0.0;
+	unsigned int numAttached = 0;
+
+	//At least one cell is attached every frame, so streaming can't stall, even if a single
+	//cell takes longer than the budget.
+	while(numAttached < m_cellsToAttach.size() && (numAttached == 0 || elapsedTime < m_attachBudget))
+	{
+		const CellCoord& coord = m_cellsToAttach[numAttached];
+		Cell& cell = m_cells[coord];
+
+		//Only the main thread may instantiate; see the class comment.
+		if(!cell.data.empty())
+		{
+			Entity* cellRoot = SceneFile::Instantiate(&cell.data[0], cell.data.size());
+			if(cellRoot)
+			{
+				root.AddChild(cellRoot);
+				cell.root = cellRoot->GetHandle();
+			}
+			else
+			{
+				std::cerr << "Error: " << GetCellFileName(m_filePrefix, coord.x, coord.z) << " is not a valid scene file" << std::endl;
+			}
+
+			std::vector<unsigned char>().swap(cell.data);
+		}
+
+		cell.state = CELL_ATTACHED;
+		m_numAttachedCells++;
+		numAttached++;
+		elapsedTime = Time::GetTime() - startTime;
+	}
+
+	m_cellsToAttach.erase(m_cellsToAttach.begin(), m_cellsToAttach.begin() + numAttached);
+
+	m_totalAttachTime += elapsedTime;
+	m_numCellsAttached += numAttached;
+
+	if(elapsedTime > m_maxAttachTime)
+	{
+		m_maxAttachTime = elapsedTime;
+	}
+
+	if(elapsedTime > m_attachBudget)
+	{
+		m_numBudgetOverruns++;
+	}
+}
+
+void WorldPartition::IOThreadMain()
+{
+	std::unique_lock<std::mutex> lock(m_ioMutex);
+
+	while(true)
+	{
+		while(m_ioRequests.empty() && !m_ioStopRequested)
+		{
+			m_ioCondition.wait(lock);
+		}
+
+		if(m_ioStopRequested)
+		{
+			return;
+		}
+
+		CellCoord coord = m_ioRequests.front();
+		m_ioRequests.pop_front();
+		std::string fileName = GetCellFileName(m_filePrefix, coord.x, coord.z);
+
+		lock.unlock();
+
+		//Cells without a file are empty, which isn't an error; most of a world usually is.
+		std::vector<unsigned char> data;
+		FILE* file = fopen(fileName.c_str(), "rb");
+		if(file)
+		{
+			fseek(file, 0, SEEK_END);
+			long size = ftell(file);
+			fseek(file, 0, SEEK_SET);
+
+			if(size > 0)
+			{
+				data.resize((size_t)size);
+				if(fread(&data[0], 1, data.size(), file) != data.size())
+				{
+					std::cerr << "Error: Unable to read " << fileName << std::endl;
+					data.clear();
+				}
+			}
+
+			fclose(file);
+		}
+
+		lock.lock();
+		m_bytesRead += data.size();
+		m_ioResults.push_back(std::make_pair(coord, std::vector<unsigned char>()));
+		m_ioResults.back().second.swap(data);
+	}
+}
+
+std::string WorldPartition::GetCellFileName(const std::string& filePrefix, int x, int z)
+{
+	std::ostringstream result;
+	result << filePrefix << "_" << x << "_" << z << ".scn";
+	return result.str();
+}
+
+float WorldPartition::GetCellDistance(const CellCoord& coord, const Vector3f& viewerPos) const
+{
+	//Cells extend infinitely up and down, so only the distance on the XZ plane counts.
+	float x = ((float)coord.x + 0.5f) * m_cellSize - viewerPos.GetX();
+	float z = ((float)coord.z + 0.5f) * m_cellSize - viewerPos.GetZ();
+	return sqrtf(x * x + z * z);
+}
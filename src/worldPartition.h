@@ -0,0 +1,121 @@
+#ifndef WORLDPARTITION_H
+#define WORLDPARTITION_H
+
+#include "entity.h"
+#include "math3d.h"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Divides the world into a grid of square cells on the XZ plane, each of which is stored in it's
+//own scene file. Cells near the viewer are read on background threads, and instantiated and
+//attached to the scene on the main thread, within a time budget per frame. Cells that get too far
+//away are destroyed again. Cell entities come and go, so they are allocated from the pools rather
+//than the scene arena.
+//
+//Instantiating can't move to the background threads, even into subtrees that aren't attached yet.
+//Component loaders create meshes, materials, shaders and textures, whose resource maps aren't
+//locked, and whose GL objects need the context, which is only current on the main thread. Creating
+//entities also takes handle slots, which the parallel update resolves without locking.
+class WorldPartition
+{
+public:
+	//Cell files are named <filePrefix>_<x>_<z>.scn; cells without a file are simply empty. Cells are
+	//loaded when their center is within loadRadius of the viewer, and unloaded once it's further
+	//away than unloadRadius, which should be a bit larger to keep cells on the edge from thrashing.
+	WorldPartition(const std::string& filePrefix, float cellSize, float loadRadius, float unloadRadius,
+		double attachBudgetInMilliseconds = 2.0, unsigned int numIOThreads = 1);
+	virtual ~WorldPartition();
+
+	//Requests and releases cells around the viewer, and attaches loaded cells to root until the
+	//time budget is used up. Has to be called on the main thread, once per frame.
+	void Update(const Vector3f& viewerPos, Entity& root);
+
+	//Splits the children of root into cells by their position, and writes a file for each cell.
+	static bool WriteCells(Entity& root, const std::string& filePrefix, float cellSize);
+	static std::string GetCellFileName(const std::string& filePrefix, int x, int z);
+
+	//Prints streaming bandwidth, the number of pending cells, attach time per frame, and
+	//how many frames the attach budget was exceeded in since the last call.
+	void DisplayAndResetStats(double dividend);
+
+	inline unsigned int GetNumPendingCells()  const { return m_numPendingCells; }
+	inline unsigned int GetNumAttachedCells() const { return m_numAttachedCells; }
+protected:
+private:
+	enum CellState
+	{
+		CELL_LOADING,   //Queued for, or being read by, an IO thread
+		CELL_LOADED,    //Read, and waiting to be attached
+		CELL_ATTACHED
+	};
+
+	struct CellCoord
+	{
+		int x;
+		int z;
+
+		inline bool operator<(const CellCoord& other)  const { return x < other.x || (x == other.x && z < other.z); }
+		inline bool operator==(const CellCoord& other) const { return x == other.x && z == other.z; }
+	};
+
+	struct Cell
+	{
+		CellState                  state;
+		bool                       cancelled; //Went out of range while it was loading
+		std::vector<unsigned char> data;
+		EntityHandle               root;
+	};
+
+	struct CellRequest
+	{
+		CellCoord coord;
+		float     distance;
+
+		inline bool operator<(const CellRequest& other) const { return distance < other.distance; }
+	};
+
+	std::string                 m_filePrefix;
+	float                       m_cellSize;
+	float                       m_loadRadius;
+	float                       m_unloadRadius;
+	double                      m_attachBudget;
+
+	std::map<CellCoord, Cell>   m_cells;
+	std::vector<CellCoord>      m_cellsToAttach; //Loaded cells, closest first
+	unsigned int                m_numPendingCells;
+	unsigned int                m_numAttachedCells;
+
+	//Shared with the IO threads, and guarded by m_ioMutex.
+	std::vector<std::thread>    m_ioThreads;
+	std::mutex                  m_ioMutex;
+	std::condition_variable     m_ioCondition;
+	std::deque<CellCoord>       m_ioRequests;
+	std::vector<std::pair<CellCoord, std::vector<unsigned char> > > m_ioResults;
+	bool                        m_ioStopRequested;
+	size_t                      m_bytesRead;
+
+	//Statistics, since the last DisplayAndResetStats
+	double                      m_statsStartTime;
+	double                      m_totalAttachTime;
+	double                      m_maxAttachTime;
+	unsigned int                m_numCellsAttached;
+	unsigned int                m_numBudgetOverruns;
+
+	void RequestCells(const Vector3f& viewerPos);
+	void ReleaseCells(const Vector3f& viewerPos);
+	void CollectLoadedCells(const Vector3f& viewerPos);
+	void AttachCells(Entity& root);
+	void IOThreadMain();
+
+	float GetCellDistance(const CellCoord& coord, const Vector3f& viewerPos) const;
+
+	WorldPartition(const WorldPartition& other) {}
+	void operator=(const WorldPartition& other) {}
+};
+
+#endif // WORLDPARTITION_H
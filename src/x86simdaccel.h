@@ -56,7 +56,7 @@ public:
 	//Bit 2/3: Which element goes to slot 2
 	//Bit 4/5: Which element goes to slot 3
 	//Bit 6/7: Which element goes to slot 4
-	inline SIMD4i Shuffle(int8_t shuffleByte)
+	inline SIMD4i Shuffle(int8_t shuffleByte) const
 	{
 		return SIMD4i(_mm_shuffle_epi32(m_data, shuffleByte));
 	}
@@ -246,7 +246,7 @@ public:
 	//Bit 2/3: Which element goes to slot 2
 	//Bit 4/5: Which element goes to slot 3
 	//Bit 6/7: Which element goes to slot 4
-	inline SIMD4f Shuffle(int8_t shuffleByte)
+	inline SIMD4f Shuffle(int8_t shuffleByte) const
 	{
 		return SIMD4f(_mm_shuffle_ps(m_data, m_data, shuffleByte));
 	}
@@ -266,6 +266,13 @@ public:
 	#endif
 	}
 	
+	//Bit i of the result is the sign bit of element i. Comparison results are all ones or all
+	//zeros, so this is a quick way to find out which elements passed.
+	inline int GetSignMask() const
+	{
+		return _mm_movemask_ps(m_data);
+	}
+	
 	inline SIMD4i RoundToInt() const
 	{
 		return SIMD4i(_mm_cvtps_epi32(m_data));